@@ -1 +1,55 @@
 #pragma once
+//===- VecOpt.h --------------------------------------------------*- C++ -*-===//
+//
+// Shared declarations for the VecOpt plugin. Each transform lives in its own
+// translation unit under src/ and is registered from VecOpt.cpp.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/PassManager.h"
+
+namespace llvm {
+class Function;
+class Instruction;
+class PassBuilder;
+} // namespace llvm
+
+namespace vecopt {
+
+// Plugin version; part of veclangc's object cache key.
+inline constexpr const char *VersionString = "1.2";
+
+// Add every VecOpt stage to PB's extension points and pipeline-name parser.
+// Used by the plugin entry point and by hosts that link VecOpt statically
+// (veclangc --vecopt).
+void registerPassBuilderCallbacks(llvm::PassBuilder &PB);
+
+// Print the "[VecOpt] fn @ file:line: " diagnostic prefix for I.
+void printLoc(llvm::StringRef Fn, const llvm::Instruction &I);
+
+// Chunked any-of vectorization of early-exit search loops (EarlyExitVec.cpp).
+struct EarlyExitVecPass : llvm::PassInfoMixin<EarlyExitVecPass> {
+  llvm::PreservedAnalyses run(llvm::Function &F,
+                              llvm::FunctionAnalysisManager &FAM);
+};
+
+// Per-slot privatization of hist[idx[i]] += v updates (HistogramPriv.cpp).
+struct HistogramPrivPass : llvm::PassInfoMixin<HistogramPrivPass> {
+  llvm::PreservedAnalyses run(llvm::Function &F,
+                              llvm::FunctionAnalysisManager &FAM);
+};
+
+// Late select-chain / i1-select cleanup after LV and SLP (BlendCleanup.cpp).
+struct BlendCleanupPass : llvm::PassInfoMixin<BlendCleanupPass> {
+  llvm::PreservedAnalyses run(llvm::Function &F,
+                              llvm::FunctionAnalysisManager &FAM);
+};
+
+// Look-ahead prefetch for indirect loads b[a[i]] (IndirectPrefetch.cpp).
+struct IndirectPrefetchPass : llvm::PassInfoMixin<IndirectPrefetchPass> {
+  llvm::PreservedAnalyses run(llvm::Function &F,
+                              llvm::FunctionAnalysisManager &FAM);
+};
+
+} // namespace vecopt
@@ -0,0 +1,278 @@
+/* veclangc_par_rt.c
+ * Thread pool behind veclangc's `#pragma parallel` loops.
+ *
+ * veclangc outlines the body of a parallel loop into
+ *     void body(void *env, int64_t lo, int64_t hi, void *red)
+ * which runs iterations [lo, hi) of the loop (env holds the captured
+ * variables) and merges its private reduction results into *red, and calls
+ *     __vlc_parallel_for(n, dynamic, chunk, body, env,
+ *                        red, red_init, red_size, combine)
+ * for the n iterations. Each worker gets its own reduction slot, copied
+ * from red_init (the identities); when all iterations are done the caller
+ * folds every slot into red with combine(red, slot).
+ *
+ * The pool is created on the first call: $VECLANGC_NUM_THREADS threads
+ * (default: the online CPUs), the calling thread being worker 0. Idle
+ * workers spin for a while, then sleep until the next loop.
+ *
+ * Schedules:
+ *   static   worker w runs the w-th contiguous share of the iterations, or
+ *            with a chunk size every T-th chunk (round robin). No stealing.
+ *   dynamic  every worker starts with a contiguous share and takes `chunk`
+ *            iterations at a time from its front; a worker that runs out
+ *            steals the back half of another worker's remaining range
+ *            (all of it when only one chunk is left). Default chunk:
+ *            n / (8 * T).
+ *
+ * A parallel loop inside a parallel loop, or one started while another
+ * thread's loop occupies the pool, runs serially on the calling thread.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define VLC_MAX_THREADS 256
+#define VLC_SPINS 20000 /* pause loops before an idle worker sleeps */
+
+typedef void (*vlc_body)(void *env, int64_t lo, int64_t hi, void *red);
+typedef void (*vlc_combine)(void *into, const void *from);
+
+/* Remaining iterations [lo, hi) of one worker; thieves take from hi. */
+struct vlc_worker {
+  _Alignas(64) int lock;
+  int64_t lo, hi;
+  uint32_t rng;
+};
+
+/* The loop being run; written by the caller before it bumps generation. */
+static struct {
+  vlc_body body;
+  void *env;
+  int64_t n, chunk;
+  int dynamic, nthreads;
+  unsigned char *slots; /* nthreads reduction slots, slot_stride apart */
+  size_t slot_stride;
+  const void *red_init;
+  size_t red_size;
+} job;
+
+static struct vlc_worker workers[VLC_MAX_THREADS];
+static int pool_size = 1;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static unsigned generation; /* bumped once per parallel loop */
+static int active;          /* pool threads not yet done with it */
+static int busy;            /* the pool runs a loop */
+static pthread_mutex_t sleep_mu = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake_cv = PTHREAD_COND_INITIALIZER;
+static unsigned char *slot_buf;
+static size_t slot_cap;
+static __thread int in_parallel;
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#else
+  __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+static void lock_worker(struct vlc_worker *w) {
+  while (__atomic_exchange_n(&w->lock, 1, __ATOMIC_ACQUIRE))
+    while (__atomic_load_n(&w->lock, __ATOMIC_RELAXED))
+      cpu_relax();
+}
+
+static void unlock_worker(struct vlc_worker *w) {
+  __atomic_store_n(&w->lock, 0, __ATOMIC_RELEASE);
+}
+
+/* Next chunk of the worker's own range; 0 when it is empty. */
+static int take_front(struct vlc_worker *w, int64_t *lo, int64_t *hi) {
+  lock_worker(w);
+  int64_t rem = w->hi - w->lo;
+  if (rem > 0) {
+    *lo = w->lo;
+    *hi = w->lo + (rem < job.chunk ? rem : job.chunk);
+    w->lo = *hi;
+  }
+  unlock_worker(w);
+  return rem > 0;
+}
+
+/* Move part of another worker's range into self; 0 when all are empty. */
+static int steal(int self) {
+  struct vlc_worker *me = &workers[self];
+  int T = job.nthreads;
+  me->rng = me->rng * 1103515245u + 12345u;
+  int start = (int)((me->rng >> 16) % (unsigned)T);
+  for (int k = 0; k < T; ++k) {
+    int v = (start + k) % T;
+    if (v == self)
+      continue;
+    struct vlc_worker *w = &workers[v];
+    if (__atomic_load_n(&w->hi, __ATOMIC_RELAXED) <=
+        __atomic_load_n(&w->lo, __ATOMIC_RELAXED))
+      continue;
+    lock_worker(w);
+    int64_t rem = w->hi - w->lo, take = rem <= job.chunk ? rem : rem / 2;
+    int64_t lo = w->hi - take, hi = w->hi;
+    if (take > 0)
+      w->hi = lo;
+    unlock_worker(w);
+    if (take > 0) {
+      lock_worker(me);
+      me->lo = lo;
+      me->hi = hi;
+      unlock_worker(me);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void run_worker(int id) {
+  int T = job.nthreads;
+  int64_t n = job.n;
+  void *red = NULL;
+  if (job.red_size) {
+    red = job.slots + (size_t)id * job.slot_stride;
+    memcpy(red, job.red_init, job.red_size);
+  }
+  int64_t first = n / T * id + (id < n % T ? id : n % T);
+  int64_t last = first + n / T + (id < n % T);
+  if (!job.dynamic) {
+    if (!job.chunk) {
+      if (first < last)
+        job.body(job.env, first, last, red);
+      return;
+    }
+    for (int64_t lo = (int64_t)id * job.chunk; lo < n; lo += (int64_t)T * job.chunk)
+      job.body(job.env, lo, n - lo < job.chunk ? n : lo + job.chunk, red);
+    return;
+  }
+  struct vlc_worker *me = &workers[id];
+  int64_t lo, hi;
+  for (;;) {
+    while (take_front(me, &lo, &hi))
+      job.body(job.env, lo, hi, red);
+    if (!steal(id))
+      return;
+  }
+}
+
+static void *worker_main(void *arg) {
+  int id = (int)(intptr_t)arg;
+  unsigned seen = 0;
+  in_parallel = 1; /* loops inside a body run serially */
+  for (;;) {
+    unsigned g;
+    int spins = 0;
+    while ((g = __atomic_load_n(&generation, __ATOMIC_ACQUIRE)) == seen) {
+      if (++spins < VLC_SPINS) {
+        cpu_relax();
+        continue;
+      }
+      pthread_mutex_lock(&sleep_mu);
+      while (__atomic_load_n(&generation, __ATOMIC_ACQUIRE) == seen)
+        pthread_cond_wait(&wake_cv, &sleep_mu);
+      pthread_mutex_unlock(&sleep_mu);
+    }
+    seen = g;
+    if (id < job.nthreads)
+      run_worker(id);
+    __atomic_fetch_sub(&active, 1, __ATOMIC_RELEASE);
+  }
+  return NULL;
+}
+
+static void init_pool(void) {
+  long n = 0;
+  const char *s = getenv("VECLANGC_NUM_THREADS");
+  if (s && *s)
+    n = strtol(s, NULL, 10);
+  if (n <= 0)
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+  if (n < 1)
+    n = 1;
+  if (n > VLC_MAX_THREADS)
+    n = VLC_MAX_THREADS;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  int created = 1;
+  for (int i = 1; i < n; ++i) {
+    pthread_t t;
+    workers[i].rng = (uint32_t)i * 2654435761u;
+    if (pthread_create(&t, &attr, worker_main, (void *)(intptr_t)i))
+      break;
+    ++created;
+  }
+  pthread_attr_destroy(&attr);
+  pool_size = created;
+}
+
+void __vlc_parallel_for(int64_t n, int32_t dynamic, int64_t chunk,
+                        vlc_body body, void *env, void *red,
+                        const void *red_init, int64_t red_size,
+                        vlc_combine combine) {
+  if (n <= 0)
+    return;
+  pthread_once(&pool_once, init_pool);
+  int T = pool_size < n ? pool_size : (int)n;
+  if (T <= 1 || in_parallel || __atomic_exchange_n(&busy, 1, __ATOMIC_ACQUIRE)) {
+    body(env, 0, n, red);
+    return;
+  }
+  size_t stride = ((size_t)red_size + 63) & ~(size_t)63;
+  if (stride * T > slot_cap) {
+    void *p = NULL;
+    if (posix_memalign(&p, 64, stride * T)) {
+      __atomic_store_n(&busy, 0, __ATOMIC_RELEASE);
+      body(env, 0, n, red);
+      return;
+    }
+    free(slot_buf);
+    slot_buf = p;
+    slot_cap = stride * T;
+  }
+
+  job.body = body;
+  job.env = env;
+  job.n = n;
+  job.dynamic = dynamic;
+  job.chunk = chunk > 0 ? chunk : dynamic ? (n / (8 * T) > 0 ? n / (8 * T) : 1) : 0;
+  job.nthreads = T;
+  job.slots = slot_buf;
+  job.slot_stride = stride;
+  job.red_init = red_init;
+  job.red_size = (size_t)red_size;
+  for (int id = 0; id < T; ++id) {
+    workers[id].lo = n / T * id + (id < n % T ? id : n % T);
+    workers[id].hi = workers[id].lo + n / T + (id < n % T);
+  }
+  __atomic_store_n(&active, pool_size - 1, __ATOMIC_RELAXED);
+  pthread_mutex_lock(&sleep_mu);
+  __atomic_fetch_add(&generation, 1, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&wake_cv);
+  pthread_mutex_unlock(&sleep_mu);
+
+  in_parallel = 1;
+  run_worker(0);
+  in_parallel = 0;
+  for (int spins = 0; __atomic_load_n(&active, __ATOMIC_ACQUIRE); ++spins) {
+    if (spins < VLC_SPINS)
+      cpu_relax();
+    else
+      sched_yield();
+  }
+  if (red_size)
+    for (int id = 0; id < T; ++id)
+      combine(red, slot_buf + (size_t)id * stride);
+  __atomic_store_n(&busy, 0, __ATOMIC_RELEASE);
+}
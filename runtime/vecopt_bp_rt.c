@@ -0,0 +1,85 @@
+/* vecopt_bp_rt.c
+ * Branch-predictability profiling runtime for VecOpt (-vecopt-bp-instrument).
+ *
+ * Every instrumented branch owns one zero-initialized `vecopt_bp_site` emitted
+ * by the pass; the pass only fills in `key`. On each execution the branch
+ * calls __vecopt_bp_record(site, taken), which counts executions, taken
+ * outcomes and transitions (outcome != previous outcome), and simulates a
+ * small local-history predictor (2-bit counters indexed by the site's last
+ * VECOPT_BP_HIST_BITS outcomes). Mispredictions of that predictor are what
+ * -vecopt-bp-profile uses to pick branches worth if-converting: an
+ * alternating 50/50 branch scores ~0, a random 70/30 branch scores ~0.3.
+ *
+ * At exit the profile is written to $VECOPT_BP_PROFILE (default
+ * "vecopt.bpprof"), one line per site:
+ *     <key> <exec> <taken> <transitions> <local_miss>
+ * Counters are not atomic; multi-threaded runs give approximate counts.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define VECOPT_BP_HIST_BITS 4
+#define VECOPT_BP_HIST_ENTRIES (1u << VECOPT_BP_HIST_BITS)
+
+/* Layout contract with VecOpt.cpp: { ptr key, [8 x i64] } (72 bytes). */
+struct vecopt_bp_site {
+  const char *key;
+  struct vecopt_bp_site *next;
+  uint64_t exec, taken, transitions, local_miss;
+  uint32_t history, registered;
+  uint8_t ctr[VECOPT_BP_HIST_ENTRIES];
+};
+
+_Static_assert(sizeof(struct vecopt_bp_site) == 72,
+               "site layout must match the IR emitted by VecOpt");
+
+static struct vecopt_bp_site *sites;
+static int atexit_done;
+
+static void vecopt_bp_dump(void) {
+  const char *path = getenv("VECOPT_BP_PROFILE");
+  if (!path || !*path) path = "vecopt.bpprof";
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    perror("vecopt_bp_rt: cannot write profile");
+    return;
+  }
+  fprintf(f, "# vecopt branch profile v1: key exec taken transitions local_miss\n");
+  for (struct vecopt_bp_site *s = sites; s; s = s->next)
+    fprintf(f, "%s %llu %llu %llu %llu\n", s->key,
+            (unsigned long long)s->exec, (unsigned long long)s->taken,
+            (unsigned long long)s->transitions,
+            (unsigned long long)s->local_miss);
+  fclose(f);
+}
+
+static void vecopt_bp_register(struct vecopt_bp_site *s) {
+  if (__atomic_exchange_n(&s->registered, 1, __ATOMIC_ACQ_REL))
+    return;
+  s->next = __atomic_load_n(&sites, __ATOMIC_ACQUIRE);
+  while (!__atomic_compare_exchange_n(&sites, &s->next, s, 1, __ATOMIC_ACQ_REL,
+                                      __ATOMIC_ACQUIRE))
+    ;
+  if (!__atomic_exchange_n(&atexit_done, 1, __ATOMIC_ACQ_REL))
+    atexit(vecopt_bp_dump);
+}
+
+void __vecopt_bp_record(struct vecopt_bp_site *s, uint32_t taken) {
+  if (!s->registered)
+    vecopt_bp_register(s);
+
+  taken = taken != 0;
+  if (s->exec && (s->history & 1u) != taken)
+    s->transitions++;
+  s->exec++;
+  s->taken += taken;
+
+  uint8_t *c = &s->ctr[s->history & (VECOPT_BP_HIST_ENTRIES - 1)];
+  if ((*c >= 2) != taken)
+    s->local_miss++;
+  if (taken && *c < 3) ++*c;
+  if (!taken && *c > 0) --*c;
+  s->history = (s->history << 1) | taken;
+}
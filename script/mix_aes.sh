@@ -10,6 +10,13 @@ VECC="${REPO_ROOT}/build/veclangc/veclangc"
 
 TINY_DIR="${THIRD_PARTY}/tiny-AES-c"
 
+# LTO=thin|full: kernel as bitcode, optimized with the driver at link time
+LTO="${LTO:-}"
+LTO_FLAGS=""
+if [ -n "${LTO}" ]; then
+  LTO_FLAGS="-flto=${LTO} -fuse-ld=lld"
+fi
+
 mkdir -p "${THIRD_PARTY}" "${MIX_DIR}"
 
 # ---- 1) Get upstream tiny-AES-c ----
@@ -35,17 +42,17 @@ DRIVER_C="${MIX_DIR}/rest_aes.c"
 # ---- 4) Compile subbytes kernel (try veclangc first, fallback to clang) ----
 echo "[mixed] build subbytes: kernel with veclangc (fallback clang)"
 set +e
-"${VECC}" --input "${KERNEL_C}" -c -o "${MIX_DIR}/kernel_aes.o"
+"${VECC}" ${LTO:+-flto=${LTO}} --input "${KERNEL_C}" -c -o "${MIX_DIR}/kernel_aes.o"
 VECC_RC=$?
 set -e
 if [ $VECC_RC -ne 0 ]; then
   echo "[warn] veclangc failed to compile kernel, fallback to clang (still runnable but no vectorization demo)"
-  clang -O3 -c "${KERNEL_C}" -o "${MIX_DIR}/kernel_aes.o"
+  clang -O3 ${LTO_FLAGS} -c "${KERNEL_C}" -o "${MIX_DIR}/kernel_aes.o"
 fi
 
 # ---- 5) Link subbytes test program (mixed and pure clang use the same driver) ----
 echo "[link] subbytes_mixed"
-clang -O3 "${DRIVER_C}" "${MIX_DIR}/kernel_aes.o" -o "${MIX_DIR}/subbytes_mixed"
+clang -O3 ${LTO_FLAGS} "${DRIVER_C}" "${MIX_DIR}/kernel_aes.o" -o "${MIX_DIR}/subbytes_mixed"
 
 # ---- 6) Tips and run ----
 echo
@@ -7,7 +7,7 @@ BUILD_DIR="${ROOT_DIR}/build"
 RESULTS_DIR="${ROOT_DIR}/results"
 
 BASICMATH_DIR="${MIBENCH_DIR}/automotive/basicmath"
-OUT_DIR="${BUILD_DIR}/basicmath"
+OUT_DIR="${BUILD_DIR}/basicmath${LTO:+-lto-${LTO}}"
 
 VECC="${ROOT_DIR}/build/veclangc/veclangc"
 # CC=${CC:-clang}
@@ -16,6 +16,18 @@ VECC="${ROOT_DIR}/build/veclangc/veclangc"
 CC="clang"
 CFLAGS="-O3 -march=native -ffast-math -fno-exceptions -fno-rtti -std=gnu89"
 LDFLAGS="-lm"
+VECC_FLAGS=""
+
+# LTO=thin|full: the veclangc kernel is written as bitcode (-flto) and
+# optimized together with the clang code at link time (lld), so
+# per-element kernels can be inlined into their callers' loops. clang must
+# be at least as new as the LLVM veclangc is built with.
+LTO="${LTO:-}"
+if [[ -n "${LTO}" ]]; then
+  VECC_FLAGS="${VECC_FLAGS} -flto=${LTO}"
+  CFLAGS="${CFLAGS} -flto=${LTO}"
+  LDFLAGS="${LDFLAGS} -fuse-ld=lld"
+fi
 
 mkdir -p "${OUT_DIR}" "${RESULTS_DIR}"
 
@@ -29,7 +41,7 @@ SRC_RAD2DEG="${BASICMATH_DIR}/rad2deg.c"
 
 # 2) mixed：kernel_basicmath.c → veclangc，其餘 clang（且不連 isqrt.c）
 echo "[mixed] compiling kernel_basicmath.c with veclangc..."
-"${VECC}" --input "${SRC_KERNEL_V}" -c -o "${OUT_DIR}/kernel_basicmath.o"
+"${VECC}" ${VECC_FLAGS} --input "${SRC_KERNEL_V}" -c -o "${OUT_DIR}/kernel_basicmath.o"
 
 echo "[mixed] compiling rest with clang..."
 ${CC} ${CFLAGS} -c "${SRC_MAIN_REST}" -o "${OUT_DIR}/basicmath_large_rest.o"
@@ -7,13 +7,37 @@ BUILD_DIR="${ROOT_DIR}/build/qsort"
 RESULTS_DIR="${ROOT_DIR}/results"
 
 QSORT_DIR="${MIBENCH_DIR}/automotive/qsort"
-OUT_DIR="${BUILD_DIR}"
+OUT_DIR="${BUILD_DIR}${LTO:+-lto-${LTO}}"
 
 VECC="${ROOT_DIR}/build/veclangc/veclangc"
 CC="clang"
 CFLAGS="-O3 -march=native -ffast-math -fno-exceptions -fno-rtti -std=gnu89"
 LDFLAGS="-lm"
 
+# VECOPT=1: both sides get the VecOpt stages (veclangc in-process via
+# --vecopt, clang through the plugin), so the kernels compare like for like
+VECOPT="${VECOPT:-0}"
+VECC_FLAGS=""
+if [[ "${VECOPT}" == "1" ]]; then
+  VECC_FLAGS="--vecopt"
+  CFLAGS="${CFLAGS} -fpass-plugin=${ROOT_DIR}/build/VecOpt.so"
+fi
+
+# LTO=thin|full: the veclangc kernel is written as bitcode (-flto) and
+# optimized together with the clang code at link time (lld), so
+# per-element kernels can be inlined into their callers' loops. clang must
+# be at least as new as the LLVM veclangc is built with.
+LTO="${LTO:-}"
+if [[ -n "${LTO}" ]]; then
+  VECC_FLAGS="${VECC_FLAGS} -flto=${LTO}"
+  CFLAGS="${CFLAGS} -flto=${LTO}"
+  LDFLAGS="${LDFLAGS} -fuse-ld=lld"
+  # the vectorizer runs at link time now, so the linker loads VecOpt too
+  if [[ "${VECOPT}" == "1" ]]; then
+    LDFLAGS="${LDFLAGS} -Wl,--load-pass-plugin=${ROOT_DIR}/build/VecOpt.so"
+  fi
+fi
+
 mkdir -p "${OUT_DIR}" "${RESULTS_DIR}"
 
 SRC_KERNEL_V="${ROOT_DIR}/veclangc/mix_1/kernel.c"
@@ -22,7 +46,7 @@ SRC_MAIN_REST="${ROOT_DIR}/veclangc/mix_1/qsort_large_rest.c"
 
 # ========== 1) mixed build ==========
 echo "[mixed] compiling kernel_qsort.c with veclangc..."
-if "${VECC}" --input "${SRC_KERNEL_V}" -c -o "${OUT_DIR}/kernel_qsort.o"; then
+if "${VECC}" ${VECC_FLAGS} --input "${SRC_KERNEL_V}" -c -o "${OUT_DIR}/kernel_qsort.o"; then
   echo "veclangc compiled kernel_qsort.c successfully"
 else
   echo "veclangc failed, falling back to clang"
@@ -0,0 +1,158 @@
+//===- BlendCleanup.cpp ------------------------------------------*- C++ -*-===//
+//
+// VecOpt blend cleanup: runs after LoopVectorize / SLPVectorizer. Nested
+// if-conversions leave chains of (vector) selects on the same or
+// complementary masks plus selects of i1 that are really logic ops. Each
+// select becomes a blend in the vector body, so collapse them:
+//
+//   select c, a, (select c, x, y)    -> select c, a, y
+//   select c, a, (select !c, x, y)   -> select c, a, x
+//   select !c, a, b                  -> select c, b, a
+//   select c1, a, (select c2, a, b)  -> select (c1 | c2), a, b
+//   select c1, (select c2, a, b), b  -> select (c1 & c2), a, b
+//   select c, true, b                -> c | b       (and the and/not forms)
+//
+// Operands that would newly propagate poison are frozen, matching the
+// select semantics they replace.
+//
+//===----------------------------------------------------------------------===//
+
+#include "VecOpt/VecOpt.h"
+
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/PatternMatch.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+using namespace llvm;
+using namespace llvm::PatternMatch;
+
+//------------------------------------------------------------------------------
+// Options
+//------------------------------------------------------------------------------
+static cl::opt<bool> EnableBlendCleanup(
+    "vecopt-blend-cleanup",
+    cl::desc("Collapse select chains and i1 selects after vectorization"),
+    cl::init(true));
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+// A and B are complementary masks: A == !B lane-wise.
+static bool isComplement(Value *A, Value *B) {
+  Value *X;
+  if (match(A, m_Not(m_Value(X))) && X == B) return true;
+  if (match(B, m_Not(m_Value(X))) && X == A) return true;
+  auto *CA = dyn_cast<CmpInst>(A);
+  auto *CB = dyn_cast<CmpInst>(B);
+  if (!CA || !CB || CA->getOpcode() != CB->getOpcode()) return false;
+  if (CA->getOperand(0) == CB->getOperand(0) &&
+      CA->getOperand(1) == CB->getOperand(1))
+    return CA->getInversePredicate() == CB->getPredicate();
+  if (CA->getOperand(0) == CB->getOperand(1) &&
+      CA->getOperand(1) == CB->getOperand(0))
+    return CA->getInversePredicate() == CB->getSwappedPredicate();
+  return false;
+}
+
+static Value *freezeIfMaybePoison(Value *V, IRBuilder<> &B) {
+  if (isGuaranteedNotToBePoison(V)) return V;
+  return B.CreateFreeze(V, V->getName() + ".frz");
+}
+
+// Returns the replacement for S, or nullptr if no rule applies.
+static Value *simplifyBlend(SelectInst *S, IRBuilder<> &B) {
+  Value *C = S->getCondition();
+  Value *T = S->getTrueValue();
+  Value *F = S->getFalseValue();
+
+  if (T == F) return T;
+
+  // i1 selects are logic ops.
+  if (S->getType()->isIntOrIntVectorTy(1)) {
+    if (match(T, m_One()) && match(F, m_Zero())) return C;
+    if (match(T, m_Zero()) && match(F, m_One())) return B.CreateNot(C);
+    if (match(T, m_One())) return B.CreateOr(C, freezeIfMaybePoison(F, B));
+    if (match(F, m_Zero())) return B.CreateAnd(C, freezeIfMaybePoison(T, B));
+    if (match(T, m_Zero()))
+      return B.CreateAnd(B.CreateNot(C), freezeIfMaybePoison(F, B));
+    if (match(F, m_One()))
+      return B.CreateOr(B.CreateNot(C), freezeIfMaybePoison(T, B));
+  }
+
+  // select !c, a, b -> select c, b, a
+  Value *NotC;
+  if (match(C, m_Not(m_Value(NotC))))
+    return B.CreateSelect(NotC, F, T);
+
+  // Inner select on the false arm.
+  if (auto *In = dyn_cast<SelectInst>(F)) {
+    Value *C2 = In->getCondition();
+    if (C2 == C) return B.CreateSelect(C, T, In->getFalseValue());
+    if (isComplement(C, C2)) return B.CreateSelect(C, T, In->getTrueValue());
+    if (In->getTrueValue() == T && In->hasOneUse() &&
+        C->getType() == C2->getType())
+      return B.CreateSelect(B.CreateOr(C, freezeIfMaybePoison(C2, B)), T,
+                            In->getFalseValue());
+  }
+
+  // Inner select on the true arm.
+  if (auto *In = dyn_cast<SelectInst>(T)) {
+    Value *C2 = In->getCondition();
+    if (C2 == C) return B.CreateSelect(C, In->getTrueValue(), F);
+    if (isComplement(C, C2)) return B.CreateSelect(C, In->getFalseValue(), F);
+    if (In->getFalseValue() == F && In->hasOneUse() &&
+        C->getType() == C2->getType())
+      return B.CreateSelect(B.CreateAnd(C, freezeIfMaybePoison(C2, B)),
+                            In->getTrueValue(), F);
+  }
+  return nullptr;
+}
+
+//------------------------------------------------------------------------------
+// Pass
+//------------------------------------------------------------------------------
+PreservedAnalyses vecopt::BlendCleanupPass::run(Function &F,
+                                                FunctionAnalysisManager &) {
+  if (!EnableBlendCleanup) return PreservedAnalyses::all();
+
+  unsigned Folded = 0;
+  bool Local = true;
+  while (Local) {
+    Local = false;
+    SmallVector<SelectInst*, 32> Selects;
+    for (Instruction &I : instructions(F))
+      if (auto *S = dyn_cast<SelectInst>(&I))
+        if (!S->use_empty()) Selects.push_back(S);
+
+    SmallVector<WeakTrackingVH, 32> Dead;
+    for (SelectInst *S : Selects) {
+      if (S->use_empty()) continue; // outer select already folded it away
+      IRBuilder<> B(S);
+      Value *V = simplifyBlend(S, B);
+      if (!V || V == S) continue;
+      // an existing value (the mask, an arm, an argument) keeps its own name
+      if (!V->hasName()) V->takeName(S);
+      S->replaceAllUsesWith(V);
+      Dead.push_back(S);
+      ++Folded;
+      Local = true;
+    }
+    RecursivelyDeleteTriviallyDeadInstructions(Dead);
+  }
+  if (!Folded) return PreservedAnalyses::all();
+
+  errs() << "[VecOpt] " << F.getName() << ": blend cleanup folded " << Folded
+         << " select" << (Folded > 1 ? "s" : "") << "\n";
+  PreservedAnalyses PA;
+  PA.preserveSet<CFGAnalyses>();
+  return PA;
+}
@@ -0,0 +1,473 @@
+//===- EarlyExitVec.cpp ------------------------------------------*- C++ -*-===//
+//
+// VecOpt early-exit chunking: speed up search loops such as
+//
+//   for (i = 0; i < n; ++i) if (a[i] == k) break;
+//
+// which LoopVectorize refuses because of the data-dependent exit. A vector
+// pre-loop tests VF iterations at a time with an any-of reduction of the exit
+// condition and skips every chunk without a hit. On the first hit (or when
+// fewer than VF+1 iterations remain) control enters the untouched scalar loop
+// at the first iteration of that chunk; the scalar loop finds the exact exit
+// position and produces all live-out values.
+//
+// Guards:
+//  - Innermost loop with preheader and single latch; no memory writes.
+//  - Exactly two exiting blocks: the early exit and a counted exit with a
+//    SCEV-computable exit count; straight-line body (every block dominates
+//    the latch).
+//  - Header PHIs must be affine AddRecs with a constant step so they can be
+//    re-materialized at the resume iteration.
+//  - The exit condition may only use loop invariants, header IVs, unit-stride
+//    loads and speculatable arithmetic / casts / compares.
+//  - Every load is proven dereferenceable over the trip count by SCEV, or
+//    (-vecopt-ee-page-safe) it is the single unproven stream: chunks are then
+//    aligned to VF*EltSize so none crosses a page, and the misaligned head is
+//    tested with a masked load.
+//
+//===----------------------------------------------------------------------===//
+
+#include "VecOpt/VecOpt.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/Loads.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/LoopSimplify.h"
+#include "llvm/Transforms/Utils/ScalarEvolutionExpander.h"
+
+using namespace llvm;
+using vecopt::printLoc;
+
+//------------------------------------------------------------------------------
+// Options
+//------------------------------------------------------------------------------
+static cl::opt<bool> EnableEarlyExit(
+    "vecopt-early-exit",
+    cl::desc("Chunk early-exit search loops with an any-of vector test"),
+    cl::init(true));
+
+static cl::opt<unsigned> EarlyExitVF(
+    "vecopt-ee-vf",
+    cl::desc("Lanes per early-exit chunk (0 = derive from target vector width)"),
+    cl::init(0));
+
+static cl::opt<bool> EarlyExitPageSafe(
+    "vecopt-ee-page-safe",
+    cl::desc("Allow one unproven stream once chunks are page-aligned"),
+    cl::init(true));
+
+static cl::opt<unsigned> EarlyExitMaxSlice(
+    "vecopt-ee-max-slice",
+    cl::desc("Maximum instructions widened for the exit condition"),
+    cl::init(16));
+
+static constexpr uint64_t PageSize = 4096;
+
+//------------------------------------------------------------------------------
+// Candidate analysis
+//------------------------------------------------------------------------------
+namespace {
+struct Stream {
+  LoadInst *Load;
+  const SCEVAddRecExpr *AR; // {Base,+,EltSize}<L>
+};
+
+struct Candidate {
+  Loop *L = nullptr;
+  BranchInst *ExitBr = nullptr; // data-dependent exit
+  bool ExitOnTrue = true;
+  const SCEV *ExitCount = nullptr; // of the counted exit
+  SmallVector<Instruction*, 16> Slice; // defs before uses
+  SmallVector<Stream, 4> Streams;
+  LoadInst *AlignLoad = nullptr; // unproven stream (page-safe mode)
+  unsigned VF = 0;
+};
+} // namespace
+
+static const SCEVAddRecExpr *getAffineIV(PHINode *P, Loop *L,
+                                         ScalarEvolution &SE) {
+  if (!SE.isSCEVable(P->getType())) return nullptr;
+  auto *AR = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(P));
+  if (!AR || AR->getLoop() != L || !AR->isAffine()) return nullptr;
+  if (!isa<SCEVConstant>(AR->getStepRecurrence(SE))) return nullptr;
+  return AR;
+}
+
+static bool isScalarIntOrFP(Type *T) {
+  return T->isIntegerTy() || T->isFloatingPointTy();
+}
+
+// Collect the backward slice of the exit condition inside L in post-order.
+static bool collectSlice(Value *V, Loop *L, ScalarEvolution &SE,
+                         SmallPtrSetImpl<Value*> &Visited, Candidate &C) {
+  if (L->isLoopInvariant(V)) return true;
+  if (!Visited.insert(V).second) return true;
+  auto *I = dyn_cast<Instruction>(V);
+  if (!I || !isScalarIntOrFP(I->getType())) return false;
+
+  if (auto *P = dyn_cast<PHINode>(I))
+    return P->getParent() == L->getHeader() && getAffineIV(P, L, SE);
+
+  if (auto *LI = dyn_cast<LoadInst>(I)) {
+    if (!LI->isSimple()) return false;
+    auto *AR = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(LI->getPointerOperand()));
+    if (!AR || AR->getLoop() != L || !AR->isAffine()) return false;
+    auto *Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+    const DataLayout &DL = LI->getModule()->getDataLayout();
+    uint64_t Size = DL.getTypeStoreSize(LI->getType());
+    if (!Step || Step->getAPInt() != Size ||
+        DL.getTypeAllocSize(LI->getType()) != Size)
+      return false;
+    C.Streams.push_back({LI, AR});
+    C.Slice.push_back(LI);
+    return true;
+  }
+
+  if (!isa<BinaryOperator>(I) && !isa<CastInst>(I) && !isa<CmpInst>(I) &&
+      !isa<SelectInst>(I) && !isa<FreezeInst>(I))
+    return false;
+  if (!isSafeToSpeculativelyExecute(I)) return false;
+  for (Value *Op : I->operands())
+    if (!isScalarIntOrFP(Op->getType()) ||
+        !collectSlice(Op, L, SE, Visited, C))
+      return false;
+  C.Slice.push_back(I);
+  return C.Slice.size() <= EarlyExitMaxSlice;
+}
+
+static bool analyzeLoop(Loop *L, ScalarEvolution &SE, DominatorTree &DT,
+                        const TargetTransformInfo &TTI, Candidate &C) {
+  if (!L->isInnermost() || !L->getLoopPreheader() || !L->getLoopLatch())
+    return false;
+  BasicBlock *Latch = L->getLoopLatch();
+  BasicBlock *Header = L->getHeader();
+
+  for (BasicBlock *BB : L->blocks()) {
+    if (!DT.dominates(BB, Latch)) return false;
+    for (Instruction &I : *BB)
+      if (I.mayHaveSideEffects()) return false;
+  }
+
+  SmallVector<BasicBlock*, 4> Exiting;
+  L->getExitingBlocks(Exiting);
+  if (Exiting.size() != 2) return false;
+
+  // The counted exit is the one SCEV can compute; prefer the latch.
+  if (Exiting[1] == Latch) std::swap(Exiting[0], Exiting[1]);
+  BasicBlock *Early = nullptr;
+  for (unsigned i = 0; i < 2; ++i) {
+    const SCEV *EC = SE.getExitCount(L, Exiting[i]);
+    if (isa<SCEVCouldNotCompute>(EC)) continue;
+    C.ExitCount = EC;
+    Early = Exiting[1 - i];
+    break;
+  }
+  if (!Early) return false;
+  if (!C.ExitCount->getType()->isIntegerTy() ||
+      C.ExitCount->getType()->getIntegerBitWidth() > 64)
+    return false;
+
+  auto *Br = dyn_cast<BranchInst>(Early->getTerminator());
+  if (!Br || !Br->isConditional()) return false;
+  C.L = L;
+  C.ExitBr = Br;
+  C.ExitOnTrue = !L->contains(Br->getSuccessor(0));
+
+  // Every header PHI must be re-materializable at the resume iteration.
+  for (PHINode &P : Header->phis())
+    if (!getAffineIV(&P, L, SE)) return false;
+
+  SmallPtrSet<Value*, 32> Visited;
+  if (!collectSlice(Br->getCondition(), L, SE, Visited, C)) return false;
+  if (C.Streams.empty()) return false; // nothing data-dependent to chunk
+
+  // Dereferenceability: SCEV proof, or a single page-aligned stream.
+  const DataLayout &DL = Header->getModule()->getDataLayout();
+  for (const Stream &S : C.Streams) {
+    if (isDereferenceableAndAlignedInLoop(S.Load, L, SE, DT)) continue;
+    if (!EarlyExitPageSafe || C.AlignLoad) return false;
+    C.AlignLoad = S.Load;
+  }
+
+  unsigned MaxBits = 8;
+  for (Instruction *I : C.Slice)
+    MaxBits = std::max<unsigned>(MaxBits,
+                                 DL.getTypeSizeInBits(I->getType()).getKnownMinValue());
+  unsigned RegBits = TTI.getRegisterBitWidth(
+      TargetTransformInfo::RGK_FixedWidthVector).getKnownMinValue();
+  if (RegBits == 0) RegBits = 128;
+  unsigned VF = EarlyExitVF ? (unsigned)EarlyExitVF : RegBits / MaxBits;
+  if (!isPowerOf2_32(VF) || VF < 2 || VF > 64) return false;
+  C.VF = VF;
+
+  if (C.AlignLoad) {
+    uint64_t Size = DL.getTypeStoreSize(C.AlignLoad->getType());
+    if (!isPowerOf2_64(Size) || Size * VF > PageSize ||
+        C.AlignLoad->getAlign().value() < Size)
+      return false;
+  }
+
+  unsigned MaxTC = SE.getSmallConstantMaxTripCount(L);
+  if (MaxTC && MaxTC < 2 * VF) return false;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Rewrite
+//------------------------------------------------------------------------------
+
+// Widen the exit-condition slice for chunk [K, K+VF) and return "some lane
+// exits". Mask (optional) disables lanes in the misaligned head chunk.
+static Value *emitChunkTest(IRBuilder<> &B, const Candidate &C, Value *K,
+                            Value *Mask, ArrayRef<Value*> Bases,
+                            DenseMap<Value*, Value*> &Splats,
+                            ScalarEvolution &SE) {
+  Loop *L = C.L;
+  unsigned VF = C.VF;
+  const DataLayout &DL = L->getHeader()->getModule()->getDataLayout();
+  Type *I64 = B.getInt64Ty();
+  DenseMap<Value*, Value*> VMap;
+
+  auto widen = [&](Value *V) -> Value* {
+    auto It = VMap.find(V);
+    if (It != VMap.end()) return It->second;
+    return Splats.lookup(V);
+  };
+
+  for (Instruction *I : C.Slice) {
+    Value *W = nullptr;
+    if (auto *LI = dyn_cast<LoadInst>(I)) {
+      unsigned Idx = 0;
+      while (C.Streams[Idx].Load != LI) ++Idx;
+      uint64_t Size = DL.getTypeStoreSize(LI->getType());
+      Value *Off = B.CreateMul(K, ConstantInt::get(I64, Size));
+      Value *Ptr = B.CreateGEP(B.getInt8Ty(), Bases[Idx], Off,
+                               LI->getName() + ".chunk.addr");
+      auto *VecTy = FixedVectorType::get(LI->getType(), VF);
+      Align A = LI->getAlign();
+      if (LI == C.AlignLoad)
+        A = std::max(A, Align(Size * VF));
+      if (Mask)
+        W = B.CreateMaskedLoad(VecTy, Ptr, A, Mask, nullptr,
+                               LI->getName() + ".chunk");
+      else
+        W = B.CreateAlignedLoad(VecTy, Ptr, A, LI->getName() + ".chunk");
+    } else if (auto *P = dyn_cast<PHINode>(I)) {
+      // Lane l holds Start + (K + l) * Step.
+      const SCEVAddRecExpr *AR = getAffineIV(P, L, SE);
+      const APInt &Step =
+          cast<SCEVConstant>(AR->getStepRecurrence(SE))->getAPInt();
+      Type *T = P->getType();
+      Value *Start = P->getIncomingValueForBlock(L->getLoopPreheader());
+      Value *KT = B.CreateSExtOrTrunc(K, T);
+      Value *Base = B.CreateAdd(Start, B.CreateMul(KT, ConstantInt::get(T, Step)));
+      SmallVector<Constant*, 16> Lanes;
+      for (unsigned l = 0; l < VF; ++l)
+        Lanes.push_back(ConstantInt::get(T, Step * l));
+      W = B.CreateAdd(B.CreateVectorSplat(VF, Base), ConstantVector::get(Lanes),
+                      P->getName() + ".chunk");
+    } else {
+      // Rebuild with widened operands; poison-generating flags are dropped
+      // since lanes past the exit were never evaluated by the original loop.
+      SmallVector<Value*, 3> Ops;
+      for (Value *Op : I->operands()) Ops.push_back(widen(Op));
+      if (auto *BO = dyn_cast<BinaryOperator>(I))
+        W = B.CreateBinOp(BO->getOpcode(), Ops[0], Ops[1]);
+      else if (auto *CI = dyn_cast<CastInst>(I))
+        W = B.CreateCast(CI->getOpcode(), Ops[0],
+                         FixedVectorType::get(CI->getType(), VF));
+      else if (auto *Cmp = dyn_cast<CmpInst>(I))
+        W = B.CreateCmp(Cmp->getPredicate(), Ops[0], Ops[1]);
+      else if (isa<SelectInst>(I))
+        W = B.CreateSelect(Ops[0], Ops[1], Ops[2]);
+      else
+        W = B.CreateFreeze(Ops[0]);
+    }
+    VMap[I] = W;
+  }
+
+  Value *Exit = widen(C.ExitBr->getCondition());
+  if (!C.ExitOnTrue) Exit = B.CreateNot(Exit);
+  // lanes outside the mask come from a poison passthru: select them away
+  // (an `and` with false would still be poison)
+  if (Mask) Exit = B.CreateSelect(Mask, Exit, Constant::getNullValue(Exit->getType()));
+  return B.CreateOrReduce(B.CreateFreeze(Exit, "ee.lanes"));
+}
+
+static void rewriteLoop(Function &F, Candidate &C, ScalarEvolution &SE,
+                        LoopInfo &LI) {
+  Loop *L = C.L;
+  BasicBlock *PH = L->getLoopPreheader();
+  BasicBlock *Header = L->getHeader();
+  LLVMContext &Ctx = F.getContext();
+  const DataLayout &DL = F.getParent()->getDataLayout();
+  unsigned VF = C.VF;
+
+  // Preheader: trip bound, stream bases and loop-invariant splats.
+  SCEVExpander Exp(SE, DL, "vecopt.ee");
+  Instruction *PHTerm = PH->getTerminator();
+  IRBuilder<> B(PHTerm);
+  Type *I64 = B.getInt64Ty();
+  Value *EC = B.CreateZExt(
+      Exp.expandCodeFor(C.ExitCount, C.ExitCount->getType(), PHTerm), I64,
+      "ee.count");
+  SmallVector<Value*, 4> Bases;
+  for (const Stream &S : C.Streams)
+    Bases.push_back(Exp.expandCodeFor(S.AR->getStart(),
+                                      S.Load->getPointerOperandType(), PHTerm));
+  DenseMap<Value*, Value*> Splats;
+  for (Instruction *I : C.Slice)
+    for (Value *Op : I->operands())
+      if (L->isLoopInvariant(Op) && !Splats.count(Op))
+        Splats[Op] = B.CreateVectorSplat(VF, Op, Op->getName() + ".splat");
+
+  // Page-safe mode starts at the aligned block holding iteration 0.
+  Value *KStart = ConstantInt::get(I64, 0);
+  if (C.AlignLoad) {
+    unsigned Idx = 0;
+    while (C.Streams[Idx].Load != C.AlignLoad) ++Idx;
+    uint64_t Size = DL.getTypeStoreSize(C.AlignLoad->getType());
+    Value *Addr = B.CreatePtrToInt(Bases[Idx], I64);
+    Value *Mis = B.CreateLShr(B.CreateAnd(Addr, Size * VF - 1), Log2_64(Size),
+                              "ee.head");
+    KStart = B.CreateNeg(Mis, "ee.kstart");
+  }
+  auto fits = [&](Value *K) {
+    return B.CreateICmpSLE(B.CreateAdd(K, ConstantInt::get(I64, VF)), EC);
+  };
+  Value *Enter = fits(KStart);
+
+  BasicBlock *HeadBB =
+      C.AlignLoad ? BasicBlock::Create(Ctx, "ee.head", &F, Header) : nullptr;
+  BasicBlock *BodyBB = BasicBlock::Create(Ctx, "ee.chunk", &F, Header);
+  BasicBlock *ResumeBB = BasicBlock::Create(Ctx, "ee.resume", &F, Header);
+  B.CreateCondBr(Enter, HeadBB ? HeadBB : BodyBB, ResumeBB);
+  PHTerm->eraseFromParent();
+
+  Value *HeadNext = nullptr, *HeadResume = nullptr;
+  if (HeadBB) {
+    // Lanes before iteration 0 are masked off and never touch memory.
+    B.SetInsertPoint(HeadBB);
+    SmallVector<Constant*, 16> Lanes;
+    for (unsigned l = 0; l < VF; ++l) Lanes.push_back(ConstantInt::get(I64, l));
+    Value *Mask = B.CreateICmpSGE(
+        B.CreateAdd(B.CreateVectorSplat(VF, KStart), ConstantVector::get(Lanes)),
+        ConstantAggregateZero::get(FixedVectorType::get(I64, VF)), "ee.mask");
+    Value *Hit = emitChunkTest(B, C, KStart, Mask, Bases, Splats, SE);
+    HeadNext = B.CreateAdd(KStart, ConstantInt::get(I64, VF));
+    HeadResume = B.CreateSelect(Hit, ConstantInt::get(I64, 0), HeadNext);
+    B.CreateCondBr(B.CreateOr(Hit, B.CreateNot(fits(HeadNext))), ResumeBB, BodyBB);
+  }
+
+  B.SetInsertPoint(BodyBB);
+  PHINode *K = B.CreatePHI(I64, 3, "ee.k");
+  if (HeadBB) K->addIncoming(HeadNext, HeadBB);
+  else K->addIncoming(KStart, PH);
+  Value *Hit = emitChunkTest(B, C, K, nullptr, Bases, Splats, SE);
+  Value *KNext = B.CreateAdd(K, ConstantInt::get(I64, VF), "ee.k.next");
+  K->addIncoming(KNext, BodyBB);
+  Value *BodyResume = B.CreateSelect(Hit, K, KNext);
+  B.CreateCondBr(B.CreateOr(Hit, B.CreateNot(fits(KNext))), ResumeBB, BodyBB);
+
+  // Resume: re-materialize every header IV at the first untested iteration.
+  B.SetInsertPoint(ResumeBB);
+  PHINode *R = B.CreatePHI(I64, 3, "ee.resume.iter");
+  R->addIncoming(ConstantInt::get(I64, 0), PH);
+  if (HeadBB) R->addIncoming(HeadResume, HeadBB);
+  R->addIncoming(BodyResume, BodyBB);
+  for (PHINode &P : Header->phis()) {
+    const SCEVAddRecExpr *AR = getAffineIV(&P, L, SE);
+    const APInt &Step =
+        cast<SCEVConstant>(AR->getStepRecurrence(SE))->getAPInt();
+    Value *Start = P.getIncomingValueForBlock(PH);
+    Value *V;
+    if (P.getType()->isPointerTy()) {
+      V = B.CreateGEP(B.getInt8Ty(), Start,
+                      B.CreateMul(R, ConstantInt::get(I64, Step.sextOrTrunc(64))),
+                      P.getName() + ".resume");
+    } else {
+      Type *T = P.getType();
+      V = B.CreateAdd(Start,
+                      B.CreateMul(B.CreateSExtOrTrunc(R, T), ConstantInt::get(T, Step)),
+                      P.getName() + ".resume");
+    }
+    int Idx = P.getBasicBlockIndex(PH);
+    P.setIncomingBlock(Idx, ResumeBB);
+    P.setIncomingValue(Idx, V);
+  }
+  B.CreateBr(Header);
+
+  if (Loop *Parent = L->getParentLoop()) {
+    if (HeadBB) Parent->addBasicBlockToLoop(HeadBB, LI);
+    Parent->addBasicBlockToLoop(BodyBB, LI);
+    Parent->addBasicBlockToLoop(ResumeBB, LI);
+  }
+  SE.forgetLoop(L);
+
+  printLoc(F.getName(), *C.ExitBr);
+  errs() << "early-exit loop -> " << VF << "-wide chunked any-of search"
+         << (C.AlignLoad ? " (page-aligned)" : "") << "\n";
+}
+
+//------------------------------------------------------------------------------
+// Pass
+//------------------------------------------------------------------------------
+PreservedAnalyses vecopt::EarlyExitVecPass::run(Function &F,
+                                                FunctionAnalysisManager &FAM) {
+  if (!EnableEarlyExit) return PreservedAnalyses::all();
+
+  LoopInfo &LI = FAM.getResult<LoopAnalysis>(F);
+  ScalarEvolution &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+  DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+  TargetTransformInfo &TTI = FAM.getResult<TargetIRAnalysis>(F);
+  AssumptionCache &AC = FAM.getResult<AssumptionAnalysis>(F);
+
+  // The chunk loop is hosted in the preheader, but LoopSimplify only runs
+  // again after VectorizerStart; form it here for innermost loops.
+  bool Changed = false;
+  for (Loop *L : LI.getLoopsInPreorder())
+    if (L->isInnermost() && !L->getLoopPreheader())
+      Changed |= simplifyLoop(L, &DT, &LI, &SE, &AC, nullptr, false);
+
+  // Analyze everything first: candidates are disjoint innermost loops and the
+  // rewrite only adds blocks in front of each one.
+  SmallVector<Candidate, 4> Work;
+  for (Loop *L : LI.getLoopsInPreorder()) {
+    Candidate C;
+    if (analyzeLoop(L, SE, DT, TTI, C))
+      Work.push_back(std::move(C));
+  }
+  for (Candidate &C : Work) {
+    const SCEV *EC = C.ExitCount;
+#if LLVM_VERSION_MAJOR >= 16
+    SCEVExpander Check(SE, F.getParent()->getDataLayout(), "vecopt.ee");
+    bool Safe = Check.isSafeToExpand(EC);
+#else
+    bool Safe = isSafeToExpand(EC, SE);
+#endif
+    for (const Stream &S : C.Streams)
+#if LLVM_VERSION_MAJOR >= 16
+      Safe &= Check.isSafeToExpand(S.AR->getStart());
+#else
+      Safe &= isSafeToExpand(S.AR->getStart(), SE);
+#endif
+    if (!Safe) continue;
+    rewriteLoop(F, C, SE, LI);
+    Changed = true;
+  }
+  return Changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+}
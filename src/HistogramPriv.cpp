@@ -0,0 +1,339 @@
+//===- HistogramPriv.cpp -----------------------------------------*- C++ -*-===//
+//
+// VecOpt histogram privatization: break the loop-carried memory dependence of
+//
+//   for (i = 0; i < n; ++i) hist[idx[i]] += w;
+//
+// Consecutive iterations that hit the same bucket serialize on the
+// store -> load round trip. The loop is rewritten to update one of K private,
+// zero-initialized sub-histograms selected by (IV & (K-1)), so K consecutive
+// iterations never touch the same slot. After the loop the copies are summed
+// back into the original table (only buckets with a non-zero delta are
+// written, so untouched entries are never accessed).
+//
+// Guards:
+//  - Innermost loop with a unit-step integer IV and a single dedicated exit.
+//  - Updates are `load p; add/sub; store p` on an integer element addressed
+//    as gep T, base, idx (or gep [N x T], base, 0, idx) with an invariant
+//    base; neither the loaded nor the updated value has other users.
+//  - SCEV bounds idx to a small non-negative range (the private table size).
+//  - No other memory access in the loop may alias the table.
+//
+//===----------------------------------------------------------------------===//
+
+#include "VecOpt/VecOpt.h"
+
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/LoopSimplify.h"
+
+using namespace llvm;
+using vecopt::printLoc;
+
+//------------------------------------------------------------------------------
+// Options
+//------------------------------------------------------------------------------
+static cl::opt<bool> EnableHistogram(
+    "vecopt-histogram",
+    cl::desc("Privatize hist[idx[i]] += v updates into per-slot copies"),
+    cl::init(true));
+
+static cl::opt<unsigned> HistCopies(
+    "vecopt-hist-copies",
+    cl::desc("Number of private sub-histograms (power of two)"),
+    cl::init(4));
+
+static cl::opt<unsigned> HistMaxBytes(
+    "vecopt-hist-max-bytes",
+    cl::desc("Maximum total bytes of private sub-histograms per table"),
+    cl::init(16384));
+
+//------------------------------------------------------------------------------
+// Candidate analysis
+//------------------------------------------------------------------------------
+namespace {
+struct Update {
+  LoadInst *Load;
+  StoreInst *Store;
+  GetElementPtrInst *GEP;
+};
+
+struct Table {
+  Value *Base;
+  Type *EltTy;
+  uint64_t Buckets = 0;
+  SmallVector<Update, 4> Updates;
+};
+
+struct Candidate {
+  Loop *L = nullptr;
+  PHINode *IV = nullptr;
+  SmallVector<Table, 2> Tables;
+};
+} // namespace
+
+static Value *getBucketIndex(GetElementPtrInst *GEP) {
+  return GEP->getOperand(GEP->getNumOperands() - 1);
+}
+
+// Match `store (add/sub (load p), v), p` with p = gep over an invariant base.
+static bool matchUpdate(StoreInst *S, Loop *L, Update &U) {
+  if (!S->isSimple()) return false;
+  auto *Op = dyn_cast<BinaryOperator>(S->getValueOperand());
+  if (!Op || !Op->hasOneUse() ||
+      (Op->getOpcode() != Instruction::Add &&
+       Op->getOpcode() != Instruction::Sub))
+    return false;
+  auto *LD = dyn_cast<LoadInst>(Op->getOperand(0));
+  if (!LD && Op->getOpcode() == Instruction::Add)
+    LD = dyn_cast<LoadInst>(Op->getOperand(1));
+  if (!LD || !LD->isSimple() || !LD->hasOneUse() ||
+      LD->getParent() != S->getParent() ||
+      LD->getPointerOperand() != S->getPointerOperand())
+    return false;
+  auto *GEP = dyn_cast<GetElementPtrInst>(S->getPointerOperand());
+  if (!GEP || !L->contains(GEP) || !L->isLoopInvariant(GEP->getPointerOperand()))
+    return false;
+
+  Type *T = LD->getType();
+  Type *Src = GEP->getSourceElementType();
+  if (GEP->getNumIndices() == 1) {
+    if (Src != T) return false;
+  } else if (GEP->getNumIndices() == 2) {
+    auto *AT = dyn_cast<ArrayType>(Src);
+    auto *Zero = dyn_cast<ConstantInt>(GEP->getOperand(1));
+    if (!AT || AT->getElementType() != T || !Zero || !Zero->isZero())
+      return false;
+  } else {
+    return false;
+  }
+  if (!T->isIntegerTy() || L->isLoopInvariant(getBucketIndex(GEP)))
+    return false;
+  U = {LD, S, GEP};
+  return true;
+}
+
+static bool analyzeLoop(Loop *L, ScalarEvolution &SE, AAResults &AA,
+                        Candidate &C) {
+  if (!L->isInnermost() || !L->isLoopSimplifyForm() || !L->getExitBlock())
+    return false;
+
+  for (PHINode &P : L->getHeader()->phis()) {
+    if (!P.getType()->isIntegerTy() || !SE.isSCEVable(P.getType())) continue;
+    auto *AR = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(&P));
+    if (!AR || AR->getLoop() != L || !AR->isAffine()) continue;
+    auto *Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+    if (Step && (Step->getAPInt().isOne() || Step->getAPInt().isAllOnes())) {
+      C.IV = &P;
+      break;
+    }
+  }
+  if (!C.IV) return false;
+
+  for (BasicBlock *BB : L->blocks())
+    for (Instruction &I : *BB) {
+      auto *S = dyn_cast<StoreInst>(&I);
+      Update U;
+      if (!S || !matchUpdate(S, L, U)) continue;
+      Value *Base = U.GEP->getPointerOperand();
+      Table *T = nullptr;
+      for (Table &Existing : C.Tables)
+        if (Existing.Base == Base && Existing.EltTy == U.Load->getType())
+          T = &Existing;
+      if (!T) {
+        C.Tables.push_back({Base, U.Load->getType(), 0, {}});
+        T = &C.Tables.back();
+      }
+      T->Updates.push_back(U);
+    }
+  if (C.Tables.empty()) return false;
+
+  const DataLayout &DL = L->getHeader()->getModule()->getDataLayout();
+  unsigned MaxTC = SE.getSmallConstantMaxTripCount(L);
+  for (Table &T : C.Tables) {
+    Type *IdxTy = getBucketIndex(T.Updates.front().GEP)->getType();
+    for (Update &U : T.Updates) {
+      Value *Idx = getBucketIndex(U.GEP);
+      // The merge maps buckets back through one index type.
+      if (Idx->getType() != IdxTy) return false;
+      ConstantRange R = SE.getUnsignedRange(SE.getSCEV(Idx));
+      if (R.getUnsignedMax().getActiveBits() > 32) return false;
+      T.Buckets = std::max<uint64_t>(T.Buckets,
+                                     R.getUnsignedMax().getZExtValue() + 1);
+    }
+    uint64_t Bytes = T.Buckets * DL.getTypeAllocSize(T.EltTy) * HistCopies;
+    if (Bytes > HistMaxBytes) return false;
+    // Zeroing and merging cost O(Buckets); not worth it for short loops.
+    if (MaxTC && MaxTC < T.Buckets) return false;
+  }
+
+  // Every other memory access must leave the tables alone.
+  for (BasicBlock *BB : L->blocks())
+    for (Instruction &I : *BB) {
+      if (!I.mayReadOrWriteMemory()) continue;
+      if (I.mayThrow() || I.isVolatile()) return false;
+      for (Table &T : C.Tables) {
+        bool Own = false;
+        for (Update &U : T.Updates)
+          Own |= &I == U.Load || &I == U.Store;
+        if (Own) continue;
+        MemoryLocation Loc = MemoryLocation::getBeforeOrAfter(T.Base);
+        if (!isNoModRef(AA.getModRefInfo(&I, Loc))) return false;
+      }
+    }
+  C.L = L;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Rewrite
+//------------------------------------------------------------------------------
+static void privatizeTable(Function &F, Candidate &C, Table &T, Value *Slot,
+                           LoopInfo &LI) {
+  Loop *L = C.L;
+  LLVMContext &Ctx = F.getContext();
+  const DataLayout &DL = F.getParent()->getDataLayout();
+  Type *I64 = Type::getInt64Ty(Ctx);
+  uint64_t EltBytes = DL.getTypeAllocSize(T.EltTy);
+  uint64_t Copies = HistCopies;
+
+  // Private copies live in the entry block so they stay a static alloca.
+  IRBuilder<> B(&*F.getEntryBlock().getFirstInsertionPt());
+  AllocaInst *Priv = B.CreateAlloca(
+      ArrayType::get(T.EltTy, Copies * T.Buckets), nullptr, "hist.priv");
+  Priv->setAlignment(Align(64));
+
+  B.SetInsertPoint(L->getLoopPreheader()->getTerminator());
+  B.CreateMemSet(Priv, B.getInt8(0), Copies * T.Buckets * EltBytes, Align(64));
+
+  // Redirect every update of this table to row `Slot` of the private copy.
+  // Slot sits at the top of the header, so the row offset goes right after it.
+  B.SetInsertPoint(cast<Instruction>(Slot)->getNextNode());
+  Value *Row = B.CreateMul(Slot, ConstantInt::get(I64, T.Buckets), "hist.row");
+  for (Update &U : T.Updates) {
+    B.SetInsertPoint(U.Load);
+    // Zero-extend, matching the unsigned range the rows were sized with: an
+    // i8 index of 200 is bucket 200, not 56 before the row. The merge
+    // truncates the bucket back to the index type, so its GEP extends it
+    // exactly as the original update did.
+    Value *Idx = B.CreateZExtOrTrunc(getBucketIndex(U.GEP), I64);
+    Value *P = B.CreateInBoundsGEP(T.EltTy, Priv, B.CreateAdd(Row, Idx),
+                                   "hist.priv.addr");
+    U.Load->setOperand(LoadInst::getPointerOperandIndex(), P);
+    U.Store->setOperand(StoreInst::getPointerOperandIndex(), P);
+    U.Load->setAAMetadata(AAMDNodes());
+    U.Store->setAAMetadata(AAMDNodes());
+    // Partial sums start at zero, so nsw/nuw of the original update no
+    // longer hold.
+    cast<Instruction>(U.Store->getValueOperand())->dropPoisonGeneratingFlags();
+  }
+
+  // Merge loop on the exit edge: hist[b] += sum_k priv[k][b] when non-zero.
+  BasicBlock *Exit = L->getExitBlock();
+  BasicBlock *Rest = SplitBlock(Exit, &*Exit->getFirstInsertionPt(),
+                                (DominatorTree *)nullptr, &LI);
+  BasicBlock *Body = BasicBlock::Create(Ctx, "hist.merge", &F, Rest);
+  BasicBlock *Upd = BasicBlock::Create(Ctx, "hist.merge.upd", &F, Rest);
+  BasicBlock *Latch = BasicBlock::Create(Ctx, "hist.merge.latch", &F, Rest);
+  Exit->getTerminator()->setSuccessor(0, Body);
+
+  B.SetInsertPoint(Body);
+  PHINode *Bkt = B.CreatePHI(I64, 2, "hist.bucket");
+  Bkt->addIncoming(ConstantInt::get(I64, 0), Exit);
+  Value *Sum = nullptr;
+  for (uint64_t k = 0; k < Copies; ++k) {
+    Value *P = B.CreateInBoundsGEP(
+        T.EltTy, Priv, B.CreateAdd(Bkt, ConstantInt::get(I64, k * T.Buckets)));
+    Value *V = B.CreateAlignedLoad(T.EltTy, P, Align(EltBytes));
+    Sum = Sum ? B.CreateAdd(Sum, V) : V;
+  }
+  Sum->setName("hist.sum");
+  B.CreateCondBr(B.CreateIsNotNull(Sum), Upd, Latch);
+
+  B.SetInsertPoint(Upd);
+  auto *Dst = cast<GetElementPtrInst>(T.Updates.front().GEP->clone());
+  Dst->setIsInBounds(false);
+  Value *OrigIdx = getBucketIndex(Dst);
+  Dst->setOperand(Dst->getNumOperands() - 1,
+                  B.CreateZExtOrTrunc(Bkt, OrigIdx->getType()));
+  B.Insert(Dst, "hist.addr");
+  Align A = T.Updates.front().Store->getAlign();
+  Value *Old = B.CreateAlignedLoad(T.EltTy, Dst, A, "hist.old");
+  B.CreateAlignedStore(B.CreateAdd(Old, Sum), Dst, A);
+  B.CreateBr(Latch);
+
+  B.SetInsertPoint(Latch);
+  Value *Next = B.CreateAdd(Bkt, ConstantInt::get(I64, 1), "hist.bucket.next");
+  Bkt->addIncoming(Next, Latch);
+  B.CreateCondBr(B.CreateICmpEQ(Next, ConstantInt::get(I64, T.Buckets)), Rest,
+                 Body);
+
+  if (Loop *Parent = L->getParentLoop()) {
+    Parent->addBasicBlockToLoop(Body, LI);
+    Parent->addBasicBlockToLoop(Upd, LI);
+    Parent->addBasicBlockToLoop(Latch, LI);
+  }
+
+  for (Update &U : T.Updates)
+    if (U.GEP->use_empty()) U.GEP->eraseFromParent();
+}
+
+static void rewriteLoop(Function &F, Candidate &C, LoopInfo &LI) {
+  IRBuilder<> B(&*C.L->getHeader()->getFirstInsertionPt());
+  Type *I64 = B.getInt64Ty();
+  Value *Slot = B.CreateAnd(B.CreateZExtOrTrunc(C.IV, I64),
+                            ConstantInt::get(I64, HistCopies - 1), "hist.slot");
+  for (Table &T : C.Tables)
+    privatizeTable(F, C, T, Slot, LI);
+
+  printLoc(F.getName(), *C.L->getHeader()->getTerminator());
+  errs() << "histogram update -> " << HistCopies << " private copies ("
+         << C.Tables.size() << " table" << (C.Tables.size() > 1 ? "s" : "")
+         << ")\n";
+}
+
+//------------------------------------------------------------------------------
+// Pass
+//------------------------------------------------------------------------------
+PreservedAnalyses vecopt::HistogramPrivPass::run(Function &F,
+                                                 FunctionAnalysisManager &FAM) {
+  if (!EnableHistogram || !isPowerOf2_32(HistCopies) || HistCopies < 2)
+    return PreservedAnalyses::all();
+
+  LoopInfo &LI = FAM.getResult<LoopAnalysis>(F);
+  ScalarEvolution &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+  DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+  AssumptionCache &AC = FAM.getResult<AssumptionAnalysis>(F);
+  AAResults &AA = FAM.getResult<AAManager>(F);
+
+  // Merging needs a dedicated exit; LoopSimplify only runs again after
+  // VectorizerStart, so form it here for innermost loops.
+  bool Changed = false;
+  for (Loop *L : LI.getLoopsInPreorder())
+    if (L->isInnermost() && !L->isLoopSimplifyForm())
+      Changed |= simplifyLoop(L, &DT, &LI, &SE, &AC, nullptr, false);
+
+  SmallVector<Candidate, 4> Work;
+  for (Loop *L : LI.getLoopsInPreorder()) {
+    Candidate C;
+    if (analyzeLoop(L, SE, AA, C))
+      Work.push_back(std::move(C));
+  }
+  for (Candidate &C : Work) {
+    rewriteLoop(F, C, LI);
+    Changed = true;
+  }
+  return Changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+}
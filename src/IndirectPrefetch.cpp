@@ -0,0 +1,362 @@
+//===- IndirectPrefetch.cpp --------------------------------------*- C++ -*-===//
+//
+// VecOpt indirect prefetch: for gather-style loops
+//
+//   for (i = 0; i < n; ++i) ... = b[a[i]];
+//
+// the hardware stream prefetcher covers a[] but not b[], so every b[] access
+// that misses the caches stalls the loop. The x86 backend does not enable
+// LoopDataPrefetch, and that pass only handles strided addresses anyway.
+// For each such load, emit
+//
+//   a_ahead = (i + D <= last) ? &a[i + D] : &a[i]     // guarded index load
+//   llvm.prefetch(&b[*a_ahead])
+//
+// where D = ceil(latency / loop body size), capped by the trip count.
+//
+// Guards:
+//  - Innermost loop with a preheader, a latch and a computable backedge-taken
+//    count (needed for the guard).
+//  - The index load a[i] is simple, executes on every iteration before any
+//    exit and has an affine address with a constant stride.
+//  - The indirect address is gep base, f(a[i]) with an invariant base, where
+//    f is a chain of casts and non-trapping binary ops with invariant
+//    operands.
+//  - Tables known to fit in L1 (-vecopt-pf-min-table-bytes) are skipped.
+//
+// Runs at OptimizerLast, after LV/SLP: a prefetch call in the loop body would
+// otherwise block vectorization. Vectorized bodies are covered too: for a
+// llvm.masked.gather fed by a wide load of a[], every lane of b[a[i+D]] is
+// prefetched, and gathers LV scalarized reach a[] through extractelement.
+//
+//===----------------------------------------------------------------------===//
+
+#include "VecOpt/VecOpt.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/LoopSimplify.h"
+#include "llvm/Transforms/Utils/ScalarEvolutionExpander.h"
+
+#include <algorithm>
+#include <optional>
+
+using namespace llvm;
+using vecopt::printLoc;
+
+//------------------------------------------------------------------------------
+// Options
+//------------------------------------------------------------------------------
+static cl::opt<bool> EnableIndirectPrefetch(
+    "vecopt-indirect-prefetch",
+    cl::desc("Prefetch b[a[i+D]] for indirect loads b[a[i]] in inner loops"),
+    cl::init(true));
+
+static cl::opt<unsigned> PFDistance(
+    "vecopt-pf-distance",
+    cl::desc("Prefetch distance in iterations (0 = latency model)"),
+    cl::init(0));
+
+static cl::opt<unsigned> PFLatency(
+    "vecopt-pf-latency",
+    cl::desc("Miss latency to cover, in instructions, for the distance model"),
+    cl::init(200));
+
+static cl::opt<unsigned> PFMaxDistance(
+    "vecopt-pf-max-distance",
+    cl::desc("Upper bound on the modelled prefetch distance"),
+    cl::init(64));
+
+static cl::opt<bool> PFGuard(
+    "vecopt-pf-guard",
+    cl::desc("Clamp the look-ahead index load to the last iteration; disable "
+             "only if index arrays are padded by the prefetch distance"),
+    cl::init(true));
+
+static cl::opt<uint64_t> PFMinTableBytes(
+    "vecopt-pf-min-table-bytes",
+    cl::desc("Skip tables of known size below this many bytes"),
+    cl::init(32768));
+
+//------------------------------------------------------------------------------
+// Candidate analysis
+//------------------------------------------------------------------------------
+namespace {
+struct Site {
+  LoadInst *Index;          // a[i]
+  const SCEVAddRecExpr *AR; // address of a[i]
+  int64_t Stride;           // bytes per iteration
+  Instruction *Gather;      // b[a[i]]: a load or a masked gather
+  GetElementPtrInst *GEP;   // &b[f(a[i])], a vector of pointers for a gather
+  SmallVector<Instruction *, 4> Chain; // f, from a[i] outwards
+};
+} // namespace
+
+// Walk V back to Index through casts, non-trapping binary ops with
+// loop-invariant other operands and constant-lane extracts, collecting the
+// chain (outermost first).
+static LoadInst *findIndexLoad(Value *V, Loop *L,
+                               SmallVectorImpl<Instruction *> &Chain) {
+  while (true) {
+    if (auto *LI = dyn_cast<LoadInst>(V))
+      return L->contains(LI) ? LI : nullptr;
+    auto *I = dyn_cast<Instruction>(V);
+    if (!I || !L->contains(I)) return nullptr;
+    if (isa<CastInst>(I) ||
+        (isa<ExtractElementInst>(I) && isa<ConstantInt>(I->getOperand(1)))) {
+      Chain.push_back(I);
+      V = I->getOperand(0);
+      continue;
+    }
+    auto *BO = dyn_cast<BinaryOperator>(I);
+    if (!BO) return nullptr;
+    switch (BO->getOpcode()) {
+    case Instruction::Add: case Instruction::Sub: case Instruction::Mul:
+    case Instruction::Shl: case Instruction::LShr: case Instruction::AShr:
+    case Instruction::And: case Instruction::Or:  case Instruction::Xor:
+      break;
+    default:
+      return nullptr; // div/rem may trap on the look-ahead value
+    }
+    bool Inv0 = L->isLoopInvariant(BO->getOperand(0));
+    bool Inv1 = L->isLoopInvariant(BO->getOperand(1));
+    if (Inv0 == Inv1) return nullptr;
+    Chain.push_back(BO);
+    V = BO->getOperand(Inv0 ? 1 : 0);
+  }
+}
+
+// Size of the object behind Base if it is a global of known type.
+static std::optional<uint64_t> knownTableBytes(Value *Base,
+                                               const DataLayout &DL) {
+  auto *GV = dyn_cast<GlobalVariable>(Base->stripPointerCasts());
+  if (!GV || GV->isInterposable()) return std::nullopt;
+  return DL.getTypeAllocSize(GV->getValueType()).getFixedValue();
+}
+
+static bool analyzeGather(Instruction *G, Loop *L, ScalarEvolution &SE,
+                          DominatorTree &DT, Site &S) {
+  Value *Ptr;
+  if (auto *LI = dyn_cast<LoadInst>(G)) {
+    if (!LI->isSimple()) return false;
+    Ptr = LI->getPointerOperand();
+  } else if (auto *II = dyn_cast<IntrinsicInst>(G);
+             II && II->getIntrinsicID() == Intrinsic::masked_gather &&
+             isa<FixedVectorType>(II->getType())) {
+    Ptr = II->getArgOperand(0);
+  } else {
+    return false;
+  }
+  auto *GEP = dyn_cast<GetElementPtrInst>(Ptr);
+  if (!GEP || !L->contains(GEP)) return false;
+
+  // Exactly one varying operand, the last index.
+  for (unsigned i = 0, e = GEP->getNumOperands() - 1; i < e; ++i)
+    if (!L->isLoopInvariant(GEP->getOperand(i))) return false;
+  S.Chain.clear();
+  LoadInst *Idx = findIndexLoad(GEP->getOperand(GEP->getNumOperands() - 1), L,
+                                S.Chain);
+  if (!Idx || Idx == G || !Idx->isSimple()) return false;
+  std::reverse(S.Chain.begin(), S.Chain.end()); // from a[i] outwards
+  // a[i] must be read in every iteration the loop starts, the last one
+  // included, or the guard's a[start + BTC*stride] can be past the end of
+  // what the loop reads (an exit such as `if (i >= m) break;` before it).
+  if (!DT.dominates(Idx->getParent(), L->getLoopLatch())) return false;
+  SmallVector<BasicBlock *, 4> Exiting;
+  L->getExitingBlocks(Exiting);
+  for (BasicBlock *BB : Exiting)
+    if (!DT.dominates(Idx->getParent(), BB)) return false;
+
+  auto *AR = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(Idx->getPointerOperand()));
+  if (!AR || AR->getLoop() != L || !AR->isAffine()) return false;
+  auto *Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+  if (!Step || !Step->getAPInt().isSignedIntN(32) || Step->isZero())
+    return false;
+
+  S.Index = Idx;
+  S.AR = AR;
+  S.Stride = Step->getAPInt().getSExtValue();
+  S.Gather = G;
+  S.GEP = GEP;
+  return true;
+}
+
+// D iterations ahead should cover one miss latency at ~1 instruction/cycle,
+// but looking past half the trip count only prefetches the clamp target.
+static unsigned prefetchDistance(Loop *L, ScalarEvolution &SE) {
+  if (PFDistance) return PFDistance;
+  unsigned Size = 0;
+  for (BasicBlock *BB : L->blocks())
+    for (Instruction &I : *BB)
+      if (!isa<PHINode>(I) && !I.isDebugOrPseudoInst()) ++Size;
+  unsigned D = divideCeil(PFLatency, std::max(Size, 1u));
+  D = std::min(std::max(D, 1u), (unsigned)PFMaxDistance);
+  if (unsigned TC = SE.getSmallConstantTripCount(L))
+    D = std::min(D, TC / 2);
+  return D;
+}
+
+//------------------------------------------------------------------------------
+// Rewrite
+//------------------------------------------------------------------------------
+
+// Load a[i+D] (clamped to the last iteration's element when guarding) right
+// after a[i]. Last is the address of a[] in the final iteration.
+static LoadInst *emitLookAhead(const Site &S, unsigned D, Value *Last) {
+  IRBuilder<> B(S.Index->getNextNode());
+  Value *Cur = S.Index->getPointerOperand();
+  Value *Ahead = B.CreateGEP(B.getInt8Ty(), Cur,
+                             B.getInt64(S.Stride * (int64_t)D), "pf.idx.ptr");
+  if (Last) {
+    Value *InRange = S.Stride > 0 ? B.CreateICmpULE(Ahead, Last)
+                                  : B.CreateICmpUGE(Ahead, Last);
+    Ahead = B.CreateSelect(InRange, Ahead, Cur, "pf.idx.clamp");
+  }
+  return B.CreateAlignedLoad(S.Index->getType(), Ahead, S.Index->getAlign(),
+                             "pf.idx");
+}
+
+// Rebuild &b[f(a[i+D])] from Ahead and prefetch it, every lane of it for a
+// gather. Clones drop poison-generating flags and inbounds: the look-ahead
+// address is only prefetched, never dereferenced.
+static void emitPrefetch(const Site &S, LoadInst *Ahead) {
+  IRBuilder<> B(S.Gather);
+  Value *V = Ahead;
+  Value *Prev = S.Index;
+  for (Instruction *I : S.Chain) {
+    Instruction *C = I->clone();
+    C->replaceUsesOfWith(Prev, V);
+    C->dropPoisonGeneratingFlags();
+    B.Insert(C, I->getName() + ".pf");
+    Prev = I;
+    V = C;
+  }
+  auto *G = cast<GetElementPtrInst>(S.GEP->clone());
+  G->setOperand(G->getNumOperands() - 1, V);
+  G->setIsInBounds(false);
+  B.Insert(G, S.GEP->getName() + ".pf");
+
+  Module *M = S.Gather->getModule();
+  Function *PF = Intrinsic::getDeclaration(M, Intrinsic::prefetch,
+                                           G->getType()->getScalarType());
+  auto *VT = dyn_cast<FixedVectorType>(G->getType());
+  for (unsigned Lane = 0, E = VT ? VT->getNumElements() : 1; Lane < E; ++Lane) {
+    Value *P = VT ? B.CreateExtractElement(G, Lane) : G;
+    B.CreateCall(PF, {P, B.getInt32(0), B.getInt32(3), B.getInt32(1)});
+  }
+}
+
+static bool prefetchLoop(Function &F, Loop *L, ScalarEvolution &SE,
+                         DominatorTree &DT) {
+  BasicBlock *Preheader = L->getLoopPreheader();
+  if (!L->isInnermost() || !Preheader || !L->getLoopLatch()) return false;
+
+  const DataLayout &DL = F.getParent()->getDataLayout();
+  SmallVector<Site, 4> Sites;
+  for (BasicBlock *BB : L->blocks())
+    for (Instruction &I : *BB) {
+      Instruction *G = &I;
+      Site S;
+      if (!analyzeGather(G, L, SE, DT, S)) continue;
+      if (auto Bytes = knownTableBytes(S.GEP->getPointerOperand(), DL))
+        if (*Bytes < PFMinTableBytes) {
+          printLoc(F.getName(), *G);
+          errs() << "skip prefetch: table of " << *Bytes
+                 << " bytes stays cached\n";
+          continue;
+        }
+      Sites.push_back(std::move(S));
+    }
+  if (Sites.empty()) return false;
+
+  unsigned D = prefetchDistance(L, SE);
+  if (!D) return false;
+
+  // Address of a[] in the last iteration, for the guard.
+  const SCEV *BTC = SE.getBackedgeTakenCount(L);
+  if (PFGuard && isa<SCEVCouldNotCompute>(BTC)) {
+    printLoc(F.getName(), *Sites.front().Gather);
+    errs() << "skip prefetch: unknown trip count, cannot guard look-ahead\n";
+    return false;
+  }
+  SCEVExpander Exp(SE, DL, "vecopt.pf");
+  DenseMap<LoadInst *, LoadInst *> AheadOf;
+  unsigned Emitted = 0;
+  for (Site &S : Sites) {
+    Value *Last = nullptr;
+    LoadInst *&Ahead = AheadOf[S.Index];
+    if (!Ahead) {
+      if (PFGuard) {
+        Type *IdxTy = SE.getEffectiveSCEVType(S.AR->getType());
+        const SCEV *LastS = SE.getAddExpr(
+            S.AR->getStart(),
+            SE.getMulExpr(SE.getTruncateOrZeroExtend(BTC, IdxTy),
+                          SE.getConstant(IdxTy, S.Stride, true)));
+#if LLVM_VERSION_MAJOR >= 16
+        bool Safe = Exp.isSafeToExpand(LastS);
+#else
+        bool Safe = isSafeToExpand(LastS, SE);
+#endif
+        if (!Safe) continue;
+        Last = Exp.expandCodeFor(LastS, S.AR->getType(),
+                                 Preheader->getTerminator());
+      }
+      Ahead = emitLookAhead(S, D, Last);
+    }
+    emitPrefetch(S, Ahead);
+    printLoc(F.getName(), *S.Gather);
+    if (auto *VT = dyn_cast<FixedVectorType>(S.GEP->getType()))
+      errs() << "gather -> prefetch " << VT->getNumElements() << " lanes ";
+    else
+      errs() << "indirect load -> prefetch ";
+    errs() << D << " iterations ahead" << (PFGuard ? "" : " (unguarded)")
+           << "\n";
+    ++Emitted;
+  }
+  return Emitted != 0;
+}
+
+//------------------------------------------------------------------------------
+// Pass
+//------------------------------------------------------------------------------
+PreservedAnalyses
+vecopt::IndirectPrefetchPass::run(Function &F, FunctionAnalysisManager &FAM) {
+  if (!EnableIndirectPrefetch) return PreservedAnalyses::all();
+
+  LoopInfo &LI = FAM.getResult<LoopAnalysis>(F);
+  ScalarEvolution &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+  DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+  AssumptionCache &AC = FAM.getResult<AssumptionAnalysis>(F);
+
+  // Late SimplifyCFG may have folded preheaders away; the guard's end
+  // address is expanded there.
+  bool CFGChanged = false;
+  for (Loop *L : LI.getLoopsInPreorder())
+    if (L->isInnermost() && !L->getLoopPreheader())
+      CFGChanged |= simplifyLoop(L, &DT, &LI, &SE, &AC, nullptr, false);
+
+  bool Changed = false;
+  for (Loop *L : LI.getLoopsInPreorder())
+    Changed |= prefetchLoop(F, L, SE, DT);
+  if (!Changed && !CFGChanged) return PreservedAnalyses::all();
+  if (CFGChanged) return PreservedAnalyses::none();
+
+  PreservedAnalyses PA;
+  PA.preserveSet<CFGAnalyses>();
+  return PA;
+}
@@ -11,7 +11,11 @@
 //  - Gates: vectorization-friendly types (i32/f32/f64), no-load arms (by default),
 //           cap hoisted insts, skip highly-biased branches, skip loop-invariant
 //           conditions, only inside loops.
-//  - Registered at VectorizerStart so LV/SLP can benefit.
+//  - Optional branch-predictability profile (-vecopt-bp-instrument, then
+//    -vecopt-bp-profile=<file>) replaces the static bias gate.
+//  - Registered at VectorizerStart so LV/SLP can benefit; the blend cleanup
+//    and indirect prefetch stages are registered at OptimizerLast, after
+//    LV/SLP.
 //
 // Tested with LLVM 16–18 style APIs.
 //
@@ -19,6 +23,8 @@
 
 #include <cstdlib> // std::getenv
 
+#include "VecOpt/VecOpt.h"
+
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/CFG.h"
@@ -28,12 +34,21 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Metadata.h"
+#include "llvm/IR/Module.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <memory>
+#include <mutex>
+
 using namespace llvm;
+using vecopt::printLoc;
 
 //------------------------------------------------------------------------------
 // Options
@@ -58,10 +73,28 @@ static cl::opt<bool> AllowLoadHoist(
     cl::desc("Allow hoisting of loads from arms (may increase memory traffic)"),
     cl::init(false));
 
+static cl::opt<bool> BPInstrument(
+    "vecopt-bp-instrument",
+    cl::desc("Instrument candidate branches for runtime/vecopt_bp_rt.c "
+             "instead of converting them"),
+    cl::init(false));
+
+static cl::opt<std::string> BPProfile(
+    "vecopt-bp-profile",
+    cl::desc("Branch profile written by the instrumented run; when given, "
+             "only branches measured as unpredictable are converted"),
+    cl::value_desc("file"), cl::init(""));
+
+static cl::opt<double> BPMinMiss(
+    "vecopt-bp-min-miss",
+    cl::desc("Minimum simulated misprediction rate for conversion with "
+             "-vecopt-bp-profile"),
+    cl::init(0.05));
+
 //------------------------------------------------------------------------------
 // Helpers
 //------------------------------------------------------------------------------
-static void printLoc(StringRef Fn, const Instruction &I) {
+void vecopt::printLoc(StringRef Fn, const Instruction &I) {
   if (const DebugLoc &DL = I.getDebugLoc()) {
     errs() << "[VecOpt] " << Fn << " @ " << DL->getFilename()
            << ":" << DL->getLine() << ": ";
@@ -214,6 +247,105 @@ static bool isHighlyBiased(BranchInst *Br, double Thresh = 8.0) {
   return false;
 }
 
+//------------------------------------------------------------------------------
+// Branch-predictability profile
+//------------------------------------------------------------------------------
+// Candidates are keyed "<function>:<ordinal>", the ordinal counting closed,
+// side-effect-free diamonds in block order. Instrumented and consuming builds
+// must therefore use the same pipeline up to VectorizerStart.
+
+// Runtime site is { ptr key, [8 x i64] }; see runtime/vecopt_bp_rt.c.
+static constexpr unsigned BPSiteWords = 8;
+
+struct BPStat {
+  uint64_t Exec = 0, Taken = 0, Transitions = 0, LocalMiss = 0;
+};
+
+using BranchProfile = StringMap<BPStat>;
+
+static std::shared_ptr<const BranchProfile> loadBranchProfile(StringRef Path) {
+  auto Buf = MemoryBuffer::getFile(Path);
+  if (!Buf) {
+    errs() << "[VecOpt] cannot read branch profile '" << Path
+           << "': " << Buf.getError().message()
+           << " (falling back to static heuristics)\n";
+    return nullptr;
+  }
+  auto Prof = std::make_shared<BranchProfile>();
+  SmallVector<StringRef, 0> Lines;
+  (*Buf)->getBuffer().split(Lines, '\n', -1, false);
+  for (StringRef Line : Lines) {
+    Line = Line.trim();
+    if (Line.empty() || Line.startswith("#")) continue;
+    SmallVector<StringRef, 5> F;
+    Line.split(F, ' ', -1, false);
+    BPStat S;
+    if (F.size() != 5 || F[1].getAsInteger(10, S.Exec) ||
+        F[2].getAsInteger(10, S.Taken) ||
+        F[3].getAsInteger(10, S.Transitions) ||
+        F[4].getAsInteger(10, S.LocalMiss))
+      continue;
+    BPStat &Acc = (*Prof)[F[0]]; // several runs may be concatenated
+    Acc.Exec += S.Exec;
+    Acc.Taken += S.Taken;
+    Acc.Transitions += S.Transitions;
+    Acc.LocalMiss += S.LocalMiss;
+  }
+  return Prof;
+}
+
+// The profile at Path, parsed once per version of the file (path, mtime
+// and size). The pass may run on several threads at once (veclangc -j, the
+// compile server), so the cache is locked; a caller keeps its snapshot
+// even if another thread reloads a newer file meanwhile.
+static std::shared_ptr<const BranchProfile> getBranchProfile(StringRef Path) {
+  struct Entry {
+    bool Exists = false;
+    sys::TimePoint<> MTime;
+    uint64_t Size = 0;
+    std::shared_ptr<const BranchProfile> Prof;
+  };
+  static std::mutex Mu;
+  static StringMap<Entry> Cache;
+
+  sys::fs::file_status St;
+  bool Exists = !sys::fs::status(Path, St) && sys::fs::exists(St);
+  std::lock_guard<std::mutex> Lock(Mu);
+  auto It = Cache.find(Path);
+  if (It != Cache.end() && It->second.Exists == Exists &&
+      (!Exists || (It->second.MTime == St.getLastModificationTime() &&
+                   It->second.Size == St.getSize())))
+    return It->second.Prof;
+  Entry &E = Cache[Path];
+  E.Exists = Exists;
+  if (Exists) {
+    E.MTime = St.getLastModificationTime();
+    E.Size = St.getSize();
+  }
+  E.Prof = loadBranchProfile(Path);
+  return E.Prof;
+}
+
+// Emit __vecopt_bp_record(&site, cond) right before Br.
+static void instrumentBranch(BranchInst *Br, StringRef Key) {
+  Module &M = *Br->getModule();
+  LLVMContext &Ctx = M.getContext();
+  IRBuilder<> B(Br);
+  Type *PtrTy = PointerType::getUnqual(Ctx);
+  Type *I64 = B.getInt64Ty();
+  auto *SiteTy = StructType::get(PtrTy, ArrayType::get(I64, BPSiteWords));
+  Constant *KeyStr = B.CreateGlobalStringPtr(Key, "__vecopt_bp_key");
+  auto *Site = new GlobalVariable(
+      M, SiteTy, /*isConstant=*/false, GlobalValue::PrivateLinkage,
+      ConstantStruct::get(SiteTy, {KeyStr, ConstantAggregateZero::get(
+                                               ArrayType::get(I64, BPSiteWords))}),
+      "__vecopt_bp_site");
+  FunctionCallee Rec = M.getOrInsertFunction(
+      "__vecopt_bp_record",
+      FunctionType::get(B.getVoidTy(), {PtrTy, B.getInt32Ty()}, false));
+  B.CreateCall(Rec, {Site, B.CreateZExt(Br->getCondition(), B.getInt32Ty())});
+}
+
 static Value *maybeFreeze(Value *V, IRBuilder<> &B) {
   if (!EnableFreeze) return V;
   if (isa<Constant>(V)) return V;
@@ -291,15 +423,19 @@ static bool doIfConversion(Function &F, BranchInst *Br,
 //------------------------------------------------------------------------------
 namespace {
 class VecOptPass : public PassInfoMixin<VecOptPass> {
+  bool Rewrite;
+
 public:
+  explicit VecOptPass(bool Rewrite) : Rewrite(Rewrite) {}
+
   PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM) {
     if (F.hasFnAttribute(Attribute::OptimizeNone))
       F.removeFnAttr(Attribute::OptimizeNone);
 
-    if (const char *Env = std::getenv("VECOPT_REWRITE"))
-      EnableRewrite = StringRef(Env) != "0";
-
     LoopInfo &LI = FAM.getResult<LoopAnalysis>(F);
+    std::shared_ptr<const BranchProfile> Prof =
+        (!BPInstrument && !BPProfile.empty()) ? getBranchProfile(BPProfile) : nullptr;
+    unsigned Ordinal = 0;
     bool Changed = false;
     SmallVector<std::tuple<BranchInst*, BasicBlock*, BasicBlock*, BasicBlock*>, 8> Work;
 
@@ -324,19 +460,46 @@ public:
         continue;
       }
 
-      if (isHighlyBiased(Br)) {
+      if (!isSideEffectFreeBlock(ThenBB) || !isSideEffectFreeBlock(ElseBB)) {
         printLoc(F.getName(), *Br);
-        errs() << "skip: highly-biased branch\n";
+        errs() << "diamond with side effects — skip\n";
         continue;
       }
 
-      if (!isSideEffectFreeBlock(ThenBB) || !isSideEffectFreeBlock(ElseBB)) {
+      std::string Key = (F.getName() + ":" + Twine(Ordinal++)).str();
+      if (BPInstrument) {
+        instrumentBranch(Br, Key);
         printLoc(F.getName(), *Br);
-        errs() << "diamond with side effects — skip\n";
+        errs() << "instrumented branch '" << Key << "'\n";
+        Changed = true;
+        continue;
+      }
+
+      if (Prof) {
+        // Measured predictability replaces the static bias heuristic.
+        auto It = Prof->find(Key);
+        if (It == Prof->end() || It->second.Exec == 0) {
+          printLoc(F.getName(), *Br);
+          errs() << "skip: branch '" << Key << "' not in profile\n";
+          continue;
+        }
+        const BPStat &S = It->second;
+        double Miss = (double)S.LocalMiss / (double)S.Exec;
+        if (Miss < BPMinMiss) {
+          printLoc(F.getName(), *Br);
+          errs() << "skip: predictable branch '" << Key << "' (miss "
+                 << format("%.3f", Miss) << ", taken "
+                 << format("%.3f", (double)S.Taken / S.Exec) << ", flips "
+                 << format("%.3f", (double)S.Transitions / S.Exec) << ")\n";
+          continue;
+        }
+      } else if (isHighlyBiased(Br)) {
+        printLoc(F.getName(), *Br);
+        errs() << "skip: highly-biased branch\n";
         continue;
       }
 
-      if (EnableRewrite)
+      if (Rewrite)
         Work.emplace_back(Br, ThenBB, ElseBB, MergeBB);
       else {
         printLoc(F.getName(), *Br);
@@ -359,27 +522,64 @@ public:
 //------------------------------------------------------------------------------
 // Plugin registration
 //------------------------------------------------------------------------------
+// $VECOPT_REWRITE overrides -vecopt-rewrite. Read here rather than in run():
+// the pass may run on several threads at once (veclangc -j).
+static bool rewriteEnabled() {
+  if (const char *Env = std::getenv("VECOPT_REWRITE"))
+    return StringRef(Env) != "0";
+  return EnableRewrite;
+}
+
+void vecopt::registerPassBuilderCallbacks(PassBuilder &PB) {
+  bool Rewrite = rewriteEnabled();
+  // NOTE: LLVM 18 callback has signature (FPM&, OptimizationLevel)
+  PB.registerVectorizerStartEPCallback(
+    [Rewrite](FunctionPassManager &FPM, OptimizationLevel) {
+      FPM.addPass(VecOptPass(Rewrite));
+      FPM.addPass(vecopt::EarlyExitVecPass());
+      FPM.addPass(vecopt::HistogramPrivPass());
+    });
+
+  // Blend cleanup must see the vectorizers' output, and prefetch calls
+  // would block LV, so both run last.
+  PB.registerOptimizerLastEPCallback(
+    [&](ModulePassManager &MPM, OptimizationLevel) {
+      FunctionPassManager FPM;
+      FPM.addPass(vecopt::BlendCleanupPass());
+      FPM.addPass(vecopt::IndirectPrefetchPass());
+      MPM.addPass(createModuleToFunctionPassAdaptor(std::move(FPM)));
+    });
+
+  PB.registerPipelineParsingCallback(
+    [Rewrite](StringRef Name, FunctionPassManager &FPM,
+              ArrayRef<PassBuilder::PipelineElement>) {
+      if (Name == "vecopt") {
+        FPM.addPass(VecOptPass(Rewrite));
+        return true;
+      }
+      if (Name == "vecopt-early-exit") {
+        FPM.addPass(vecopt::EarlyExitVecPass());
+        return true;
+      }
+      if (Name == "vecopt-histogram") {
+        FPM.addPass(vecopt::HistogramPrivPass());
+        return true;
+      }
+      if (Name == "vecopt-blend-cleanup") {
+        FPM.addPass(vecopt::BlendCleanupPass());
+        return true;
+      }
+      if (Name == "vecopt-indirect-prefetch") {
+        FPM.addPass(vecopt::IndirectPrefetchPass());
+        return true;
+      }
+      return false;
+    });
+}
+
 PassPluginLibraryInfo getVecOptPluginInfo() {
-  return {
-    LLVM_PLUGIN_API_VERSION, "VecOpt", "1.2",
-    [](PassBuilder &PB) {
-      // NOTE: LLVM 18 callback has signature (FPM&, OptimizationLevel)
-      PB.registerVectorizerStartEPCallback(
-        [&](FunctionPassManager &FPM, OptimizationLevel) {
-          FPM.addPass(VecOptPass());
-        });
-
-      PB.registerPipelineParsingCallback(
-        [&](StringRef Name, FunctionPassManager &FPM,
-            ArrayRef<PassBuilder::PipelineElement>) {
-          if (Name == "vecopt") {
-            FPM.addPass(VecOptPass());
-            return true;
-          }
-          return false;
-        });
-    }
-  };
+  return {LLVM_PLUGIN_API_VERSION, "VecOpt", vecopt::VersionString,
+          vecopt::registerPassBuilderCallbacks};
 }
 
 extern "C" ::llvm::PassPluginLibraryInfo llvmGetPassPluginInfo() {
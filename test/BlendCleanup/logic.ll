@@ -0,0 +1,62 @@
+; Selects of i1 are logic ops. The arm that select would not have evaluated
+; is frozen unless it is known not to be poison.
+;
+; RUN: %opt -passes=vecopt-blend-cleanup,verify -S %s | %FileCheck %s
+
+; select c, true, false -> c
+define <4 x i1> @mask_itself(<4 x i1> %c) {
+; CHECK-LABEL: define <4 x i1> @mask_itself(
+; CHECK-NEXT:    ret <4 x i1> %c
+  %r = select <4 x i1> %c, <4 x i1> <i1 true, i1 true, i1 true, i1 true>, <4 x i1> zeroinitializer
+  ret <4 x i1> %r
+}
+
+; select c, false, true -> !c
+define i1 @mask_not(i1 %c) {
+; CHECK-LABEL: define i1 @mask_not(
+; CHECK-NEXT:    %r = xor i1 %c, true
+; CHECK-NEXT:    ret i1 %r
+  %r = select i1 %c, i1 false, i1 true
+  ret i1 %r
+}
+
+; select c, true, b -> c | freeze(b)
+define i1 @or(i1 %c, i1 %b) {
+; CHECK-LABEL: define i1 @or(
+; CHECK-NEXT:    %b.frz = freeze i1 %b
+; CHECK-NEXT:    %r = or i1 %c, %b.frz
+; CHECK-NEXT:    ret i1 %r
+  %r = select i1 %c, i1 true, i1 %b
+  ret i1 %r
+}
+
+; select c, a, false -> c & a; a noundef argument needs no freeze
+define <4 x i1> @and(<4 x i1> %c, <4 x i1> noundef %a) {
+; CHECK-LABEL: define <4 x i1> @and(
+; CHECK-NEXT:    %r = and <4 x i1> %c, %a
+; CHECK-NEXT:    ret <4 x i1> %r
+  %r = select <4 x i1> %c, <4 x i1> %a, <4 x i1> zeroinitializer
+  ret <4 x i1> %r
+}
+
+; select c, false, b -> !c & freeze(b)
+define i1 @andnot(i1 %c, i1 %b) {
+; CHECK-LABEL: define i1 @andnot(
+; CHECK-DAG:     [[NC:%.*]] = xor i1 %c, true
+; CHECK-DAG:     %b.frz = freeze i1 %b
+; CHECK:         %r = and i1 [[NC]], %b.frz
+; CHECK-NEXT:    ret i1 %r
+  %r = select i1 %c, i1 false, i1 %b
+  ret i1 %r
+}
+
+; select c, a, true -> !c | freeze(a)
+define i1 @ornot(i1 %c, i1 %a) {
+; CHECK-LABEL: define i1 @ornot(
+; CHECK-DAG:     [[NC:%.*]] = xor i1 %c, true
+; CHECK-DAG:     %a.frz = freeze i1 %a
+; CHECK:         %r = or i1 [[NC]], %a.frz
+; CHECK-NEXT:    ret i1 %r
+  %r = select i1 %c, i1 %a, i1 true
+  ret i1 %r
+}
@@ -0,0 +1,75 @@
+; Chains that only look foldable stay as they are.
+;
+; RUN: %opt -passes=vecopt-blend-cleanup -S %s | %FileCheck %s
+
+; (p < q) and (q < p) are not complements (both false when p == q).
+define <4 x i32> @swapped_not_complement(<4 x i32> %p, <4 x i32> %q, <4 x i32> %a, <4 x i32> %x, <4 x i32> %y) {
+; CHECK-LABEL: define <4 x i32> @swapped_not_complement(
+; CHECK:         %in = select <4 x i1> %nc, <4 x i32> %x, <4 x i32> %y
+; CHECK-NEXT:    %r = select <4 x i1> %c, <4 x i32> %a, <4 x i32> %in
+  %c = icmp slt <4 x i32> %p, %q
+  %nc = icmp slt <4 x i32> %q, %p
+  %in = select <4 x i1> %nc, <4 x i32> %x, <4 x i32> %y
+  %r = select <4 x i1> %c, <4 x i32> %a, <4 x i32> %in
+  ret <4 x i32> %r
+}
+
+; olt and oge are both false on NaN: the ordered inverse of olt is uge.
+define <4 x float> @fcmp_ordered_not_complement(<4 x float> %p, <4 x float> %q, <4 x float> %a, <4 x float> %x, <4 x float> %y) {
+; CHECK-LABEL: define <4 x float> @fcmp_ordered_not_complement(
+; CHECK:         %in = select <4 x i1> %nc, <4 x float> %x, <4 x float> %y
+; CHECK-NEXT:    %r = select <4 x i1> %c, <4 x float> %a, <4 x float> %in
+  %c = fcmp olt <4 x float> %p, %q
+  %nc = fcmp oge <4 x float> %p, %q
+  %in = select <4 x i1> %nc, <4 x float> %x, <4 x float> %y
+  %r = select <4 x i1> %c, <4 x float> %a, <4 x float> %in
+  ret <4 x float> %r
+}
+
+; (p ult q) and (q uge p) are both true on NaN.
+define <4 x float> @fcmp_unordered_not_complement(<4 x float> %p, <4 x float> %q, <4 x float> %a, <4 x float> %x, <4 x float> %y) {
+; CHECK-LABEL: define <4 x float> @fcmp_unordered_not_complement(
+; CHECK:         %in = select <4 x i1> %nc, <4 x float> %x, <4 x float> %y
+; CHECK-NEXT:    %r = select <4 x i1> %c, <4 x float> %a, <4 x float> %in
+  %c = fcmp ult <4 x float> %p, %q
+  %nc = fcmp uge <4 x float> %q, %p
+  %in = select <4 x i1> %nc, <4 x float> %x, <4 x float> %y
+  %r = select <4 x i1> %c, <4 x float> %a, <4 x float> %in
+  ret <4 x float> %r
+}
+
+; The inner blend is stored as well: merging the masks would keep it alive
+; and add an or, so the pair stays.
+define <4 x i32> @inner_multi_use_or(<4 x i1> %c1, <4 x i1> %c2, <4 x i32> %a, <4 x i32> %b, ptr %out) {
+; CHECK-LABEL: define <4 x i32> @inner_multi_use_or(
+; CHECK-NEXT:    %in = select <4 x i1> %c2, <4 x i32> %a, <4 x i32> %b
+; CHECK-NEXT:    store <4 x i32> %in, ptr %out
+; CHECK-NEXT:    %r = select <4 x i1> %c1, <4 x i32> %a, <4 x i32> %in
+; CHECK-NEXT:    ret <4 x i32> %r
+  %in = select <4 x i1> %c2, <4 x i32> %a, <4 x i32> %b
+  store <4 x i32> %in, ptr %out
+  %r = select <4 x i1> %c1, <4 x i32> %a, <4 x i32> %in
+  ret <4 x i32> %r
+}
+
+define <4 x i32> @inner_multi_use_and(<4 x i1> %c1, <4 x i1> %c2, <4 x i32> %a, <4 x i32> %b, ptr %out) {
+; CHECK-LABEL: define <4 x i32> @inner_multi_use_and(
+; CHECK-NEXT:    %in = select <4 x i1> %c2, <4 x i32> %a, <4 x i32> %b
+; CHECK-NEXT:    store <4 x i32> %in, ptr %out
+; CHECK-NEXT:    %r = select <4 x i1> %c1, <4 x i32> %in, <4 x i32> %b
+; CHECK-NEXT:    ret <4 x i32> %r
+  %in = select <4 x i1> %c2, <4 x i32> %a, <4 x i32> %b
+  store <4 x i32> %in, ptr %out
+  %r = select <4 x i1> %c1, <4 x i32> %in, <4 x i32> %b
+  ret <4 x i32> %r
+}
+
+; Masks of different shapes (scalar outer, vector inner) do not merge.
+define <4 x i32> @scalar_outer_mask(i1 %c1, <4 x i1> %c2, <4 x i32> %a, <4 x i32> %b) {
+; CHECK-LABEL: define <4 x i32> @scalar_outer_mask(
+; CHECK-NEXT:    %in = select <4 x i1> %c2, <4 x i32> %a, <4 x i32> %b
+; CHECK-NEXT:    %r = select i1 %c1, <4 x i32> %a, <4 x i32> %in
+  %in = select <4 x i1> %c2, <4 x i32> %a, <4 x i32> %b
+  %r = select i1 %c1, <4 x i32> %a, <4 x i32> %in
+  ret <4 x i32> %r
+}
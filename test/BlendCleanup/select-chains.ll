@@ -0,0 +1,129 @@
+; Select chains on the same, complementary or unrelated masks collapse into
+; one select; a negated mask is dropped by swapping the arms.
+;
+; RUN: %opt -passes=vecopt-blend-cleanup,verify -S %s | %FileCheck %s
+
+; select c, a, a -> a
+define <4 x i32> @same_arms(<4 x i1> %c, <4 x i32> %a) {
+; CHECK-LABEL: define <4 x i32> @same_arms(
+; CHECK-NEXT:    ret <4 x i32> %a
+  %r = select <4 x i1> %c, <4 x i32> %a, <4 x i32> %a
+  ret <4 x i32> %r
+}
+
+; select !c, a, b -> select c, b, a
+define <4 x i32> @not_mask(<4 x i1> %c, <4 x i32> %a, <4 x i32> %b) {
+; CHECK-LABEL: define <4 x i32> @not_mask(
+; CHECK-NEXT:    %r = select <4 x i1> %c, <4 x i32> %b, <4 x i32> %a
+; CHECK-NEXT:    ret <4 x i32> %r
+  %nc = xor <4 x i1> %c, <i1 true, i1 true, i1 true, i1 true>
+  %r = select <4 x i1> %nc, <4 x i32> %a, <4 x i32> %b
+  ret <4 x i32> %r
+}
+
+; select c, a, (select c, x, y) -> select c, a, y
+define <4 x i32> @false_arm_same(<4 x i1> %c, <4 x i32> %a, <4 x i32> %x, <4 x i32> %y) {
+; CHECK-LABEL: define <4 x i32> @false_arm_same(
+; CHECK-NEXT:    %r = select <4 x i1> %c, <4 x i32> %a, <4 x i32> %y
+; CHECK-NEXT:    ret <4 x i32> %r
+  %in = select <4 x i1> %c, <4 x i32> %x, <4 x i32> %y
+  %r = select <4 x i1> %c, <4 x i32> %a, <4 x i32> %in
+  ret <4 x i32> %r
+}
+
+; select c, a, (select !c, x, y) -> select c, a, x
+define <4 x i32> @false_arm_complement(<4 x i32> %p, <4 x i32> %q, <4 x i32> %a, <4 x i32> %x, <4 x i32> %y) {
+; CHECK-LABEL: define <4 x i32> @false_arm_complement(
+; CHECK-NEXT:    %c = icmp slt <4 x i32> %p, %q
+; CHECK-NEXT:    %r = select <4 x i1> %c, <4 x i32> %a, <4 x i32> %x
+; CHECK-NEXT:    ret <4 x i32> %r
+  %c = icmp slt <4 x i32> %p, %q
+  %nc = icmp sge <4 x i32> %p, %q
+  %in = select <4 x i1> %nc, <4 x i32> %x, <4 x i32> %y
+  %r = select <4 x i1> %c, <4 x i32> %a, <4 x i32> %in
+  ret <4 x i32> %r
+}
+
+; select c1, a, (select c2, a, b) -> select (c1 | c2), a, b
+define <4 x i32> @false_arm_or(<4 x i1> %c1, <4 x i1> noundef %c2, <4 x i32> %a, <4 x i32> %b) {
+; CHECK-LABEL: define <4 x i32> @false_arm_or(
+; CHECK-NEXT:    [[M:%.*]] = or <4 x i1> %c1, %c2
+; CHECK-NEXT:    %r = select <4 x i1> [[M]], <4 x i32> %a, <4 x i32> %b
+; CHECK-NEXT:    ret <4 x i32> %r
+  %in = select <4 x i1> %c2, <4 x i32> %a, <4 x i32> %b
+  %r = select <4 x i1> %c1, <4 x i32> %a, <4 x i32> %in
+  ret <4 x i32> %r
+}
+
+; select c, (select c, x, y), b -> select c, x, b
+define <4 x i32> @true_arm_same(<4 x i1> %c, <4 x i32> %b, <4 x i32> %x, <4 x i32> %y) {
+; CHECK-LABEL: define <4 x i32> @true_arm_same(
+; CHECK-NEXT:    %r = select <4 x i1> %c, <4 x i32> %x, <4 x i32> %b
+; CHECK-NEXT:    ret <4 x i32> %r
+  %in = select <4 x i1> %c, <4 x i32> %x, <4 x i32> %y
+  %r = select <4 x i1> %c, <4 x i32> %in, <4 x i32> %b
+  ret <4 x i32> %r
+}
+
+; select c, (select !c, x, y), b -> select c, y, b
+define <4 x float> @true_arm_complement(<4 x float> %p, <4 x float> %q, <4 x float> %b, <4 x float> %x, <4 x float> %y) {
+; CHECK-LABEL: define <4 x float> @true_arm_complement(
+; CHECK-NEXT:    %c = fcmp olt <4 x float> %p, %q
+; CHECK-NEXT:    %r = select <4 x i1> %c, <4 x float> %y, <4 x float> %b
+; CHECK-NEXT:    ret <4 x float> %r
+  %c = fcmp olt <4 x float> %p, %q
+  %nc = fcmp uge <4 x float> %p, %q
+  %in = select <4 x i1> %nc, <4 x float> %x, <4 x float> %y
+  %r = select <4 x i1> %c, <4 x float> %in, <4 x float> %b
+  ret <4 x float> %r
+}
+
+; select c1, (select c2, a, b), b -> select (c1 & c2), a, b; c2 may be poison
+; where c1 is false, so it is frozen.
+define <4 x i32> @true_arm_and(<4 x i1> %c1, <4 x i1> %c2, <4 x i32> %a, <4 x i32> %b) {
+; CHECK-LABEL: define <4 x i32> @true_arm_and(
+; CHECK-NEXT:    %c2.frz = freeze <4 x i1> %c2
+; CHECK-NEXT:    [[M:%.*]] = and <4 x i1> %c1, %c2.frz
+; CHECK-NEXT:    %r = select <4 x i1> [[M]], <4 x i32> %a, <4 x i32> %b
+; CHECK-NEXT:    ret <4 x i32> %r
+  %in = select <4 x i1> %c2, <4 x i32> %a, <4 x i32> %b
+  %r = select <4 x i1> %c1, <4 x i32> %in, <4 x i32> %b
+  ret <4 x i32> %r
+}
+
+; Complementary compares with swapped operands: (p < q) and (q <= p).
+define <4 x i32> @complement_swapped(<4 x i32> %p, <4 x i32> %q, <4 x i32> %a, <4 x i32> %x, <4 x i32> %y) {
+; CHECK-LABEL: define <4 x i32> @complement_swapped(
+; CHECK-NEXT:    %c = icmp slt <4 x i32> %p, %q
+; CHECK-NEXT:    %r = select <4 x i1> %c, <4 x i32> %a, <4 x i32> %x
+; CHECK-NEXT:    ret <4 x i32> %r
+  %c = icmp slt <4 x i32> %p, %q
+  %nc = icmp sle <4 x i32> %q, %p
+  %in = select <4 x i1> %nc, <4 x i32> %x, <4 x i32> %y
+  %r = select <4 x i1> %c, <4 x i32> %a, <4 x i32> %in
+  ret <4 x i32> %r
+}
+
+; The same with fcmp: (p ult q) and (q ole p) are complements, NaN included.
+define <4 x float> @complement_swapped_fcmp(<4 x float> %p, <4 x float> %q, <4 x float> %a, <4 x float> %x, <4 x float> %y) {
+; CHECK-LABEL: define <4 x float> @complement_swapped_fcmp(
+; CHECK-NEXT:    %c = fcmp ult <4 x float> %p, %q
+; CHECK-NEXT:    %r = select <4 x i1> %c, <4 x float> %a, <4 x float> %x
+; CHECK-NEXT:    ret <4 x float> %r
+  %c = fcmp ult <4 x float> %p, %q
+  %nc = fcmp ole <4 x float> %q, %p
+  %in = select <4 x i1> %nc, <4 x float> %x, <4 x float> %y
+  %r = select <4 x i1> %c, <4 x float> %a, <4 x float> %in
+  ret <4 x float> %r
+}
+
+; A three-deep if-conversion chain on one mask folds to a single select.
+define <4 x i32> @chain(<4 x i1> %c, <4 x i32> %a, <4 x i32> %b, <4 x i32> %x, <4 x i32> %y) {
+; CHECK-LABEL: define <4 x i32> @chain(
+; CHECK-NEXT:    %r = select <4 x i1> %c, <4 x i32> %a, <4 x i32> %y
+; CHECK-NEXT:    ret <4 x i32> %r
+  %in2 = select <4 x i1> %c, <4 x i32> %x, <4 x i32> %y
+  %in1 = select <4 x i1> %c, <4 x i32> %b, <4 x i32> %in2
+  %r = select <4 x i1> %c, <4 x i32> %a, <4 x i32> %in1
+  ret <4 x i32> %r
+}
@@ -0,0 +1,78 @@
+; A search over a pointer argument SCEV cannot prove dereferenceable is the
+; single unproven stream: chunks are aligned to VF*EltSize and the misaligned
+; head chunk is tested with a masked load whose disabled lanes cannot exit.
+;
+; RUN: %opt -passes=vecopt-early-exit -vecopt-ee-vf=4 -S %s | %FileCheck %s
+
+define i64 @find(ptr %a, i32 %k, i64 %n) {
+; CHECK-LABEL: define i64 @find(
+; CHECK:       loop.preheader:
+; CHECK:         [[ADDR:%.*]] = ptrtoint ptr %a to i64
+; CHECK-NEXT:    [[MIS:%.*]] = and i64 [[ADDR]], 15
+; CHECK-NEXT:    %ee.head = lshr i64 [[MIS]], 2
+; CHECK-NEXT:    %ee.kstart = sub i64 0, %ee.head
+; CHECK:         br i1 {{.*}}, label %[[HEAD:.*]], label %ee.resume
+; CHECK:       [[HEAD]]:
+; CHECK:         %ee.mask = icmp sge <4 x i64> {{.*}}, zeroinitializer
+; CHECK:         %v.chunk = call <4 x i32> @llvm.masked.load.v4i32.p0(ptr %v.chunk.addr, i32 16, <4 x i1> %ee.mask,
+; CHECK-NEXT:    [[CMP:%.*]] = icmp eq <4 x i32> %v.chunk,
+; CHECK-NEXT:    [[LIVE:%.*]] = select <4 x i1> %ee.mask, <4 x i1> [[CMP]], <4 x i1> zeroinitializer
+; CHECK-NEXT:    %ee.lanes = freeze <4 x i1> [[LIVE]]
+; CHECK-NEXT:    [[ANY:%.*]] = call i1 @llvm.vector.reduce.or.v4i1(<4 x i1> %ee.lanes)
+; A hit in the head resumes the scalar loop at iteration 0.
+; CHECK:         [[HEADRESUME:%.*]] = select i1 [[ANY]], i64 0, i64
+; CHECK:         br i1 {{.*}}, label %ee.resume, label %ee.chunk
+; CHECK:       ee.chunk:
+; CHECK:         load <4 x i32>, ptr {{.*}}, align 16
+; CHECK:       ee.resume:
+; CHECK-NEXT:    %ee.resume.iter = phi i64 [ 0, %loop.preheader ], [ [[HEADRESUME]], %[[HEAD]] ], [ {{.*}}, %ee.chunk ]
+entry:
+  %c = icmp sgt i64 %n, 0
+  br i1 %c, label %loop, label %exit
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %p = getelementptr inbounds i32, ptr %a, i64 %i
+  %v = load i32, ptr %p, align 4
+  %hit = icmp eq i32 %v, %k
+  br i1 %hit, label %exit, label %latch
+
+latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %r = phi i64 [ -1, %entry ], [ %i, %loop ], [ -1, %latch ]
+  ret i64 %r
+}
+
+; A proven stream needs no head chunk.
+define i64 @find_tab(i32 %k) {
+; CHECK-LABEL: define i64 @find_tab(
+; CHECK-NOT:     masked.load
+; CHECK:       ee.chunk:
+; CHECK-NEXT:    %ee.k = phi i64 [ 0, %entry ], [ %ee.k.next, %ee.chunk ]
+; CHECK-NOT:     masked.load
+; CHECK:       ee.resume:
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %p = getelementptr inbounds [1024 x i32], ptr @tab, i64 0, i64 %i
+  %v = load i32, ptr %p, align 4
+  %hit = icmp eq i32 %v, %k
+  br i1 %hit, label %exit, label %latch
+
+latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, 1000
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %r = phi i64 [ %i, %loop ], [ -1, %latch ]
+  ret i64 %r
+}
+
+@tab = global [1024 x i32] zeroinitializer, align 64
@@ -0,0 +1,96 @@
+; The unproven stream may end right before an unmapped page. Chunks must be
+; aligned to VF*EltSize (a divisor of the page size) so no chunk load crosses
+; into a page the scalar loop never touches; anything that cannot be aligned
+; that way is left alone.
+;
+; RUN: %opt -passes=vecopt-early-exit -vecopt-ee-vf=16 -S %s | %FileCheck %s
+; RUN: %opt -passes=vecopt-early-exit -vecopt-ee-vf=16 -vecopt-ee-page-safe=false -S %s \
+; RUN:   | %FileCheck %s --check-prefix=NOPAGE
+
+; i8 stream, 16 lanes: chunks start on 16-byte boundaries.
+define i64 @strlen_like(ptr %s, i64 %n) {
+; CHECK-LABEL: define i64 @strlen_like(
+; CHECK:         [[ADDR:%.*]] = ptrtoint ptr %s to i64
+; CHECK-NEXT:    [[MIS:%.*]] = and i64 [[ADDR]], 15
+; CHECK-NEXT:    %ee.head = lshr i64 [[MIS]],
+; CHECK:         call <16 x i8> @llvm.masked.load.v16i8.p0(ptr {{.*}}, i32 16,
+; CHECK:       ee.chunk:
+; CHECK:         load <16 x i8>, ptr {{.*}}, align 16
+; NOPAGE-LABEL: define i64 @strlen_like(
+; NOPAGE-NOT:    ee.chunk
+; NOPAGE:        ret i64
+entry:
+  %c = icmp sgt i64 %n, 0
+  br i1 %c, label %loop, label %exit
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %p = getelementptr inbounds i8, ptr %s, i64 %i
+  %v = load i8, ptr %p, align 1
+  %z = icmp eq i8 %v, 0
+  br i1 %z, label %exit, label %latch
+
+latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %r = phi i64 [ 0, %entry ], [ %i, %loop ], [ %n, %latch ]
+  ret i64 %r
+}
+
+; An under-aligned i32 stream may straddle a page with a single element, so
+; aligning the chunks cannot keep them inside the pages the loop reads.
+define i64 @find_unaligned(ptr %a, i32 %k, i64 %n) {
+; CHECK-LABEL: define i64 @find_unaligned(
+; CHECK-NOT:     ee.chunk
+; CHECK:         ret i64
+entry:
+  %c = icmp sgt i64 %n, 0
+  br i1 %c, label %loop, label %exit
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %p = getelementptr inbounds i32, ptr %a, i64 %i
+  %v = load i32, ptr %p, align 1
+  %hit = icmp eq i32 %v, %k
+  br i1 %hit, label %exit, label %latch
+
+latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %r = phi i64 [ -1, %entry ], [ %i, %loop ], [ -1, %latch ]
+  ret i64 %r
+}
+
+; Two unproven streams cannot both be aligned by one head chunk.
+define i64 @mismatch(ptr %a, ptr %b, i64 %n) {
+; CHECK-LABEL: define i64 @mismatch(
+; CHECK-NOT:     ee.chunk
+; CHECK:         ret i64
+entry:
+  %c = icmp sgt i64 %n, 0
+  br i1 %c, label %loop, label %exit
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %pa = getelementptr inbounds i8, ptr %a, i64 %i
+  %pb = getelementptr inbounds i8, ptr %b, i64 %i
+  %va = load i8, ptr %pa, align 1
+  %vb = load i8, ptr %pb, align 1
+  %ne = icmp ne i8 %va, %vb
+  br i1 %ne, label %exit, label %latch
+
+latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %r = phi i64 [ -1, %entry ], [ %i, %loop ], [ -1, %latch ]
+  ret i64 %r
+}
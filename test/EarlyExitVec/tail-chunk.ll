@@ -0,0 +1,104 @@
+; A chunk is only tested while all VF of its lanes are in range; the last
+; partial chunk (trip count not a multiple of VF) runs in the scalar loop,
+; entered at the first iteration the chunks did not cover.
+;
+; RUN: %opt -passes=vecopt-early-exit -vecopt-ee-vf=4 -S %s | %FileCheck %s
+
+; 1003 iterations (backedge-taken count 1002): chunks stop at k + 4 > 1002.
+define i64 @find_tail(i32 %k) {
+; CHECK-LABEL: define i64 @find_tail(
+; CHECK:       ee.chunk:
+; CHECK-NEXT:    %ee.k = phi i64 [ 0, %entry ], [ %ee.k.next, %ee.chunk ]
+; CHECK:         [[ANY:%.*]] = call i1 @llvm.vector.reduce.or.v4i1(
+; CHECK-NEXT:    %ee.k.next = add i64 %ee.k, 4
+; CHECK-NEXT:    [[NEXT:%.*]] = select i1 [[ANY]], i64 %ee.k, i64 %ee.k.next
+; CHECK-NEXT:    [[END:%.*]] = add i64 %ee.k.next, 4
+; CHECK-NEXT:    [[FITS:%.*]] = icmp sle i64 [[END]], 1002
+; CHECK-NEXT:    [[NOFIT:%.*]] = xor i1 [[FITS]], true
+; CHECK-NEXT:    [[LEAVE:%.*]] = or i1 [[ANY]], [[NOFIT]]
+; CHECK-NEXT:    br i1 [[LEAVE]], label %ee.resume, label %ee.chunk
+; CHECK:       ee.resume:
+; CHECK-NEXT:    %ee.resume.iter = phi i64 [ 0, %entry ], [ [[NEXT]], %ee.chunk ]
+; CHECK:         %i.resume = add i64 0,
+; CHECK:       loop:
+; CHECK-NEXT:    %i = phi i64 [ %i.resume, %ee.resume ], [ %i.next, %latch ]
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %p = getelementptr inbounds [1024 x i32], ptr @tab, i64 0, i64 %i
+  %v = load i32, ptr %p, align 4
+  %hit = icmp eq i32 %v, %k
+  br i1 %hit, label %exit, label %latch
+
+latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, 1003
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %r = phi i64 [ %i, %loop ], [ -1, %latch ]
+  ret i64 %r
+}
+
+; Runtime trip count: the first chunk is guarded by the same test in the
+; preheader, so n < VF + 1 goes straight to the scalar loop.
+define i64 @find_n(i32 %k, i64 %n) {
+; CHECK-LABEL: define i64 @find_n(
+; CHECK:       loop.preheader:
+; CHECK-NEXT:    [[BTC:%.*]] = add {{.*}}i64 %m, -1
+; CHECK:         [[FIRST:%.*]] = icmp sle i64 4, [[BTC]]
+; CHECK-NEXT:    br i1 [[FIRST]], label %ee.chunk, label %ee.resume
+; CHECK:         icmp sle i64 {{.*}}, [[BTC]]
+; CHECK:       ee.resume:
+entry:
+  %c = icmp sgt i64 %n, 0
+  %m = call i64 @llvm.umin.i64(i64 %n, i64 1024)
+  br i1 %c, label %loop, label %exit
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %p = getelementptr inbounds [1024 x i32], ptr @tab, i64 0, i64 %i
+  %v = load i32, ptr %p, align 4
+  %hit = icmp eq i32 %v, %k
+  br i1 %hit, label %exit, label %latch
+
+latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %m
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %r = phi i64 [ -1, %entry ], [ %i, %loop ], [ -1, %latch ]
+  ret i64 %r
+}
+
+; Fewer than 2*VF iterations: not worth a chunk.
+define i64 @find_short(i32 %k) {
+; CHECK-LABEL: define i64 @find_short(
+; CHECK-NOT:     ee.chunk
+; CHECK:         ret i64
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %p = getelementptr inbounds [1024 x i32], ptr @tab, i64 0, i64 %i
+  %v = load i32, ptr %p, align 4
+  %hit = icmp eq i32 %v, %k
+  br i1 %hit, label %exit, label %latch
+
+latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, 7
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %r = phi i64 [ %i, %loop ], [ -1, %latch ]
+  ret i64 %r
+}
+
+@tab = global [1024 x i32] zeroinitializer, align 64
+
+declare i64 @llvm.umin.i64(i64, i64)
@@ -0,0 +1,68 @@
+; A narrow index is sized by its unsigned range, so its private address must
+; zero-extend it too; the merge truncates the bucket back to the index type
+; and lets the table GEP extend it like the original update.
+;
+; RUN: %opt -passes=vecopt-histogram,verify -S %s | %FileCheck %s
+
+; h[(signed char)in[i]]++: 256 buckets, bucket 200 is index -56.
+define void @hist_i8(ptr noalias %h, ptr noalias %in, i64 %n) {
+; CHECK-LABEL: define void @hist_i8(
+; CHECK:         %hist.priv = alloca [1024 x i32], align 64
+; CHECK:       loop:
+; CHECK:         %hist.row = mul i64 %hist.slot, 256
+; CHECK:         [[IDX:%.*]] = zext i8 %b to i64
+; CHECK-NEXT:    [[OFF:%.*]] = add i64 %hist.row, [[IDX]]
+; CHECK-NEXT:    %hist.priv.addr = getelementptr inbounds i32, ptr %hist.priv, i64 [[OFF]]
+; CHECK:       hist.merge.upd:
+; CHECK-NEXT:    [[B:%.*]] = trunc i64 %hist.bucket to i8
+; CHECK-NEXT:    %hist.addr = getelementptr i32, ptr %h, i8 [[B]]
+entry:
+  %c = icmp sgt i64 %n, 0
+  br i1 %c, label %loop, label %exit
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds i8, ptr %in, i64 %i
+  %b = load i8, ptr %p, align 1
+  %q = getelementptr inbounds i32, ptr %h, i8 %b
+  %v = load i32, ptr %q, align 4
+  %v1 = add i32 %v, 1
+  store i32 %v1, ptr %q, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+; Updates of one table through different index types cannot share the
+; merge's bucket -> index mapping.
+define void @hist_mixed(ptr noalias %h, ptr noalias %in, i64 %n) {
+; CHECK-LABEL: define void @hist_mixed(
+; CHECK-NOT:     hist.priv
+; CHECK:         ret void
+entry:
+  %c = icmp sgt i64 %n, 0
+  br i1 %c, label %loop, label %exit
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds i8, ptr %in, i64 %i
+  %b = load i8, ptr %p, align 1
+  %q = getelementptr inbounds i32, ptr %h, i8 %b
+  %v = load i32, ptr %q, align 4
+  %v1 = add i32 %v, 1
+  store i32 %v1, ptr %q, align 4
+  %z = zext i8 %b to i64
+  %r = getelementptr inbounds i32, ptr %h, i64 %z
+  %w = load i32, ptr %r, align 4
+  %w1 = add i32 %w, 2
+  store i32 %w1, ptr %r, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
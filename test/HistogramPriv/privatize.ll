@@ -0,0 +1,107 @@
+; hist[idx[i]]++ updates go to HistCopies private rows picked by the low IV
+; bits, merged back into the table on the exit edge. The verifier runs on
+; the output: every row offset must follow the slot it is computed from.
+;
+; RUN: %opt -passes=vecopt-histogram,verify -S %s | %FileCheck %s
+
+define void @hist(ptr noalias %h, ptr noalias %in, i64 %n) {
+; CHECK-LABEL: define void @hist(
+; CHECK:         %hist.priv = alloca [1024 x i32], align 64
+; CHECK:         call void @llvm.memset.p0.i64(ptr align 64 %hist.priv, i8 0, i64 4096, i1 false)
+; CHECK:       loop:
+; CHECK-NEXT:    %i = phi i64
+; CHECK-NEXT:    %hist.slot = and i64 %i, 3
+; CHECK-NEXT:    %hist.row = mul i64 %hist.slot, 256
+; CHECK:         [[OFF:%.*]] = add i64 %hist.row, %idx
+; CHECK-NEXT:    %hist.priv.addr = getelementptr inbounds i32, ptr %hist.priv, i64 [[OFF]]
+; CHECK-NEXT:    %v = load i32, ptr %hist.priv.addr
+; CHECK-NEXT:    %v1 = add i32 %v, 1
+; CHECK-NEXT:    store i32 %v1, ptr %hist.priv.addr
+; CHECK:       hist.merge:
+; CHECK:         %hist.sum = add i32
+; CHECK:       hist.merge.upd:
+; CHECK-NEXT:    %hist.addr = getelementptr i32, ptr %h, i64 %hist.bucket
+; CHECK:         icmp eq i64 %hist.bucket.next, 256
+entry:
+  %c = icmp sgt i64 %n, 0
+  br i1 %c, label %loop, label %exit
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds i8, ptr %in, i64 %i
+  %b = load i8, ptr %p, align 1
+  %idx = zext i8 %b to i64
+  %q = getelementptr inbounds i32, ptr %h, i64 %idx
+  %v = load i32, ptr %q, align 4
+  %v1 = add nsw i32 %v, 1
+  store i32 %v1, ptr %q, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+; Two tables in one loop: each gets its own private copy and row offset.
+define void @hist2(ptr noalias %h, ptr noalias %g, ptr noalias %in, i32 %n) {
+; CHECK-LABEL: define void @hist2(
+; CHECK-DAG:     %hist.priv = alloca [1024 x i32], align 64
+; CHECK-DAG:     %hist.priv{{[0-9]+}} = alloca [64 x i16], align 64
+; CHECK:       loop:
+; CHECK:         %hist.slot = and i64 {{.*}}, 3
+; CHECK-DAG:     %hist.row = mul i64 %hist.slot, 256
+; CHECK-DAG:     %hist.row{{[0-9]+}} = mul i64 %hist.slot, 16
+entry:
+  %c = icmp sgt i32 %n, 0
+  br i1 %c, label %loop, label %exit
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %i64 = zext i32 %i to i64
+  %p = getelementptr inbounds i8, ptr %in, i64 %i64
+  %b = load i8, ptr %p, align 1
+  %idx = zext i8 %b to i64
+  %q = getelementptr inbounds i32, ptr %h, i64 %idx
+  %v = load i32, ptr %q, align 4
+  %v1 = add i32 %v, 1
+  store i32 %v1, ptr %q, align 4
+  %lo = and i64 %idx, 15
+  %r = getelementptr inbounds i16, ptr %g, i64 %lo
+  %w = load i16, ptr %r, align 2
+  %w1 = add i16 %w, 2
+  store i16 %w1, ptr %r, align 2
+  %i.next = add nuw nsw i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+; Another access that may touch the table keeps the loop as it is.
+define void @hist_alias(ptr %h, ptr noalias %in, i64 %n, ptr %other) {
+; CHECK-LABEL: define void @hist_alias(
+; CHECK-NOT:     hist.priv
+; CHECK:         ret void
+entry:
+  %c = icmp sgt i64 %n, 0
+  br i1 %c, label %loop, label %exit
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds i8, ptr %in, i64 %i
+  %b = load i8, ptr %p, align 1
+  %idx = zext i8 %b to i64
+  %q = getelementptr inbounds i32, ptr %h, i64 %idx
+  %v = load i32, ptr %q, align 4
+  %v1 = add nsw i32 %v, 1
+  store i32 %v1, ptr %q, align 4
+  store i32 0, ptr %other, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
@@ -0,0 +1,136 @@
+; b[f(a[i])] gets llvm.prefetch(&b[f(a[i + D])]), with the look-ahead load of
+; a[] clamped to the last element the loop reads. That bound only holds when
+; a[i] is read before every exit of the iteration.
+;
+; RUN: %opt -passes=vecopt-indirect-prefetch -vecopt-pf-distance=8 -S %s | %FileCheck %s
+
+; The index chain is applied to a[i + 8] in the loop's own order.
+define i64 @gather(ptr noalias %a, ptr noalias %b, i64 %n) {
+; CHECK-LABEL: define i64 @gather(
+; CHECK:       loop.preheader:
+; CHECK:         [[LAST:%.*]] = getelementptr i8, ptr %a, i64
+; CHECK:       loop:
+; CHECK:         %pf.idx.ptr = getelementptr i8, ptr %pa, i64 32
+; CHECK-NEXT:    [[IN:%.*]] = icmp ule ptr %pf.idx.ptr, [[LAST]]
+; CHECK-NEXT:    %pf.idx.clamp = select i1 [[IN]], ptr %pf.idx.ptr, ptr %pa
+; CHECK-NEXT:    %pf.idx = load i32, ptr %pf.idx.clamp
+; CHECK:         %sh.pf = lshr i32 %pf.idx, 2
+; CHECK-NEXT:    %k.pf = add i32 %sh.pf, 1
+; CHECK-NEXT:    %kz.pf = zext i32 %k.pf to i64
+; CHECK-NEXT:    %pb.pf = getelementptr i64, ptr %b, i64 %kz.pf
+; CHECK-NEXT:    call void @llvm.prefetch.p0(ptr %pb.pf, i32 0, i32 3, i32 1)
+entry:
+  %c = icmp sgt i64 %n, 0
+  br i1 %c, label %loop, label %exit
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i64 [ 0, %entry ], [ %s.next, %loop ]
+  %pa = getelementptr inbounds i32, ptr %a, i64 %i
+  %x = load i32, ptr %pa, align 4
+  %sh = lshr i32 %x, 2
+  %k = add i32 %sh, 1
+  %kz = zext i32 %k to i64
+  %pb = getelementptr inbounds i64, ptr %b, i64 %kz
+  %v = load i64, ptr %pb, align 8
+  %s.next = add i64 %s, %v
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %r = phi i64 [ 0, %entry ], [ %s.next, %loop ]
+  ret i64 %r
+}
+
+; `if (i >= m) break;` before a[i]: the loop may stop at i = m < n - 1, and
+; the clamp a[umin(m, n - 1)] would read one element past a[m - 1].
+define i64 @exit_before_index(ptr noalias %a, ptr noalias %b, i64 %n, i64 %m) {
+; CHECK-LABEL: define i64 @exit_before_index(
+; CHECK-NOT:     llvm.prefetch
+; CHECK:         ret i64
+entry:
+  %c = icmp sgt i64 %n, 0
+  br i1 %c, label %loop, label %exit
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %body ]
+  %s = phi i64 [ 0, %entry ], [ %s.next, %body ]
+  %stop = icmp uge i64 %i, %m
+  br i1 %stop, label %exit, label %body
+
+body:
+  %pa = getelementptr inbounds i32, ptr %a, i64 %i
+  %x = load i32, ptr %pa, align 4
+  %kz = zext i32 %x to i64
+  %pb = getelementptr inbounds i64, ptr %b, i64 %kz
+  %v = load i64, ptr %pb, align 8
+  %s.next = add i64 %s, %v
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %r = phi i64 [ 0, %entry ], [ %s, %loop ], [ %s.next, %body ]
+  ret i64 %r
+}
+
+; The same exit after a[i] is fine: every iteration that starts reads it.
+define i64 @exit_after_index(ptr noalias %a, ptr noalias %b, i64 %n, i64 %m) {
+; CHECK-LABEL: define i64 @exit_after_index(
+; CHECK:         %pf.idx = load i32
+; CHECK:         call void @llvm.prefetch.p0(
+entry:
+  %c = icmp sgt i64 %n, 0
+  br i1 %c, label %loop, label %exit
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %body ]
+  %s = phi i64 [ 0, %entry ], [ %s.next, %body ]
+  %pa = getelementptr inbounds i32, ptr %a, i64 %i
+  %x = load i32, ptr %pa, align 4
+  %stop = icmp uge i64 %i, %m
+  br i1 %stop, label %exit, label %body
+
+body:
+  %kz = zext i32 %x to i64
+  %pb = getelementptr inbounds i64, ptr %b, i64 %kz
+  %v = load i64, ptr %pb, align 8
+  %s.next = add i64 %s, %v
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %r = phi i64 [ 0, %entry ], [ %s, %loop ], [ %s.next, %body ]
+  ret i64 %r
+}
+
+; A vectorized body: every lane of the masked gather is prefetched.
+define void @vgather(ptr noalias %a, ptr noalias %b, ptr noalias %out, i64 %n) {
+; CHECK-LABEL: define void @vgather(
+; CHECK:         %pf.idx = load <4 x i32>
+; CHECK-COUNT-4: call void @llvm.prefetch.p0(
+; CHECK:         call <4 x i64> @llvm.masked.gather
+entry:
+  %c = icmp sgt i64 %n, 0
+  br i1 %c, label %loop, label %exit
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %pa = getelementptr inbounds i32, ptr %a, i64 %i
+  %x = load <4 x i32>, ptr %pa, align 4
+  %kz = zext <4 x i32> %x to <4 x i64>
+  %pb = getelementptr inbounds i64, ptr %b, <4 x i64> %kz
+  %v = call <4 x i64> @llvm.masked.gather.v4i64.v4p0(<4 x ptr> %pb, i32 8, <4 x i1> <i1 true, i1 true, i1 true, i1 true>, <4 x i64> poison)
+  %po = getelementptr inbounds i64, ptr %out, i64 %i
+  store <4 x i64> %v, ptr %po, align 8
+  %i.next = add nuw nsw i64 %i, 4
+  %done = icmp uge i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+declare <4 x i64> @llvm.masked.gather.v4i64.v4p0(<4 x ptr>, i32, <4 x i1>, <4 x i64>)
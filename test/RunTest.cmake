@@ -0,0 +1,57 @@
+# Runs the RUN: lines of one test file, lit style (cmake -P, driven by ctest).
+#
+#   -DTEST=<file>  test file; every "RUN:" line is one shell command, a
+#                  trailing '\' continues it on the next line
+#   -DTMP=<path>   scratch path for %t
+#   -DOPT=... -DFILECHECK=... -DVECLANGC=... -DCC=... -DPAR_RT=...
+#                  tool command lines substituted for %opt, %FileCheck,
+#                  %veclangc, %cc and %par_rt
+#
+# %s is the test file and %S its directory. Commands run through `sh -e` in
+# order and the test fails on the first one that exits non-zero.
+
+get_filename_component(TEST_DIR ${TEST} DIRECTORY)
+get_filename_component(TMP_DIR ${TMP} DIRECTORY)
+file(MAKE_DIRECTORY ${TMP_DIR})
+
+# ';' is the IR comment marker and CMake's list separator, and a '\' before
+# it would escape it: hide both before splitting into lines.
+file(READ ${TEST} Text)
+string(REPLACE ";" "@SEMI@" Text "${Text}")
+string(REPLACE "\\\n" "@CONT@\n" Text "${Text}")
+string(REPLACE "\n" ";" Lines "${Text}")
+
+set(Cmds)
+set(Pending "")
+foreach(Line IN LISTS Lines)
+  if(NOT Line MATCHES "RUN:(.*)$")
+    continue()
+  endif()
+  string(STRIP "${CMAKE_MATCH_1}" Part)
+  if(Part MATCHES "^(.*)@CONT@$")
+    string(APPEND Pending "${CMAKE_MATCH_1} ")
+    continue()
+  endif()
+  list(APPEND Cmds "${Pending}${Part}")
+  set(Pending "")
+endforeach()
+if(NOT Cmds)
+  message(FATAL_ERROR "${TEST}: no RUN: lines")
+endif()
+
+foreach(Cmd IN LISTS Cmds)
+  string(REPLACE "%opt" "${OPT}" Cmd "${Cmd}")
+  string(REPLACE "%FileCheck" "${FILECHECK}" Cmd "${Cmd}")
+  string(REPLACE "%veclangc" "${VECLANGC}" Cmd "${Cmd}")
+  string(REPLACE "%cc" "${CC}" Cmd "${Cmd}")
+  string(REPLACE "%par_rt" "${PAR_RT}" Cmd "${Cmd}")
+  string(REPLACE "%s" "${TEST}" Cmd "${Cmd}")
+  string(REPLACE "%S" "${TEST_DIR}" Cmd "${Cmd}")
+  string(REPLACE "%t" "${TMP}" Cmd "${Cmd}")
+  string(REPLACE "@SEMI@" ";" Cmd "${Cmd}")
+  message("RUN: ${Cmd}")
+  execute_process(COMMAND sh -ec "${Cmd}" RESULT_VARIABLE RC)
+  if(NOT RC EQUAL 0)
+    message(FATAL_ERROR "${TEST}: command failed (${RC})")
+  endif()
+endforeach()
@@ -0,0 +1,22 @@
+// Driver for archive.c: links both members from the archive.
+#include <stdio.h>
+
+long sum_i32(const int *a, long n);
+void scale_f32(float *restrict y, const float *restrict x, float k, long n);
+
+int main(void) {
+  enum { N = 1000 };
+  int a[N];
+  float x[N], y[N];
+  long want = 0;
+  for (int i = 0; i < N; i++) {
+    a[i] = i - 300;
+    want += a[i];
+    x[i] = i;
+  }
+  scale_f32(y, x, 0.5f, N);
+  int bad = sum_i32(a, N) != want;
+  for (int i = 0; i < N; i++) bad += y[i] != i * 0.5f;
+  printf("archive: %d mismatches\n", bad);
+  return bad != 0;
+}
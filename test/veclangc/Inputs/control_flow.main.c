@@ -0,0 +1,28 @@
+// Driver for control_flow.c: same kernels built by the host compiler.
+#include <stdio.h>
+
+void clamp_abs(int *restrict out, const int *restrict in, int n);
+int count_big(const int *a, int n);
+long sum_nested(const int *a, int rows, int cols);
+
+#define clamp_abs ref_clamp_abs
+#define count_big ref_count_big
+#define sum_nested ref_sum_nested
+#include "../control_flow.c"
+#undef clamp_abs
+#undef count_big
+#undef sum_nested
+
+int main(void) {
+  enum { N = 1003 };
+  int in[N], o1[N], o2[N];
+  for (int i = 0; i < N; i++) in[i] = (i * 37) % 301 - 150;
+  int bad = 0;
+  clamp_abs(o1, in, N);
+  ref_clamp_abs(o2, in, N);
+  for (int i = 0; i < N; i++) bad += o1[i] != o2[i];
+  bad += count_big(in, N) != ref_count_big(in, N);
+  bad += sum_nested(in, 17, 59) != ref_sum_nested(in, 17, 59);
+  printf("control_flow: %d mismatches\n", bad);
+  return bad != 0;
+}
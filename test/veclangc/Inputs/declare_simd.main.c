@@ -0,0 +1,23 @@
+// Driver for declare_simd.c: mad3 comes from the --simd-header prototypes
+// (-include), so the simd loop calls its vector variants.
+#include <stdio.h>
+
+static float ref_mad3(float a, float b) {
+  float r = a * 3.0f + b;
+  return r < 0.0f ? -r : r;
+}
+
+int main(void) {
+  enum { N = 1003 };
+  static float a[N], b[N], r[N];
+  for (int i = 0; i < N; i++) {
+    a[i] = i * 0.25f - 100.0f;
+    b[i] = 50.0f - i * 0.125f;
+  }
+#pragma omp simd
+  for (int i = 0; i < N; i++) r[i] = mad3(a[i], b[i]);
+  int bad = 0;
+  for (int i = 0; i < N; i++) bad += r[i] != ref_mad3(a[i], b[i]);
+  printf("declare_simd: %d mismatches\n", bad);
+  return bad != 0;
+}
@@ -0,0 +1,55 @@
+// Driver for early_exit.c: every search ends right before a PROT_NONE page,
+// at every start alignment and for lengths around the chunk width.
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+long find_i32(const int *a, int k, long n);
+long find_u8(const unsigned char *s, long n);
+
+#define find_i32 ref_find_i32
+#define find_u8 ref_find_u8
+#include "../early_exit.c"
+#undef find_i32
+#undef find_u8
+
+int main(void) {
+  long pg = sysconf(_SC_PAGESIZE);
+  unsigned char *m = mmap(0, 2 * pg, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (m == MAP_FAILED || mprotect(m + pg, pg, PROT_NONE)) return 2;
+  unsigned char *end = m + pg;
+  int bad = 0;
+
+  for (long n = 0; n <= 40; ++n) {
+    int *a = (int *)end - n;
+    for (long i = 0; i < n; ++i) a[i] = (int)(i * 3 + 1);
+    for (long hit = -1; hit < n; ++hit) {
+      int k = hit < 0 ? -7 : a[hit];
+      // also drop the first elements so the stream starts misaligned
+      for (long skip = 0; skip < 8 && skip <= n; ++skip) {
+        long got = find_i32(a + skip, k, n - skip);
+        long want = ref_find_i32(a + skip, k, n - skip);
+        if (got != want) {
+          if (bad++ < 5) printf("find_i32 n=%ld skip=%ld k=%d: %ld != %ld\n",
+                                n - skip, skip, k, got, want);
+        }
+      }
+    }
+  }
+
+  for (long n = 0; n <= 70; ++n) {
+    unsigned char *s = end - n;
+    memset(s, 'x', n);
+    for (long z = -1; z < n; ++z) {
+      if (z >= 0) s[z] = 0;
+      long got = find_u8(s, n), want = ref_find_u8(s, n);
+      if (got != want && bad++ < 5)
+        printf("find_u8 n=%ld z=%ld: %ld != %ld\n", n, z, got, want);
+      if (z >= 0) s[z] = 'x';
+    }
+  }
+  printf("early_exit: %d mismatches\n", bad);
+  return bad != 0;
+}
@@ -0,0 +1,38 @@
+// Driver for histogram.c: tables start non-zero, so the merge must add to
+// the existing counts.
+#include <stdio.h>
+
+void hist_u8(int *restrict h, const unsigned char *restrict in, long n);
+void hist_weighted(float *restrict h, const unsigned char *restrict in,
+                   const float *restrict w, long n);
+
+#define hist_u8 ref_hist_u8
+#define hist_weighted ref_hist_weighted
+#include "../histogram.c"
+#undef hist_u8
+#undef hist_weighted
+
+int main(void) {
+  enum { N = 10007 };
+  static unsigned char in[N];
+  static float w[N];
+  for (int i = 0; i < N; i++) {
+    in[i] = (unsigned char)(i * 131 + (i >> 3));
+    w[i] = (i % 5) * 0.5f;
+  }
+  int bad = 0;
+  for (long n = 0; n <= N; n += n < 20 ? 1 : 1999) {
+    int h1[256], h2[256];
+    float f1[64], f2[64];
+    for (int b = 0; b < 256; b++) h1[b] = h2[b] = b;
+    for (int b = 0; b < 64; b++) f1[b] = f2[b] = b * 0.25f;
+    hist_u8(h1, in, n);
+    ref_hist_u8(h2, in, n);
+    hist_weighted(f1, in, w, n);
+    ref_hist_weighted(f2, in, w, n);
+    for (int b = 0; b < 256; b++) bad += h1[b] != h2[b];
+    for (int b = 0; b < 64; b++) bad += f1[b] != f2[b];
+  }
+  printf("histogram: %d mismatches\n", bad);
+  return bad != 0;
+}
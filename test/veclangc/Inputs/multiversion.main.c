@@ -0,0 +1,30 @@
+// Driver for multiversion.c: whichever clone the resolver picks must match
+// the host compiler's build.
+#include <stdio.h>
+
+void saxpy(float *restrict y, const float *restrict x, float a, long n);
+int count_eq(const int *a, int k, long n);
+
+#define saxpy ref_saxpy
+#define count_eq ref_count_eq
+#include "../multiversion.c"
+#undef saxpy
+#undef count_eq
+
+int main(void) {
+  enum { N = 1029 };
+  static float x[N], y1[N], y2[N];
+  static int a[N];
+  for (int i = 0; i < N; i++) {
+    x[i] = i * 0.125f;
+    y1[i] = y2[i] = 1.0f - i * 0.5f;
+    a[i] = i % 7;
+  }
+  saxpy(y1, x, 2.0f, N);
+  ref_saxpy(y2, x, 2.0f, N);
+  int bad = 0;
+  for (int i = 0; i < N; i++) bad += y1[i] != y2[i];
+  bad += count_eq(a, 3, N) != ref_count_eq(a, 3, N);
+  printf("multiversion: %d mismatches\n", bad);
+  return bad != 0;
+}
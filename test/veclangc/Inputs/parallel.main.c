@@ -0,0 +1,35 @@
+// Driver for parallel.c: serial reference built by the host compiler.
+#include <stdio.h>
+
+void pscale(float *restrict y, const float *restrict x, float k, long n);
+long psum(const int *a, long n);
+int pmax_xor(const int *a, long n, int *x);
+
+#define pscale ref_pscale
+#define psum ref_psum
+#define pmax_xor ref_pmax_xor
+#include "../parallel.c"
+#undef pscale
+#undef psum
+#undef pmax_xor
+
+int main(void) {
+  enum { N = 100003 };
+  static int a[N];
+  static float x[N], y1[N], y2[N];
+  for (int i = 0; i < N; i++) {
+    a[i] = (i * 7919) % 10007 - 5000;
+    x[i] = i * 0.5f;
+  }
+  int bad = 0;
+  for (long n = 0; n <= N; n += n < 100 ? 1 : 9973) {
+    pscale(y1, x, 3.0f, n);
+    ref_pscale(y2, x, 3.0f, n);
+    for (long i = 0; i < n; i++) bad += y1[i] != y2[i];
+    bad += psum(a, n) != ref_psum(a, n);
+    int h1, h2;
+    bad += pmax_xor(a, n, &h1) != ref_pmax_xor(a, n, &h2) || h1 != h2;
+  }
+  printf("parallel: %d mismatches\n", bad);
+  return bad != 0;
+}
@@ -0,0 +1,4 @@
+#ifndef PP_GUARD_H
+#define PP_GUARD_H
+static int thrice(int v) { return v * 3; }
+#endif
@@ -0,0 +1,3 @@
+#pragma once
+// Included twice by preprocessor.c: a second copy would redefine twice().
+static int twice(int v) { return v + v; }
@@ -0,0 +1,24 @@
+// Driver for preprocessor.c: same source through the host preprocessor.
+#include <stdio.h>
+
+int pp_value(void);
+int pp_calls(int v);
+int char_sum(void);
+
+#define pp_value ref_pp_value
+#define pp_calls ref_pp_calls
+#define char_sum ref_char_sum
+#include "../preprocessor.c"
+#undef pp_value
+#undef pp_calls
+#undef char_sum
+
+int main(void) {
+  int bad = 0;
+  bad += pp_value() != ref_pp_value();
+  bad += pp_calls(7) != ref_pp_calls(7);
+  bad += char_sum() != ref_char_sum();
+  printf("preprocessor: %d %d %d, %d mismatches\n", pp_value(), pp_calls(7),
+         char_sum(), bad);
+  return bad != 0;
+}
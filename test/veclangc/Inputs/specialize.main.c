@@ -0,0 +1,39 @@
+// Driver for specialize.c: every specialized and generic size against the
+// host compiler's build.
+#include <stdio.h>
+
+void blur_rows(int *restrict out, const int *restrict in, int w, int h);
+float dot(const float *a, const float *b, int n);
+int blur_fixed(int *restrict out, const int *restrict in);
+
+#define blur_rows ref_blur_rows
+#define dot ref_dot
+#define blur_fixed ref_blur_fixed
+#include "../specialize.c"
+#undef blur_rows
+#undef dot
+#undef blur_fixed
+
+int main(void) {
+  enum { N = 16 * 5 };
+  int in[N], o1[N], o2[N];
+  float a[N], b[N];
+  for (int i = 0; i < N; i++) {
+    in[i] = i * i % 97;
+    a[i] = i * 0.25f;
+    b[i] = 3 - i * 0.5f;
+  }
+  int bad = 0;
+  int ws[] = {8, 16, 5}, hs[] = {4, 5};
+  for (int wi = 0; wi < 3; wi++)
+    for (int hi = 0; hi < 2; hi++) {
+      for (int i = 0; i < N; i++) o1[i] = o2[i] = -1;
+      blur_rows(o1, in, ws[wi], hs[hi]);
+      ref_blur_rows(o2, in, ws[wi], hs[hi]);
+      for (int i = 0; i < N; i++) bad += o1[i] != o2[i];
+    }
+  for (int n = 0; n <= 20; n++) bad += dot(a, b, n) != ref_dot(a, b, n);
+  bad += blur_fixed(o1, in) != ref_blur_fixed(o2, in);
+  printf("specialize: %d mismatches\n", bad);
+  return bad != 0;
+}
@@ -0,0 +1,28 @@
+// Driver for types.c: same kernel built by the host compiler as reference.
+#include <stdint.h>
+#include <stdio.h>
+
+unsigned mix(const uint8_t *p, const int16_t *q, float *f, double *d, long n);
+
+#define mix ref_mix
+#include "../types.c"
+#undef mix
+
+int main(void) {
+  enum { N = 1000 };
+  uint8_t a[N];
+  int16_t q[N];
+  float f1[N], f2[N];
+  double d1[N], d2[N];
+  for (int i = 0; i < N; i++) {
+    a[i] = i * 7 + 3;
+    q[i] = (i * 997) ^ 0x5a5a;
+    f1[i] = f2[i] = i * 0.25f;
+    d1[i] = d2[i] = i * 1.5;
+  }
+  unsigned h1 = mix(a, q, f1, d1, N), h2 = ref_mix(a, q, f2, d2, N);
+  int bad = h1 != h2;
+  for (int i = 0; i < N; i++) bad += f1[i] != f2[i] || d1[i] != d2[i];
+  printf("types: %u %u, %d mismatches\n", h1, h2, bad);
+  return bad != 0;
+}
@@ -0,0 +1,13 @@
+// Multi-file driver: inputs compiled on a thread pool into one archive.
+//
+// RUN: %veclangc -j 2 %s %S/Inputs/archive_b.c -o %t.a
+// RUN: nm %t.a | grep -q 'T sum_i32'
+// RUN: nm %t.a | grep -q 'T scale_f32'
+// RUN: %cc -O1 %S/Inputs/archive.main.c %t.a -o %t
+// RUN: %t
+
+long sum_i32(const int *a, long n) {
+  long s = 0;
+  for (long i = 0; i < n; ++i) s += a[i];
+  return s;
+}
@@ -0,0 +1,43 @@
+// if/else chains, the ternary operator, calls between functions of one file
+// and loop pragmas.
+//
+// RUN: %veclangc --input %s -c -o %t.o
+// RUN: %cc -O1 %S/Inputs/control_flow.main.c %t.o -o %t
+// RUN: %t
+
+static int clamp(int v, int lo, int hi) {
+  if (v < lo) return lo;
+  else if (v > hi) return hi;
+  return v;
+}
+
+void clamp_abs(int *restrict out, const int *restrict in, int n) {
+#pragma vectorize width(4) interleave(2)
+  for (int i = 0; i < n; ++i) {
+    int v = in[i];
+    if (v < 0) v = -v;
+    else v = v + 1;
+    out[i] = clamp(v, 3, 100);
+  }
+}
+
+int count_big(const int *a, int n) {
+  int c = 0;
+#pragma unroll(4)
+  for (int i = 0; i < n; ++i)
+    c += a[i] > 50 ? 1 : (a[i] < -50 ? 2 : 0);
+  return c;
+}
+
+long sum_nested(const int *a, int rows, int cols) {
+  long s = 0;
+#pragma nounroll
+  for (int r = 0; r < rows; ++r) {
+    int i = 0;
+    while (i < cols) {
+      s += clamp(a[r * cols + i], -10, 10);
+      i = i + 1;
+    }
+  }
+  return s;
+}
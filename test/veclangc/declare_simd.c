@@ -0,0 +1,15 @@
+// Vector-ABI variants of an element function, called from a host compiler
+// #pragma omp simd loop through the prototypes in --simd-header.
+//
+// RUN: %veclangc --input %s -c -o %t.o --simd-header=%t.h
+// RUN: grep -q '#pragma omp declare simd' %t.h
+// RUN: nm %t.o | grep -q '_ZGVbN4vv_mad3'
+// RUN: %cc -O2 -fopenmp-simd -include %t.h %S/Inputs/declare_simd.main.c %t.o -o %t
+// RUN: %t
+
+#pragma omp declare simd notinbranch
+float mad3(float a, float b) {
+  float r = a * 3.0f + b;
+  if (r < 0.0f) r = -r;
+  return r;
+}
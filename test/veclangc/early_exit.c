@@ -0,0 +1,20 @@
+// Early-exit search chunks near an unmapped page: the head chunk, the last
+// partial chunk and a stream that ends exactly at the page boundary.
+//
+// RUN: %veclangc --vecopt -vecopt-ee-vf=8 --input %s -c -o %t.o
+// RUN: %cc -O1 %S/Inputs/early_exit.main.c %t.o -o %t
+// RUN: %t
+
+#include <stddef.h>
+
+long find_i32(const int *a, int k, long n) {
+  for (long i = 0; i < n; ++i)
+    if (a[i] == k) return i;
+  return -1;
+}
+
+long find_u8(const unsigned char *s, long n) {
+  for (long i = 0; i < n; ++i)
+    if (s[i] == 0) return i;
+  return n;
+}
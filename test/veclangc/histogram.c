@@ -0,0 +1,15 @@
+// Histogram privatization in veclangc's O3 pipeline (--vecopt), including
+// byte indices >= 128 and counts that land in every private copy.
+//
+// RUN: %veclangc --vecopt --input %s -c -o %t.o
+// RUN: %cc -O1 %S/Inputs/histogram.main.c %t.o -o %t
+// RUN: %t
+
+void hist_u8(int *restrict h, const unsigned char *restrict in, long n) {
+  for (long i = 0; i < n; ++i) h[in[i]] += 1;
+}
+
+void hist_weighted(float *restrict h, const unsigned char *restrict in,
+                   const float *restrict w, long n) {
+  for (long i = 0; i < n; ++i) h[in[i] & 63] += w[i];
+}
@@ -0,0 +1,18 @@
+// --jit runs int main(void) in-process; --jit --bench times a kernel on
+// synthetic inputs.
+//
+// RUN: %veclangc --input %s --jit
+// RUN: %veclangc --input %s --jit --bench --bench-kernel=add_one --bench-n=4096 --bench-reps=2 \
+// RUN:   | grep -q 'ns/elem'
+
+void add_one(int *a, long n) {
+  for (long i = 0; i < n; ++i) a[i] = a[i] + 1;
+}
+
+static long tri(long n) {
+  long s = 0;
+  for (long i = 1; i <= n; ++i) s += i % 3 == 0 ? i : 0;
+  return s;
+}
+
+int main(void) { return tri(300) == 15150 ? 0 : 1; }
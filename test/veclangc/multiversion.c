@@ -0,0 +1,20 @@
+// One object for every x86-64 host: per-ISA clones behind an ifunc, each
+// with its own copy of the static helper.
+//
+// RUN: %veclangc -march=x86-64 --multiversion=sse4.2,avx2,avx512 -fPIC --input %s -c -o %t.o
+// RUN: nm %t.o | grep -q 'saxpy\.avx2'
+// RUN: nm %t.o | grep -q ' i saxpy$'
+// RUN: %cc -O1 %S/Inputs/multiversion.main.c %t.o -o %t
+// RUN: %t
+
+static float twice(float v) { return v + v; }
+
+void saxpy(float *restrict y, const float *restrict x, float a, long n) {
+  for (long i = 0; i < n; ++i) y[i] = a * x[i] + twice(y[i]);
+}
+
+int count_eq(const int *a, int k, long n) {
+  int c = 0;
+  for (long i = 0; i < n; ++i) c += a[i] == k;
+  return c;
+}
@@ -0,0 +1,31 @@
+// #pragma parallel loops on the runtime's thread pool, with static and
+// dynamic schedules and reductions.
+//
+// RUN: %veclangc -fPIC --input %s -c -o %t.o
+// RUN: %cc -O1 %S/Inputs/parallel.main.c %t.o %par_rt -o %t
+// RUN: VECLANGC_NUM_THREADS=4 %t
+// RUN: VECLANGC_NUM_THREADS=1 %t
+
+void pscale(float *restrict y, const float *restrict x, float k, long n) {
+#pragma parallel
+  for (long i = 0; i < n; ++i) y[i] = x[i] * k + 1.0f;
+}
+
+long psum(const int *a, long n) {
+  long s = 0;
+#pragma parallel schedule(dynamic, 64) reduce(+: s)
+  for (long i = 0; i < n; ++i) s += a[i];
+  return s;
+}
+
+int pmax_xor(const int *a, long n, int *x) {
+  int m = -2147483647;
+  int h = 0;
+#pragma omp parallel for schedule(static) reduction(max: m) reduction(^: h)
+  for (long i = 1; i < n; i += 3) {
+    m = a[i] > m ? a[i] : m;
+    h ^= a[i] * 31;
+  }
+  x[0] = h;
+  return m;
+}
@@ -0,0 +1,52 @@
+// Conditional compilation, #pragma once / include guards, function-like
+// macros and character literals.
+//
+// RUN: %veclangc --input %s -c -o %t.o
+// RUN: %cc -O1 %S/Inputs/preprocessor.main.c %t.o -o %t
+// RUN: %t
+
+#include "Inputs/pp_once.h"
+#include "Inputs/pp_once.h"
+#include "Inputs/pp_guard.h"
+#include "Inputs/pp_guard.h"
+
+#define W 8
+#define SQ(x) ((x) * (x))
+
+#if defined(W) && W > 4 && !defined(NOPE)
+#define SCALE 3
+#elif W > 2
+#define SCALE 5
+#else
+#define SCALE 7
+#endif
+
+// -1 converts to unsigned in a comparison with 0u
+#if -1 > 0u
+#define UCMP 1
+#else
+#define UCMP 0
+#endif
+
+// the right operands are never evaluated
+#if 0 && (1 / 0)
+#define SC 0
+#elif 1 || (1 % 0)
+#define SC 1
+#endif
+
+#if (1 << 4) == 16 && (-16 >> 2) == -4 && 0x10 == 020
+#define SHIFTS 1
+#else
+#define SHIFTS 0
+#endif
+
+int pp_value(void) {
+  return SCALE * 1000 + UCMP * 100 + SC * 10 + SHIFTS + SQ(W) * 10000;
+}
+
+int pp_calls(int v) { return twice(v) + thrice(v); }
+
+int char_sum(void) {
+  return 'a' + '\n' + '\\' + '\'' + '"' + '\0' + '\t';
+}
@@ -0,0 +1,21 @@
+// Compile server: a miss and a cache hit both write --simd-header, and the
+// served object works like a local one.
+//
+// RUN: rm -rf %t.cache %t.sock %t.h
+// RUN: %veclangc --serve --socket=%t.sock --cache-dir=%t.cache > %t.log 2>&1 & pid=$! && \
+// RUN: trap "kill $pid" EXIT && \
+// RUN: for i in $(seq 100); do test -S %t.sock && break; sleep 0.1; done && \
+// RUN: %veclangc --server --socket=%t.sock -c --input %s -o %t.o --simd-header=%t.h && \
+// RUN: test -n "$(ls %t.cache)" && grep -q 'declare simd' %t.h && rm %t.h %t.o && \
+// RUN: kill -0 $pid && \
+// RUN: %veclangc --server --socket=%t.sock -c --input %s -o %t.o --simd-header=%t.h && \
+// RUN: grep -q 'declare simd' %t.h
+// RUN: %cc -O2 -fopenmp-simd -include %t.h %S/Inputs/declare_simd.main.c %t.o -o %t
+// RUN: %t
+
+#pragma omp declare simd notinbranch
+float mad3(float a, float b) {
+  float r = a * 3.0f + b;
+  if (r < 0.0f) r = -r;
+  return r;
+}
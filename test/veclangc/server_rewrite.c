@@ -0,0 +1,28 @@
+// Compile server: the client's $VECOPT_REWRITE reaches the server as
+// -vecopt-rewrite, so each setting gets its own cache entry, and served
+// objects match local builds.
+//
+// RUN: rm -rf %t.cache %t.sock && mkdir -p %t.cache
+// RUN: VECOPT_REWRITE=0 %veclangc --input %s -c -o %t.local0.o
+// RUN: VECOPT_REWRITE=1 %veclangc --input %s -c -o %t.local1.o
+// RUN: VECOPT_REWRITE=0 %veclangc --serve --socket=%t.sock --cache-dir=%t.cache > %t.log 2>&1 & pid=$! && \
+// RUN: trap "kill $pid" EXIT && \
+// RUN: for i in $(seq 100); do test -S %t.sock && break; sleep 0.1; done && \
+// RUN: VECOPT_REWRITE=1 %veclangc --server --socket=%t.sock -c --input %s -o %t.srv1.o && \
+// RUN: test $(ls %t.cache | wc -l) -eq 1 && \
+// RUN: VECOPT_REWRITE=0 %veclangc --server --socket=%t.sock -c --input %s -o %t.srv0.o && \
+// RUN: test $(ls %t.cache | wc -l) -eq 2 && \
+// RUN: VECOPT_REWRITE=1 %veclangc --server --socket=%t.sock -c --input %s -o %t.hit1.o && \
+// RUN: test $(ls %t.cache | wc -l) -eq 2
+// RUN: cmp %t.srv0.o %t.local0.o
+// RUN: cmp %t.srv1.o %t.local1.o
+// RUN: cmp %t.hit1.o %t.local1.o
+
+void clamp_all(int *restrict out, const int *restrict in, int lo, int hi, long n) {
+  for (long i = 0; i < n; ++i) {
+    int v = in[i];
+    if (v < lo) v = lo;
+    else if (v > hi) v = hi;
+    out[i] = v;
+  }
+}
@@ -0,0 +1,26 @@
+// Constant-argument clones: #pragma specialize and --specialize, dispatched
+// on the runtime value with the generic body for any other value.
+//
+// RUN: %veclangc --specialize=dot.n=8 --input %s -c -o %t.o
+// RUN: %cc -O1 %S/Inputs/specialize.main.c %t.o -o %t
+// RUN: %t
+
+#pragma specialize(w: 8, 16)
+#pragma specialize(h: 4)
+void blur_rows(int *restrict out, const int *restrict in, int w, int h) {
+  for (int r = 0; r < h; ++r)
+    for (int c = 1; c + 1 < w; ++c)
+      out[r * w + c] = (in[r * w + c - 1] + in[r * w + c] + in[r * w + c + 1]) / 3;
+}
+
+float dot(const float *a, const float *b, int n) {
+  float s = 0.0f;
+  for (int i = 0; i < n; ++i) s += a[i] * b[i];
+  return s;
+}
+
+// constant arguments call the clones directly
+int blur_fixed(int *restrict out, const int *restrict in) {
+  blur_rows(out, in, 16, 4);
+  return out[17];
+}
@@ -0,0 +1,30 @@
+// Narrow, unsigned and floating-point types, integer promotions and the C
+// conversions between them, checked against the host C compiler.
+//
+// RUN: %veclangc --input %s -c -o %t.o
+// RUN: %cc -O1 %S/Inputs/types.main.c %t.o -o %t
+// RUN: %t
+
+#include <stdint.h>
+unsigned mix(const uint8_t *p, const int16_t *q, float *f, double *d, long n) {
+  unsigned h = 2166136261u;
+  for (long i = 0; i < n; ++i) {
+    h ^= p[i];
+    h *= 16777619u;
+    h += (unsigned)(q[i] >> 2) + (h >> 7);
+    int s = q[i] / 3 + q[i] % 5;
+    unsigned u = (unsigned)s / 7u;
+    f[i] = f[i] * 0.5f + (float)s;
+    d[i] = d[i] / 3.0 - (double)u + 1e-3;
+    if (f[i] > 10.0f && !(s < 0) || p[i] == 'a') h += 1;
+    char c = (char)p[i];
+    h += c < 0 ? 100 : 0;
+    uint8_t b = p[i];
+    b += 200;
+    h -= b;
+    h += ~(unsigned)s << 3;
+    h += (unsigned long)-1 > 0;
+    h += -5 / 2 + -5 % 2 + (-5 >> 1);
+  }
+  return h;
+}
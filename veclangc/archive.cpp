@@ -0,0 +1,85 @@
+#include "archive.h"
+
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Object/ArchiveWriter.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <algorithm>
+#include <chrono>
+
+using namespace llvm;
+
+namespace {
+
+struct FileResult {
+    SmallVector<char, 0> obj;
+    std::string err;
+    bool ok = false;
+    double ms = 0;
+};
+
+double msSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+} // namespace
+
+int buildArchive(const std::vector<std::string> &inputs, const std::string &outPath,
+                 unsigned jobs, const ObjectCompiler &compile) {
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<FileResult> results(inputs.size());
+    {
+        // inputs are independent; each task writes only its own slot
+        ThreadPool Pool(hardware_concurrency(jobs));
+        for (size_t i = 0; i < inputs.size(); ++i)
+            Pool.async([&, i] {
+                auto ts = std::chrono::steady_clock::now();
+                FileResult &R = results[i];
+                R.ok = compile(inputs[i], R.obj, R.err);
+                R.ms = msSince(ts);
+            });
+        Pool.wait();
+    }
+    double wall = msSince(t0);
+
+    int rc = 0;
+    double sum = 0;
+    size_t width = 0;
+    for (auto &in : inputs) width = std::max(width, in.size());
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        const FileResult &R = results[i];
+        sum += R.ms;
+        errs() << "  " << left_justify(inputs[i], width) << format("  %8.1f ms", R.ms);
+        if (!R.ok) { errs() << "  FAILED: " << R.err; rc = 1; }
+        errs() << "\n";
+    }
+    unsigned threads = hardware_concurrency(jobs).compute_thread_count();
+    errs() << format("  %zu files, %u threads: %.1f ms wall (per-file times sum to %.1f ms)\n",
+                     inputs.size(), std::min<unsigned>(threads, inputs.size()), wall, sum);
+    if (rc) return rc;
+
+    // member names are the inputs' basenames with .o
+    std::vector<std::string> names;
+    std::vector<NewArchiveMember> members;
+    for (size_t i = 0; i < inputs.size(); ++i)
+        names.push_back(sys::path::stem(inputs[i]).str() + ".o");
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        StringRef Bytes(results[i].obj.data(), results[i].obj.size());
+        members.emplace_back(MemoryBufferRef(Bytes, names[i]));
+    }
+#if LLVM_VERSION_MAJOR >= 18
+    auto Symtab = SymtabWritingMode::NormalSymtab;
+#else
+    bool Symtab = true;
+#endif
+    if (Error E = writeArchive(outPath, members, Symtab, object::Archive::K_GNU,
+                               /*Deterministic=*/true, /*Thin=*/false)) {
+        errs() << "writing " << outPath << ": " << toString(std::move(E)) << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/SmallVector.h>
+
+// Multi-file driver (`veclangc -j N a.c b.c ... -o libk.a`): compile every
+// input on a thread pool and pack the objects into a static archive with a
+// symbol index.
+
+// Compile one input into object code. Runs concurrently on pool threads, so
+// it must use its own LLVMContext / TargetMachine. Returns false and sets
+// err on failure.
+using ObjectCompiler =
+    std::function<bool(const std::string &path, llvm::SmallVectorImpl<char> &obj, std::string &err)>;
+
+// jobs == 0: one thread per hardware thread. Prints per-file and total wall
+// time; nothing is written unless every input compiled. Returns an exit code.
+int buildArchive(const std::vector<std::string> &inputs, const std::string &outPath,
+                 unsigned jobs, const ObjectCompiler &compile);
@@ -1,106 +1,365 @@
 #pragma once
-#include <string>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
+// --- Types ---
+// C scalar types (LP64) plus pointers to them. Bool is internal: the i1 of
+// comparisons and logical operators, promoted to int when used as a value.
+enum class TypeKind { Void, Bool, Char, Short, Int, Long, Float, Double };
+
+struct CType {
+    TypeKind kind = TypeKind::Int;
+    bool isUnsigned = false;
+    unsigned ptr = 0;      // pointer depth: int** -> kind Int, ptr 2
+
+    CType() = default;
+    CType(TypeKind k, bool u = false, unsigned p = 0) : kind(k), isUnsigned(u), ptr(p) {}
+
+    bool isPointer() const { return ptr > 0; }
+    bool isVoid() const { return !ptr && kind == TypeKind::Void; }
+    bool isFloating() const { return !ptr && (kind == TypeKind::Float || kind == TypeKind::Double); }
+    bool isInteger() const { return !ptr && !isFloating() && kind != TypeKind::Void; }
+    bool isSigned() const { return isInteger() && !isUnsigned && kind != TypeKind::Bool; }
+    unsigned bits() const {
+        if (ptr) return 64;
+        switch (kind) {
+            case TypeKind::Bool:  return 1;
+            case TypeKind::Char:  return 8;
+            case TypeKind::Short: return 16;
+            case TypeKind::Int: case TypeKind::Float: return 32;
+            case TypeKind::Long: case TypeKind::Double: return 64;
+            default: return 0;
+        }
+    }
+    // v converts to this integer type without changing value
+    bool holds(int64_t v) const {
+        unsigned b = bits();
+        if (isSigned()) return b >= 64 || (v >= -(int64_t(1) << (b - 1)) && v < (int64_t(1) << (b - 1)));
+        return v >= 0 && (b >= 64 || v < (int64_t(1) << b));
+    }
+    CType pointee() const { CType t = *this; --t.ptr; return t; }
+    CType pointerTo() const { CType t = *this; ++t.ptr; return t; }
+    bool operator==(const CType &o) const {
+        return kind == o.kind && isUnsigned == o.isUnsigned && ptr == o.ptr;
+    }
+    bool operator!=(const CType &o) const { return !(*this == o); }
+};
+
+// --- Arena ---
+// Every AST node of a translation unit lives in its ASTArena and goes away
+// with it in one piece. Nodes are trivially destructible for that: names are
+// interned into the arena and child lists are arena arrays.
+template <class T>
+struct NodeList {
+    T *const *ptr = nullptr;
+    uint32_t n = 0;
+    T *const *begin() const { return ptr; }
+    T *const *end() const { return ptr + n; }
+    size_t size() const { return n; }
+    bool empty() const { return n == 0; }
+    T *operator[](size_t i) const { return ptr[i]; }
+};
+
+class ASTArena {
+public:
+    ASTArena() = default;
+    ASTArena(ASTArena &&) = default;
+    ASTArena &operator=(ASTArena &&) = default;
+
+    template <class T, class... Args>
+    T *make(Args &&...args) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena nodes are never destroyed");
+        ++nodes_;
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template <class T>
+    NodeList<T> list(const std::vector<T*> &v) {
+        NodeList<T> L;
+        if (v.empty()) return L;
+        T **p = static_cast<T**>(allocate(v.size() * sizeof(T*), alignof(T*)));
+        std::memcpy(p, v.data(), v.size() * sizeof(T*));
+        L.ptr = p;
+        L.n = (uint32_t)v.size();
+        return L;
+    }
+
+    // One arena copy per distinct name.
+    std::string_view intern(std::string_view s) {
+        auto it = names_.find(s);
+        if (it != names_.end()) return *it;
+        char *p = static_cast<char*>(allocate(s.size() ? s.size() : 1, 1));
+        if (!s.empty()) std::memcpy(p, s.data(), s.size());
+        return *names_.insert(std::string_view(p, s.size())).first;
+    }
+
+    size_t nodes() const { return nodes_; }
+    size_t slabs() const { return slabs_.size(); }
+    size_t bytesUsed() const { return used_; }
+
+private:
+    static constexpr size_t SlabSize = 64 * 1024;
+    std::vector<std::unique_ptr<char[]>> slabs_;
+    char *cur_ = nullptr, *end_ = nullptr;
+    size_t used_ = 0, nodes_ = 0;
+    std::unordered_set<std::string_view> names_;
+
+    void *allocate(size_t size, size_t align) {
+        uintptr_t p = ((uintptr_t)cur_ + align - 1) & ~(uintptr_t)(align - 1);
+        if (!cur_ || p + size > (uintptr_t)end_) {
+            // oversized requests get a slab of their own
+            size_t n = std::max(SlabSize, size + align);
+            slabs_.emplace_back(new char[n]);
+            cur_ = slabs_.back().get();
+            end_ = cur_ + n;
+            p = ((uintptr_t)cur_ + align - 1) & ~(uintptr_t)(align - 1);
+        }
+        cur_ = reinterpret_cast<char*>(p + size);
+        used_ += size;
+        return reinterpret_cast<void*>(p);
+    }
+};
+
+// Checked downcast by kind tag: nullptr unless n is a T.
+template <class T, class Base>
+T *nodeAs(Base *n) { return n && n->kind == T::Kind ? static_cast<T*>(n) : nullptr; }
+
 // --- Expressions ---
-struct Expr { virtual ~Expr() = default; };
+enum class ExprKind : uint8_t { Number, Float, Var, Index, Bin, Call, Unary, Cast, Cond, Assign };
+
+struct Expr {
+    const ExprKind kind;
+protected:
+    explicit Expr(ExprKind k) : kind(k) {}
+};
 
 struct NumberExpr : Expr {
+    static constexpr ExprKind Kind = ExprKind::Number;
     int64_t v;
-    explicit NumberExpr(int64_t v) : v(v) {}
+    CType type; // int, or long/unsigned per suffix and magnitude
+    explicit NumberExpr(int64_t v, CType t = CType()) : Expr(Kind), v(v), type(t) {}
+};
+
+struct FloatExpr : Expr {
+    static constexpr ExprKind Kind = ExprKind::Float;
+    double v;
+    CType type; // double, or float with an 'f' suffix
+    FloatExpr(double v, CType t) : Expr(Kind), v(v), type(t) {}
 };
 
 struct VarExpr : Expr {
-    std::string name;
-    explicit VarExpr(std::string n) : name(std::move(n)) {}
+    static constexpr ExprKind Kind = ExprKind::Var;
+    std::string_view name;
+    explicit VarExpr(std::string_view n) : Expr(Kind), name(n) {}
 };
 
 struct IndexExpr : Expr {
-    std::string base;
-    std::unique_ptr<Expr> idx;
-    IndexExpr(std::string b, std::unique_ptr<Expr> i)
-        : base(std::move(b)), idx(std::move(i)) {}
+    static constexpr ExprKind Kind = ExprKind::Index;
+    std::string_view base;
+    Expr *idx;
+    IndexExpr(std::string_view b, Expr *i) : Expr(Kind), base(b), idx(i) {}
 };
 
-enum class BinOp { Add, Sub, Mul, Div, Mod, LT, LE, GT, GE, EQ, NE, And, Or, Xor, Shl, Shr };
+enum class BinOp { Add, Sub, Mul, Div, Mod, LT, LE, GT, GE, EQ, NE, And, Or, Xor, Shl, Shr, LAnd, LOr };
 
 struct BinExpr : Expr {
+    static constexpr ExprKind Kind = ExprKind::Bin;
     BinOp op;
-    std::unique_ptr<Expr> a, b;
-    BinExpr(BinOp op, std::unique_ptr<Expr> a, std::unique_ptr<Expr> b)
-        : op(op), a(std::move(a)), b(std::move(b)) {}
+    Expr *a, *b;
+    BinExpr(BinOp op, Expr *a, Expr *b) : Expr(Kind), op(op), a(a), b(b) {}
 };
 
 struct CallExpr : Expr {
-    std::string callee;
-    std::vector<std::unique_ptr<Expr>> args;
-    CallExpr(std::string c, std::vector<std::unique_ptr<Expr>> a)
-        : callee(std::move(c)), args(std::move(a)) {}
+    static constexpr ExprKind Kind = ExprKind::Call;
+    std::string_view callee;
+    NodeList<Expr> args;
+    CallExpr(std::string_view c, NodeList<Expr> a) : Expr(Kind), callee(c), args(a) {}
+};
+
+enum class UnOp { Neg, Not, BitNot, PreInc, PreDec, PostInc, PostDec };
+
+struct UnaryExpr : Expr {
+    static constexpr ExprKind Kind = ExprKind::Unary;
+    UnOp op;
+    Expr *e;
+    UnaryExpr(UnOp op, Expr *e) : Expr(Kind), op(op), e(e) {}
+};
+
+// (type)e
+struct CastExpr : Expr {
+    static constexpr ExprKind Kind = ExprKind::Cast;
+    CType to;
+    Expr *e;
+    CastExpr(CType t, Expr *e) : Expr(Kind), to(t), e(e) {}
+};
+
+// cond ? a : b
+struct CondExpr : Expr {
+    static constexpr ExprKind Kind = ExprKind::Cond;
+    Expr *cond, *a, *b;
+    CondExpr(Expr *c, Expr *a, Expr *b) : Expr(Kind), cond(c), a(a), b(b) {}
 };
 
 struct AssignExpr : Expr {
-    std::unique_ptr<Expr> lhs;
-    std::unique_ptr<Expr> rhs;
-    AssignExpr(std::unique_ptr<Expr> l, std::unique_ptr<Expr> r)
-        : lhs(std::move(l)), rhs(std::move(r)) {}
+    static constexpr ExprKind Kind = ExprKind::Assign;
+    Expr *lhs;
+    Expr *rhs;
+    bool compound = false; // lhs op= rhs
+    BinOp op = BinOp::Add;
+    AssignExpr(Expr *l, Expr *r) : Expr(Kind), lhs(l), rhs(r) {}
+    AssignExpr(Expr *l, BinOp op, Expr *r) : Expr(Kind), lhs(l), rhs(r), compound(true), op(op) {}
 };
 
 // --- Statements ---
-struct Stmt { virtual ~Stmt() = default; };
+enum class StmtKind : uint8_t { Decl, Expr, If, For, Return, Block, While };
+
+struct Stmt {
+    const StmtKind kind;
+protected:
+    explicit Stmt(StmtKind k) : kind(k) {}
+};
+
+using StmtList = NodeList<Stmt>;
 
 struct DeclStmt : Stmt {
-    std::string name;
-    std::unique_ptr<Expr> init; // Can be nullptr
-    DeclStmt(std::string n, std::unique_ptr<Expr> e)
-        : name(std::move(n)), init(std::move(e)) {}
+    static constexpr StmtKind Kind = StmtKind::Decl;
+    CType type;
+    std::string_view name;
+    Expr *init; // Can be nullptr
+    DeclStmt(CType t, std::string_view n, Expr *e) : Stmt(Kind), type(t), name(n), init(e) {}
 };
 
 struct ExprStmt : Stmt {
-    std::unique_ptr<Expr> expr;
-    explicit ExprStmt(std::unique_ptr<Expr> e) : expr(std::move(e)) {}
+    static constexpr StmtKind Kind = StmtKind::Expr;
+    Expr *expr;
+    explicit ExprStmt(Expr *e) : Stmt(Kind), expr(e) {}
 };
 
 struct IfStmt : Stmt {
-    std::unique_ptr<Expr> cond;
-    std::vector<std::unique_ptr<Stmt>> thenStmts;
-    IfStmt(std::unique_ptr<Expr> c, std::vector<std::unique_ptr<Stmt>> t)
-        : cond(std::move(c)), thenStmts(std::move(t)) {}
+    static constexpr StmtKind Kind = StmtKind::If;
+    Expr *cond;
+    StmtList thenStmts;
+    StmtList elseStmts; // empty if no else; else-if is a nested IfStmt
+    IfStmt(Expr *c, StmtList t, StmtList e = {})
+        : Stmt(Kind), cond(c), thenStmts(t), elseStmts(e) {}
+};
+
+// #pragma vectorize / unroll / nounroll hints for the loop that follows;
+// 0 = unspecified.
+struct LoopHints {
+    unsigned width = 0;       // vectorize width(N)
+    unsigned interleave = 0;  // vectorize interleave(M)
+    bool predicate = false;   // vectorize predicate (tail folding)
+    unsigned unroll = 0;      // unroll(N)
+    bool fullUnroll = false;  // unroll
+    bool noUnroll = false;    // nounroll
+    bool empty() const {
+        return !width && !interleave && !predicate && !unroll && !fullUnroll && !noUnroll;
+    }
+};
+
+// reduce(op:var) of a #pragma parallel loop: each worker accumulates
+// its own copy from the identity, the copies are combined at the end.
+struct Reduction {
+    enum class Op : uint8_t { Add, Mul, Min, Max, And, Or, Xor };
+    Op op;
+    std::string_view var;
+    Reduction(Op o, std::string_view v) : op(o), var(v) {}
+};
+
+// #pragma parallel [schedule(static|dynamic[, chunk])] [reduce(op:var, ...)]
+// on a for loop: its iterations run in chunks on the veclangc_par_rt pool.
+struct ParallelLoop {
+    bool dynamic = false; // static: fixed share per worker; dynamic: chunks taken on demand, idle workers steal
+    int64_t chunk = 0;    // iterations per chunk, 0 = runtime default
+    NodeList<Reduction> reductions;
 };
 
 struct ForStmt : Stmt {
-    std::unique_ptr<Stmt> init;
-    std::unique_ptr<Expr> cond;
-    std::unique_ptr<Expr> inc;
-    std::vector<std::unique_ptr<Stmt>> body;
-    ForStmt(std::unique_ptr<Stmt> i,
-            std::unique_ptr<Expr> c,
-            std::unique_ptr<Expr> n,
-            std::vector<std::unique_ptr<Stmt>> b)
-        : init(std::move(i)), cond(std::move(c)),
-          inc(std::move(n)), body(std::move(b)) {}
+    static constexpr StmtKind Kind = StmtKind::For;
+    Stmt *init;
+    Expr *cond;
+    Expr *inc;
+    StmtList body;
+    LoopHints hints;
+    const ParallelLoop *parallel = nullptr; // #pragma parallel
+    ForStmt(Stmt *i, Expr *c, Expr *n, StmtList b)
+        : Stmt(Kind), init(i), cond(c), inc(n), body(b) {}
 };
 
 struct ReturnStmt : Stmt {
-    std::unique_ptr<Expr> val;
-    explicit ReturnStmt(std::unique_ptr<Expr> v) : val(std::move(v)) {}
+    static constexpr StmtKind Kind = StmtKind::Return;
+    Expr *val; // nullptr for `return;`
+    explicit ReturnStmt(Expr *v) : Stmt(Kind), val(v) {}
 };
 
 struct BlockStmt : Stmt {
-    std::vector<std::unique_ptr<Stmt>> stmts;
-    explicit BlockStmt(std::vector<std::unique_ptr<Stmt>> s) : stmts(std::move(s)) {}
+    static constexpr StmtKind Kind = StmtKind::Block;
+    StmtList stmts;
+    explicit BlockStmt(StmtList s) : Stmt(Kind), stmts(s) {}
 };
 
 struct WhileStmt : Stmt {
-    std::unique_ptr<Expr> cond;
-    std::vector<std::unique_ptr<Stmt>> body;
-    WhileStmt(std::unique_ptr<Expr> c, std::vector<std::unique_ptr<Stmt>> b)
-        : cond(std::move(c)), body(std::move(b)) {}
+    static constexpr StmtKind Kind = StmtKind::While;
+    Expr *cond;
+    StmtList body;
+    LoopHints hints;
+    WhileStmt(Expr *c, StmtList b) : Stmt(Kind), cond(c), body(b) {}
 };
 
 // --- Top Level ---
+// Qualifiers/attributes of a pointer parameter that don't change its type
+// but tell the optimizer about the memory behind it.
+struct ParamQuals {
+    bool isRestrict = false;   // T *restrict p
+    bool constPointee = false; // const T *p
+    unsigned align = 0;        // __attribute__((aligned(N))), 0 = none
+};
+
+// One #pragma [omp] declare simd before a function: the vector variants to
+// build, in the x86 vector function ABI (one per ISA, or two with masking).
+struct SimdDecl {
+    enum class Param : uint8_t { Vector, Uniform, Linear };
+    std::vector<Param> params;         // parallel to FuncAST::params
+    std::vector<int64_t> linearStep;   // per param; Linear only (in elements for pointers)
+    unsigned simdlen = 0;              // 0: register width / characteristic type
+    bool masked = true, unmasked = true; // inbranch / notinbranch narrow to one
+    std::string clauses;               // the pragma text after "simd", for headers
+};
+
+// #pragma specialize(n: 16, 64) before a function, or --specialize n=16:
+// clones with the parameter fixed to each value, picked by the function's
+// entry, which falls back to the generic body for any other value.
+struct Specialization {
+    size_t param;                // index into FuncAST::params; an integer parameter
+    std::vector<int64_t> values;
+};
+
 struct FuncAST {
     std::string name;
-    std::vector<std::pair<std::string, std::string>> params; 
-    std::vector<std::unique_ptr<Stmt>> body;
+    CType ret;
+    std::vector<std::pair<CType, std::string>> params; // (type, name); name may be empty in a prototype
+    std::vector<ParamQuals> paramQuals;                // parallel to params
+    StmtList body;                                     // in TranslationUnit::arena
+    bool isDefinition = false; // false: prototype only
+    bool isStatic = false;     // internal linkage
+    bool isInline = false;     // inline hint (GNU semantics: the definition is still emitted)
+    std::vector<SimdDecl> simd; // #pragma declare simd variants
+    std::vector<Specialization> specialize; // one per parameter; clones are the cross product
+};
+
+// A whole .c file: prototypes and definitions in source order.
+struct TranslationUnit {
+    std::vector<FuncAST> funcs;
+    ASTArena arena; // owns every node and name the funcs point to
 };
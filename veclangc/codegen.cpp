@@ -1,33 +1,239 @@
 #include "codegen.h"
+#include "VecOpt/VecOpt.h"
+#include <llvm/Analysis/ModuleSummaryAnalysis.h>
+#include <llvm/Analysis/ProfileSummaryInfo.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/InstIterator.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/Passes/PassBuilder.h>
 #include <llvm/Support/FileSystem.h>
 #include <llvm/TargetParser/Host.h>
+#include <llvm/TargetParser/Triple.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetOptions.h>
+#include <llvm/MC/MCSubtargetInfo.h>
 #include <llvm/MC/TargetRegistry.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+
+#include <algorithm>
+#include <set>
+#include <stdexcept>
 
 using namespace llvm;
 
-std::unique_ptr<TargetMachine> createTargetMachineFromTriple(const std::string &tripleStr) {
+std::unique_ptr<TargetMachine> createTargetMachineFromTriple(const std::string &tripleStr,
+                                                            const std::string &cpuName,
+                                                            const std::string &extraFeatures,
+                                                            bool PIC) {
   std::string Error;
   const Target *T = TargetRegistry::lookupTarget(tripleStr, Error);
   if (!T) {
     errs() << "lookupTarget failed: " << Error << "\n";
     return nullptr;
   }
-  std::string CPU = sys::getHostCPUName().str();
-  std::string Features; // keep empty or query Host for defaults
+  std::string CPU = cpuName;
+  std::string Features;
+  if (CPU == "native") {
+    CPU = sys::getHostCPUName().str();
+    // the CPU name alone misses features the host has beyond (or lacks
+    // against) its model, e.g. AVX-512 subsets or disabled AVX
+    StringMap<bool> HostFeatures;
+    if (sys::getHostCPUFeatures(HostFeatures))
+      for (auto &F : HostFeatures)
+        Features += (Features.empty() ? "" : ",") + std::string(F.second ? "+" : "-") + F.first().str();
+  }
+  if (!extraFeatures.empty())
+    Features += (Features.empty() ? "" : ",") + extraFeatures;
+  std::unique_ptr<MCSubtargetInfo> STI(T->createMCSubtargetInfo(tripleStr, "", ""));
+  if (!STI || !STI->isCPUStringValid(CPU)) {
+    errs() << "unknown target CPU '" << CPU << "' for " << tripleStr << "\n";
+    return nullptr;
+  }
   TargetOptions opt;
-  auto RM = std::optional<Reloc::Model>();
+  auto RM = PIC ? std::optional<Reloc::Model>(Reloc::PIC_) : std::optional<Reloc::Model>();
   std::unique_ptr<TargetMachine> TM(
       T->createTargetMachine(tripleStr, CPU, Features, opt, RM));
   return TM;
 }
 
+void setTargetAttributes(Module &M, const TargetMachine &TM) {
+  StringRef CPU = TM.getTargetCPU(), Features = TM.getTargetFeatureString();
+  for (Function &F : M) {
+    if (F.isDeclaration()) continue;
+    if (F.hasFnAttribute("target-cpu")) continue; // multiversion clones and resolvers
+    F.addFnAttr("target-cpu", CPU);
+    // a function's own features (a SIMD variant's ISA) come last and win
+    std::string FS = Features.str();
+    if (F.hasFnAttribute("target-features")) {
+      StringRef Own = F.getFnAttribute("target-features").getValueAsString();
+      if (!Own.empty()) FS += (FS.empty() ? "" : ",") + Own.str();
+    }
+    if (!FS.empty()) F.addFnAttr("target-features", FS);
+  }
+}
+
+namespace {
+// One --multiversion ISA. Bits index __cpu_model.__cpu_features[0] as
+// filled in by __cpu_indicator_init (libgcc and compiler-rt agree on them;
+// AVX and AVX-512 bits are only set when the OS saves those registers).
+struct MultiVersionISA {
+  const char *name;
+  const char *features;
+  uint32_t cpuBits;
+};
+enum : uint32_t {
+  CPU_POPCNT = 1u << 2, CPU_SSE4_2 = 1u << 8, CPU_AVX = 1u << 9, CPU_AVX2 = 1u << 10,
+  CPU_FMA = 1u << 14, CPU_AVX512F = 1u << 15, CPU_BMI = 1u << 16, CPU_BMI2 = 1u << 17,
+  CPU_AVX512VL = 1u << 20, CPU_AVX512BW = 1u << 21, CPU_AVX512DQ = 1u << 22, CPU_AVX512CD = 1u << 23,
+};
+// worst to best: the resolver tries them from the back
+const MultiVersionISA MultiVersionISAs[] = {
+  {"sse4.2", "+sse4.2,+popcnt", CPU_SSE4_2 | CPU_POPCNT},
+  {"avx2", "+avx2,+fma,+bmi,+bmi2,+popcnt", CPU_AVX | CPU_AVX2 | CPU_FMA | CPU_BMI | CPU_BMI2 | CPU_POPCNT},
+  {"avx512", "+avx512f,+avx512vl,+avx512bw,+avx512dq,+avx512cd,+avx2,+fma,+bmi,+bmi2,+popcnt",
+   CPU_AVX | CPU_AVX2 | CPU_FMA | CPU_BMI | CPU_BMI2 | CPU_POPCNT |
+   CPU_AVX512F | CPU_AVX512VL | CPU_AVX512BW | CPU_AVX512DQ | CPU_AVX512CD},
+};
+
+// i32 __cpu_model.__cpu_features[0], after __cpu_indicator_init (which
+// only does the work once). Shared by every resolver of the module.
+Function *cpuFeaturesFunction(Module &M) {
+  if (Function *F = M.getFunction("veclangc.cpu_features")) return F;
+  LLVMContext &C = M.getContext();
+  Type *I32 = Type::getInt32Ty(C);
+  StructType *ModelTy = StructType::get(C, {I32, I32, I32, ArrayType::get(I32, 1)});
+  auto *Model = cast<GlobalVariable>(M.getOrInsertGlobal("__cpu_model", ModelTy));
+  Model->setDSOLocal(true);
+  FunctionCallee Init = M.getOrInsertFunction("__cpu_indicator_init", Type::getVoidTy(C));
+  cast<Function>(Init.getCallee())->setDSOLocal(true);
+
+  Function *F = Function::Create(FunctionType::get(I32, false), Function::InternalLinkage,
+                                 "veclangc.cpu_features", &M);
+  F->addFnAttr(Attribute::NoUnwind);
+  F->addFnAttr("target-cpu", "x86-64");
+  IRBuilder<> B(BasicBlock::Create(C, "entry", F));
+  B.CreateCall(Init);
+  Value *P = B.CreateInBoundsGEP(ModelTy, Model, {B.getInt32(0), B.getInt32(3), B.getInt32(0)});
+  B.CreateRet(B.CreateLoad(I32, P, "features"));
+  return F;
+}
+} // namespace
+
+void multiversionFunctions(Module &M, const std::vector<std::string> &ISAs) {
+  Triple T(M.getTargetTriple());
+  if (T.getArch() != Triple::x86_64 || !T.isOSBinFormatELF())
+    throw std::runtime_error("--multiversion needs an x86-64 ELF target (ifunc)");
+  std::vector<const MultiVersionISA *> Chosen;
+  for (const std::string &Name : ISAs) {
+    auto It = std::find_if(std::begin(MultiVersionISAs), std::end(MultiVersionISAs),
+                           [&](const MultiVersionISA &I) { return Name == I.name; });
+    if (It == std::end(MultiVersionISAs))
+      throw std::runtime_error("--multiversion: unknown ISA '" + Name + "' (sse4.2, avx2, avx512)");
+    if (std::find(Chosen.begin(), Chosen.end(), &*It) == Chosen.end()) Chosen.push_back(&*It);
+  }
+  std::sort(Chosen.begin(), Chosen.end());
+  if (Chosen.empty()) return;
+
+  // the exported kernels; declare simd variants already have their ISA
+  std::vector<Function *> Kernels;
+  for (Function &F : M)
+    if (!F.isDeclaration() && F.hasExternalLinkage() && F.getName() != "main" &&
+        !F.hasFnAttribute("target-features"))
+      Kernels.push_back(&F);
+  if (Kernels.empty()) return;
+
+  // and the local functions they reach: static helpers, and #pragma
+  // parallel bodies and combine functions, which are only passed by address
+  // and so never inlined. Each ISA gets its own copies, after the kernels.
+  std::vector<Function *> Cloned(Kernels);
+  std::set<Function *> Seen(Kernels.begin(), Kernels.end());
+  for (size_t w = 0; w < Cloned.size(); ++w)
+    for (Instruction &I : instructions(*Cloned[w]))
+      for (Value *Op : I.operands()) {
+        SmallVector<Value *, 4> Vals{Op};
+        while (!Vals.empty()) {
+          Value *V = Vals.pop_back_val();
+          if (auto *CE = dyn_cast<ConstantExpr>(V)) {
+            Vals.append(CE->op_begin(), CE->op_end());
+            continue;
+          }
+          auto *G = dyn_cast<Function>(V);
+          if (G && G->hasLocalLinkage() && !G->isDeclaration() && !G->hasFnAttribute("target-features") &&
+              Seen.insert(G).second)
+            Cloned.push_back(G);
+        }
+      }
+
+  // one clone set per ISA; references among the cloned functions stay
+  // inside the set, so calls can still be inlined
+  std::vector<std::vector<Function *>> Clones;
+  for (const MultiVersionISA *I : Chosen) {
+    std::vector<Function *> &Cl = Clones.emplace_back();
+    for (Function *F : Cloned)
+      Cl.push_back(Function::Create(F->getFunctionType(), Function::InternalLinkage,
+                                    F->getName() + "." + I->name, &M));
+    for (size_t k = 0; k < Cloned.size(); ++k) {
+      Function *F = Cloned[k], *C = Cl[k];
+      ValueToValueMapTy VMap;
+      for (size_t j = 0; j < Cloned.size(); ++j) VMap[Cloned[j]] = Cl[j];
+      auto CA = C->arg_begin();
+      for (Argument &A : F->args()) {
+        CA->setName(A.getName());
+        VMap[&A] = &*CA++;
+      }
+      SmallVector<ReturnInst *, 4> Returns;
+      CloneFunctionInto(C, F, VMap, CloneFunctionChangeType::LocalChangesOnly, Returns);
+      C->setLinkage(Function::InternalLinkage);
+      C->setVisibility(GlobalValue::DefaultVisibility);
+      C->addFnAttr("target-cpu", "x86-64");
+      C->addFnAttr("target-features", I->features);
+    }
+  }
+
+  // f becomes f.default, and f an ifunc whose resolver picks, at load
+  // time, the best clone the CPU supports
+  std::set<Function *> Defaults(Kernels.begin(), Kernels.end());
+  Function *Features = cpuFeaturesFunction(M);
+  for (size_t k = 0; k < Kernels.size(); ++k) {
+    Function *F = Kernels[k];
+    std::string Name = F->getName().str();
+    GlobalValue::LinkageTypes Linkage = F->getLinkage();
+    F->setName(Name + ".default");
+    F->setLinkage(Function::InternalLinkage);
+    F->setVisibility(GlobalValue::DefaultVisibility);
+
+    // hidden rather than internal: the call graph starts at non-local
+    // functions, and the clones are only reachable from here
+    Function *R = Function::Create(FunctionType::get(F->getType(), false), Function::ExternalLinkage,
+                                   Name + ".resolver", &M);
+    R->setVisibility(GlobalValue::HiddenVisibility);
+    R->addFnAttr(Attribute::NoUnwind);
+    R->addFnAttr("target-cpu", "x86-64"); // runs before anything is known about the CPU
+    IRBuilder<> B(BasicBlock::Create(M.getContext(), "entry", R));
+    Value *Bits = B.CreateCall(Features);
+    Value *Pick = F;
+    for (size_t i = 0; i < Chosen.size(); ++i) {
+      Value *Mask = B.getInt32(Chosen[i]->cpuBits);
+      Value *Has = B.CreateICmpEQ(B.CreateAnd(Bits, Mask), Mask, std::string("has.") + Chosen[i]->name);
+      Pick = B.CreateSelect(Has, Clones[i][k], Pick);
+    }
+    B.CreateRet(Pick);
+
+    GlobalIFunc *IF = GlobalIFunc::create(F->getFunctionType(), F->getAddressSpace(), Linkage, Name, R, &M);
+    // direct calls among the defaults stay direct; everything else
+    // (callers in this module, address-taken uses) goes through the ifunc
+    F->replaceUsesWithIf(IF, [&](Use &U) {
+      auto *I = dyn_cast<Instruction>(U.getUser());
+      if (I && I->getFunction() == R) return false;
+      auto *CB = dyn_cast<CallBase>(U.getUser());
+      return !(CB && CB->isCallee(&U) && Defaults.count(CB->getFunction()));
+    });
+  }
+}
+
 // Debug-only: build a fixed IR for int sad(const int*, const int*, int)
 void buildSADKernelIR(Module &M) {
   LLVMContext &C = M.getContext();
@@ -89,8 +295,9 @@ void buildSADKernelIR(Module &M) {
   }
 }
 
-void runO3Pipeline(Module &M) {
-  PassBuilder PB;
+void runO3Pipeline(Module &M, TargetMachine *TM, bool withVecOpt, LTOKind LTO) {
+  PassBuilder PB(TM);
+  if (withVecOpt) vecopt::registerPassBuilderCallbacks(PB);
   LoopAnalysisManager LAM;
   FunctionAnalysisManager FAM;
   CGSCCAnalysisManager CGAM;
@@ -102,10 +309,46 @@ void runO3Pipeline(Module &M) {
   PB.registerLoopAnalyses(LAM);
   PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
 
-  ModulePassManager MPM = PB.buildPerModuleDefaultPipeline(OptimizationLevel::O3);
+  ModulePassManager MPM;
+  switch (LTO) {
+  case LTOKind::None: MPM = PB.buildPerModuleDefaultPipeline(OptimizationLevel::O3); break;
+  case LTOKind::Thin: MPM = PB.buildThinLTOPreLinkDefaultPipeline(OptimizationLevel::O3); break;
+  case LTOKind::Full: MPM = PB.buildLTOPreLinkDefaultPipeline(OptimizationLevel::O3); break;
+  }
   MPM.run(M, MAM);
 }
 
+bool emitObjectToBuffer(Module &M, TargetMachine &TM, SmallVectorImpl<char> &Out) {
+  M.setDataLayout(TM.createDataLayout());
+  raw_svector_ostream OS(Out);
+  legacy::PassManager PM;
+  if (TM.addPassesToEmitFile(PM, OS, nullptr, llvm::CodeGenFileType::ObjectFile)) {
+    errs() << "TargetMachine can't emit a file of this type\n";
+    return false;
+  }
+  PM.run(M);
+  return true;
+}
+
+void emitBitcodeToBuffer(Module &M, LTOKind LTO, SmallVectorImpl<char> &Out) {
+  raw_svector_ostream OS(Out);
+  if (LTO == LTOKind::None) {
+    WriteBitcodeToFile(M, OS);
+    return;
+  }
+  if (LTO == LTOKind::Full) {
+    // without the flag a module with a summary is taken for ThinLTO
+    M.addModuleFlag(Module::Error, "ThinLTO", uint32_t(0));
+  }
+  if (!M.getModuleFlag("EnableSplitLTOUnit"))
+    M.addModuleFlag(Module::Error, "EnableSplitLTOUnit", uint32_t(0));
+  ProfileSummaryInfo PSI(M);
+  ModuleSummaryIndex Index = buildModuleSummaryIndex(M, nullptr, &PSI);
+  // the module hash keys the linker's ThinLTO cache
+  WriteBitcodeToFile(M, OS, /*ShouldPreserveUseListOrder=*/false, &Index,
+                     /*GenerateHash=*/LTO == LTOKind::Thin);
+}
+
 void emitObjectFile(Module &M, TargetMachine &TM, const std::string &outPath) {
   M.setDataLayout(TM.createDataLayout());
 
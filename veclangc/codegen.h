@@ -1,22 +1,71 @@
 #pragma once
 #include <memory>
 #include <string>
+#include <vector>
+#include <llvm/ADT/SmallVector.h>
 #include <llvm/Target/TargetMachine.h>
 
 namespace llvm { class Module; }
 
-// Create a TargetMachine from a target triple string.
-std::unique_ptr<llvm::TargetMachine> createTargetMachineFromTriple(const std::string &triple);
+// Create a TargetMachine from a target triple string. CPU "native" means the
+// host CPU plus every feature the host reports; Features (-mattr syntax,
+// "+avx2,-fma") is applied on top. PIC selects position-independent code
+// (needed for ifuncs in PIE executables); the default is static.
+std::unique_ptr<llvm::TargetMachine> createTargetMachineFromTriple(const std::string &triple,
+                                                                   const std::string &CPU = "native",
+                                                                   const std::string &Features = "",
+                                                                   bool PIC = false);
+
+// Stamp the TargetMachine's target-cpu / target-features on every function
+// definition, as clang does, so per-function TTI sees the real target.
+// Features a function already has (SIMD variants: their ISA) are kept on
+// top; functions with their own target-cpu (multiversion clones) are left
+// alone. Call once per module.
+void setTargetAttributes(llvm::Module &M, const llvm::TargetMachine &TM);
+
+// --multiversion: clone every exported function for each ISA ("sse4.2",
+// "avx2", "avx512"), keep the original as name.default and turn the name
+// into an ifunc that picks the best clone the CPU supports at load time
+// (via __cpu_indicator_init / __cpu_model from libgcc or compiler-rt).
+// Call before setTargetAttributes: the clones keep their own target.
+// Throws std::runtime_error for unknown ISAs and non x86-64 ELF targets.
+void multiversionFunctions(llvm::Module &M, const std::vector<std::string> &ISAs);
 
 // (Debug only) Build a hard-coded IR for: int sad(const int*, const int*, int)
 void buildSADKernelIR(llvm::Module &M);
 
-// Run the standard O3 pipeline using PassBuilder.
-void runO3Pipeline(llvm::Module &M);
+// Link-time optimization mode of -flto: the module is written as bitcode
+// and optimized again, together with its callers, by `clang -flto`.
+enum class LTOKind { None, Thin, Full };
+
+// Run the standard O3 pipeline using PassBuilder; TM supplies the cost
+// models (vector width, ...). withVecOpt adds the VecOpt stages (linked in
+// from ../src) at their usual extension points. With LTO, the matching
+// pre-link pipeline runs instead, leaving vectorization to the link step.
+void runO3Pipeline(llvm::Module &M, llvm::TargetMachine *TM, bool withVecOpt = false,
+                   LTOKind LTO = LTOKind::None);
+
+// Write M as bitcode into Out. For LTO a module summary index is attached,
+// as clang does: the ThinLTO summary for Thin, and a summary plus the
+// ThinLTO=0 module flag for Full.
+void emitBitcodeToBuffer(llvm::Module &M, LTOKind LTO, llvm::SmallVectorImpl<char> &Out);
+
+// Emit the object code for M into Out; false if TM can't emit objects.
+bool emitObjectToBuffer(llvm::Module &M, llvm::TargetMachine &TM, llvm::SmallVectorImpl<char> &Out);
 
 // Emit an object file (.o) from a module with a given TargetMachine.
 void emitObjectFile(llvm::Module &M, llvm::TargetMachine &TM, const std::string &outPath);
 
-// AST -> IR (our tiny C subset)
-struct FuncAST;
-void buildFromAST(llvm::Module &M, const FuncAST &F);
+// AST -> IR (our tiny C subset): every function of the translation unit,
+// plus the vector variants its #pragma declare simd lines ask for
+struct TranslationUnit;
+void buildFromAST(llvm::Module &M, const TranslationUnit &TU);
+
+// --specialize: add [function.]param=value entries to the TU, as if each
+// were a #pragma specialize on the matching definitions (any function with
+// that parameter when unqualified). Throws std::runtime_error on bad input.
+void addSpecializations(TranslationUnit &TU, const std::vector<std::string> &Specs);
+
+// C header declaring the TU's declare simd functions with their pragmas
+// (as #pragma omp declare simd), for callers compiled with -fopenmp-simd.
+std::string declareSimdHeader(const TranslationUnit &TU, const std::string &source);
@@ -1,262 +1,1825 @@
 #include "ast.h"
 #include "codegen.h"
+#include <llvm/Analysis/AssumptionCache.h>
+#include <llvm/Analysis/CaptureTracking.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Analysis/ScalarEvolution.h>
+#include <llvm/Analysis/TargetLibraryInfo.h>
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/Dominators.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/InstIterator.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IR/ValueHandle.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/TargetParser/Triple.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
 #include <map>
+#include <optional>
+#include <set>
 
 using namespace llvm;
 
 namespace {
 
+// An IR value together with its C type (signedness lives only here).
+struct RValue {
+    Value* V;
+    CType T;
+};
+
+// An assignable location: a scalar variable (SSA, by key) or an array
+// element (memory, by address), and the C type stored there.
+struct LValue {
+    Value* Addr; // nullptr for a scalar variable
+    CType T;
+    std::string Var;
+};
+
 struct CodeGenVisitor {
     Module &M;
     IRBuilder<> B;
-    std::map<std::string, Value*> namedValues;
     Function* currentFunction = nullptr;
+    CType retType;
+
+    // --- SSA construction ---
+    // Scalars never have their address taken, so they are kept in SSA form
+    // from the start with on-the-fly phi placement (Braun et al., "Simple and
+    // Efficient Construction of Static Single Assignment Form", CC 2013).
+    // No allocas reach O3. A block is sealed once all its predecessors have
+    // branched to it; reads in unsealed blocks get operandless phis that are
+    // completed on sealing. Each C declaration gets its own variable key so
+    // shadowed names never share phis.
+    std::map<std::string, std::string, std::less<>> scope; // C name -> variable key
+    std::map<std::string, CType> varTypes;     // variable key -> type
+    std::map<BasicBlock*, std::map<std::string, WeakTrackingVH>> currentDef;
+    std::set<BasicBlock*> sealedBlocks;
+    std::map<BasicBlock*, std::vector<std::pair<std::string, PHINode*>>> incompletePhis;
+    unsigned varCounter = 0;
+
+    std::string declareVar(std::string_view name, CType T) {
+        std::string key = std::string(name) + "." + std::to_string(varCounter++);
+        scope.insert_or_assign(std::string(name), key);
+        varTypes[key] = T;
+        return key;
+    }
+
+    const std::string &lookupVar(std::string_view name) {
+        auto it = scope.find(name);
+        if (it == scope.end()) throw std::runtime_error("Unknown variable name: " + std::string(name));
+        return it->second;
+    }
+
+    static std::string displayName(const std::string &key) {
+        return key.substr(0, key.rfind('.'));
+    }
+
+    void writeVariable(const std::string &key, BasicBlock* BB, Value* V) {
+        currentDef[BB][key] = V;
+    }
+
+    Value* readVariable(const std::string &key, BasicBlock* BB) {
+        auto &defs = currentDef[BB];
+        auto it = defs.find(key);
+        if (it != defs.end() && it->second) return it->second;
+        return readVariableRecursive(key, BB);
+    }
+
+    PHINode* newPhi(const std::string &key, BasicBlock* BB) {
+        Type* Ty = valueType(varTypes[key]);
+        if (BB->empty()) return PHINode::Create(Ty, 0, displayName(key), BB);
+        return PHINode::Create(Ty, 0, displayName(key), &BB->front());
+    }
+
+    Value* readVariableRecursive(const std::string &key, BasicBlock* BB) {
+        Value* V;
+        if (!sealedBlocks.count(BB)) {
+            PHINode* Phi = newPhi(key, BB);
+            incompletePhis[BB].push_back({key, Phi});
+            V = Phi;
+        } else if (BasicBlock* Pred = BB->getSinglePredecessor()) {
+            V = readVariable(key, Pred);
+        } else if (pred_empty(BB)) {
+            V = UndefValue::get(valueType(varTypes[key])); // read before any write
+        } else {
+            // break cycles: define the phi before looking at predecessors
+            PHINode* Phi = newPhi(key, BB);
+            writeVariable(key, BB, Phi);
+            V = addPhiOperands(key, Phi);
+        }
+        writeVariable(key, BB, V);
+        return V;
+    }
+
+    Value* addPhiOperands(const std::string &key, PHINode* Phi) {
+        for (BasicBlock* Pred : predecessors(Phi->getParent()))
+            Phi->addIncoming(readVariable(key, Pred), Pred);
+        return tryRemoveTrivialPhi(Phi);
+    }
+
+    // A phi that only merges one value (and itself) is that value.
+    Value* tryRemoveTrivialPhi(PHINode* Phi) {
+        Value* Same = nullptr;
+        for (Value* Op : Phi->incoming_values()) {
+            if (Op == Same || Op == Phi) continue;
+            if (Same) return Phi; // merges at least two values
+            Same = Op;
+        }
+        if (!Same) Same = UndefValue::get(Phi->getType());
+        SmallVector<PHINode*, 4> Users;
+        for (User* U : Phi->users())
+            if (auto* P = dyn_cast<PHINode>(U))
+                if (P != Phi && sealedBlocks.count(P->getParent())) Users.push_back(P);
+        Phi->replaceAllUsesWith(Same); // currentDef handles follow the RAUW
+        Phi->eraseFromParent();
+        for (PHINode* P : Users) tryRemoveTrivialPhi(P);
+        return Same;
+    }
+
+    void sealBlock(BasicBlock* BB) {
+        auto it = incompletePhis.find(BB);
+        if (it != incompletePhis.end()) {
+            auto Phis = std::move(it->second);
+            incompletePhis.erase(it);
+            for (auto &KP : Phis) addPhiOperands(KP.first, KP.second);
+        }
+        sealedBlocks.insert(BB);
+    }
+
+    RValue loadLV(const LValue &LV, const Twine &Name = "") {
+        if (!LV.Addr) return {readVariable(LV.Var, B.GetInsertBlock()), LV.T};
+        if (lanes)
+            return {B.CreateMaskedGather(valueType(LV.T), LV.Addr, elemAlign(LV.T), mask(), nullptr, Name), LV.T};
+        return {B.CreateLoad(llvmType(LV.T), LV.Addr, Name), LV.T};
+    }
+
+    // In a SIMD variant only the active lanes are written.
+    void storeLV(const LValue &LV, Value* V) {
+        if (lanes && LV.Addr) {
+            B.CreateMaskedScatter(V, LV.Addr, elemAlign(LV.T), mask());
+            return;
+        }
+        if (lanes) V = B.CreateSelect(mask(), V, readVariable(LV.Var, B.GetInsertBlock()));
+        if (!LV.Addr) writeVariable(LV.Var, B.GetInsertBlock(), V);
+        else B.CreateStore(V, LV.Addr);
+    }
+
+    // C signature of every function declared so far in the TU
+    struct FuncSig {
+        CType ret;
+        std::vector<CType> params;
+        Function* F;
+    };
+    std::map<std::string, FuncSig, std::less<>> functions;
+
+    // --- SIMD variants ---
+    // A #pragma declare simd variant is generated from the same AST with
+    // every value widened to `lanes` elements, one per call of the scalar
+    // function. Control flow becomes an active-lane mask (an SSA variable
+    // like any other), memory accesses masked gathers/scatters, and calls
+    // one scalar call per active lane.
+    unsigned lanes = 0;  // 0: scalar code
+    std::string maskKey; // <lanes x i1>: lanes executing the current statement
+    std::string doneKey; // <lanes x i1>: lanes that have returned
+    std::string retKey;  // their return values
+
+    Value* mask() { return readVariable(maskKey, B.GetInsertBlock()); }
+    void setMask(Value* V) { writeVariable(maskKey, B.GetInsertBlock(), V); }
+    Value* anyLane(Value* Mk) { return B.CreateOrReduce(Mk); }
+    // After a statement that may return: the lanes of Outer still running.
+    void dropReturned(Value* Outer) {
+        setMask(B.CreateAnd(Outer, B.CreateNot(readVariable(doneKey, B.GetInsertBlock())), "live"));
+    }
 
     CodeGenVisitor(Module &M) : M(M), B(M.getContext()) {}
 
-    // --- Expression visitor ---
-    Value* visit(Expr* e) {
-        if (auto* n = dynamic_cast<NumberExpr*>(e)) {
-            return ConstantInt::get(Type::getInt32Ty(M.getContext()), n->v);
-        }
-
-        if (auto* v = dynamic_cast<VarExpr*>(e)) {
-            Value* V = namedValues[v->name];
-            if (!V) throw std::runtime_error("Unknown variable name: " + v->name);
-            if (auto* alloc = dyn_cast<AllocaInst>(V)) {
-                return B.CreateLoad(alloc->getAllocatedType(), alloc, v->name);
-            }
-            return V; // Argument*
-        }
-
-        if (auto* bin = dynamic_cast<BinExpr*>(e)) {
-            Value* L = visit(bin->a.get());
-            Value* R = visit(bin->b.get());
-            switch (bin->op) {
-                case BinOp::Add: return B.CreateAdd(L, R, "addtmp");
-                case BinOp::Sub: return B.CreateSub(L, R, "subtmp");
-                case BinOp::Mul: return B.CreateMul(L, R, "multmp");
-                case BinOp::Div: return B.CreateSDiv(L, R, "divtmp");
-                case BinOp::LT:  return B.CreateICmpSLT(L, R, "cmptmp");
-                case BinOp::LE: return B.CreateICmpSLE(L, R, "cmple");
-                case BinOp::GT: return B.CreateICmpSGT(L, R, "cmpgt");
-                case BinOp::GE: return B.CreateICmpSGE(L, R, "cmpge");
-                case BinOp::EQ: return B.CreateICmpEQ (L, R, "cmpeq");
-                case BinOp::NE: return B.CreateICmpNE (L, R, "cmpne");
-                case BinOp::And: return B.CreateAnd(L, R, "andtmp");
-                case BinOp::Or:  return B.CreateOr (L, R, "ortmp");
-                case BinOp::Xor: return B.CreateXor(L, R, "xortmp");
-                case BinOp::Shl: return B.CreateShl(L, R, "shltmp");
-                case BinOp::Shr: return B.CreateLShr(L, R, "lsrtmp");
-                default: throw std::runtime_error("unsupported binary operator");
-            }
-        }
-
-        if (auto* assign = dynamic_cast<AssignExpr*>(e)) {
-            if (auto* var = dynamic_cast<VarExpr*>(assign->lhs.get())) {
-                Value* varPtr = namedValues[var->name];
-                if (!isa<AllocaInst>(varPtr))
-                    throw std::runtime_error("assignment to non-lvalue: " + var->name);
-                Value* val = visit(assign->rhs.get());
-                B.CreateStore(val, varPtr);
-                return val;
+    // --- Types ---
+    Type* llvmType(const CType &T) {
+        LLVMContext &C = M.getContext();
+        if (T.isPointer()) {
+            CType P = T.pointee();
+            // void* is addressed as bytes
+            return PointerType::getUnqual(P.isVoid() ? Type::getInt8Ty(C) : llvmType(P));
+        }
+        switch (T.kind) {
+            case TypeKind::Void:   return Type::getVoidTy(C);
+            case TypeKind::Bool:   return Type::getInt1Ty(C);
+            case TypeKind::Char:   return Type::getInt8Ty(C);
+            case TypeKind::Short:  return Type::getInt16Ty(C);
+            case TypeKind::Int:    return Type::getInt32Ty(C);
+            case TypeKind::Long:   return Type::getInt64Ty(C);
+            case TypeKind::Float:  return Type::getFloatTy(C);
+            case TypeKind::Double: return Type::getDoubleTy(C);
+        }
+        llvm_unreachable("bad type kind");
+    }
+
+    // Type of a value of C type T: a vector of them in a SIMD variant.
+    Type* valueType(const CType &T) {
+        Type* S = llvmType(T);
+        return lanes && !T.isVoid() ? FixedVectorType::get(S, lanes) : S;
+    }
+
+    Align elemAlign(const CType &T) { return M.getDataLayout().getABITypeAlign(llvmType(T)); }
+
+    // Integer promotion: everything narrower than int becomes int.
+    static CType promote(CType T) {
+        if (T.isInteger() && T.bits() < 32) return CType(TypeKind::Int);
+        return T;
+    }
+
+    // Usual arithmetic conversions (C11 6.3.1.8) for LP64.
+    static CType usualArith(CType A, CType Bt) {
+        if (A.kind == TypeKind::Double || Bt.kind == TypeKind::Double) return CType(TypeKind::Double);
+        if (A.kind == TypeKind::Float  || Bt.kind == TypeKind::Float)  return CType(TypeKind::Float);
+        A = promote(A); Bt = promote(Bt);
+        if (A == Bt) return A;
+        if (A.isUnsigned == Bt.isUnsigned) return A.bits() >= Bt.bits() ? A : Bt;
+        CType U = A.isUnsigned ? A : Bt, S = A.isUnsigned ? Bt : A;
+        return U.bits() >= S.bits() ? U : S; // wider signed type holds every unsigned value
+    }
+
+    // Implicit or explicit conversion of V to type To.
+    RValue convert(RValue V, CType To) {
+        if (V.T == To || To.isVoid()) return {V.V, To};
+        if (V.T.isVoid()) throw std::runtime_error("void value not ignored as it ought to be");
+        if (To.kind == TypeKind::Bool && !To.isPointer()) return {toBool(V), To};
+        Type* DT = valueType(To);
+        if (To.isPointer()) {
+            if (V.T.isPointer()) return {B.CreatePointerCast(V.V, DT), To};
+            return {B.CreateIntToPtr(V.V, DT), To};
+        }
+        if (V.T.isPointer()) return {B.CreatePtrToInt(V.V, DT), To};
+        if (To.isFloating()) {
+            if (V.T.isFloating()) return {B.CreateFPCast(V.V, DT), To};
+            if (V.T.isSigned()) return {B.CreateSIToFP(V.V, DT), To};
+            return {B.CreateUIToFP(V.V, DT), To};
+        }
+        if (V.T.isFloating())
+            return {To.isUnsigned ? B.CreateFPToUI(V.V, DT) : B.CreateFPToSI(V.V, DT), To};
+        return {B.CreateIntCast(V.V, DT, V.T.isSigned()), To};
+    }
+
+    // C truth value: v != 0 (comparisons are already i1)
+    Value* toBool(RValue V) {
+        if (V.T.kind == TypeKind::Bool && !V.T.isPointer()) return V.V;
+        if (V.T.isPointer()) return B.CreateIsNotNull(V.V, "tobool");
+        if (V.T.isFloating())
+            return B.CreateFCmpUNE(V.V, ConstantFP::get(V.V->getType(), 0.0), "tobool");
+        return B.CreateICmpNE(V.V, ConstantInt::get(V.V->getType(), 0), "tobool");
+    }
+
+    // Can e be evaluated unconditionally? No stores, calls, loads (the
+    // index may be out of range on the untaken side) or division.
+    static bool isSpeculatable(Expr* e) {
+        switch (e->kind) {
+            case ExprKind::Number: case ExprKind::Float: case ExprKind::Var:
+                return true;
+            case ExprKind::Bin: {
+                auto* bin = static_cast<BinExpr*>(e);
+                return bin->op != BinOp::Div && bin->op != BinOp::Mod &&
+                       isSpeculatable(bin->a) && isSpeculatable(bin->b);
             }
-            if (auto* idx = dynamic_cast<IndexExpr*>(assign->lhs.get())) {
-                Value* basePtr = namedValues[idx->base];
-                Value* offset = visit(idx->idx.get());
-                Value* addr = B.CreateGEP(Type::getInt32Ty(M.getContext()), basePtr, offset, "ptr_addr");
-                Value* val = visit(assign->rhs.get());
-                B.CreateStore(val, addr);
-                return val;
+            case ExprKind::Unary: {
+                auto* un = static_cast<UnaryExpr*>(e);
+                return (un->op == UnOp::Neg || un->op == UnOp::Not || un->op == UnOp::BitNot) &&
+                       isSpeculatable(un->e);
             }
+            case ExprKind::Cast:
+                return isSpeculatable(static_cast<CastExpr*>(e)->e);
+            case ExprKind::Cond: {
+                auto* ce = static_cast<CondExpr*>(e);
+                return isSpeculatable(ce->cond) && isSpeculatable(ce->a) && isSpeculatable(ce->b);
+            }
+            default:
+                return false;
         }
+    }
 
-        // 修正 IndexExpr 處理：
-        if (auto* idx = dynamic_cast<IndexExpr*>(e)) {
-            Value* basePtr = nullptr;
+    // Result type of ?: (pointers pass through, arithmetic arms convert).
+    static CType commonType(CType A, CType Bt) {
+        if (A.isPointer()) return A;
+        if (Bt.isPointer()) return Bt;
+        return usualArith(A, Bt);
+    }
 
+    // --- L-values ---
+    LValue emitLValue(Expr* e) {
+        if (auto* v = nodeAs<VarExpr>(e)) {
+            const std::string &key = lookupVar(v->name);
+            return {nullptr, varTypes[key], key};
+        }
+        if (auto* idx = nodeAs<IndexExpr>(e)) {
             // 尋找符號表或是函數參數
-            auto it = namedValues.find(idx->base);
-            if (it != namedValues.end()) {
-                basePtr = it->second;
-            } else {
-                throw std::runtime_error("Unknown array/pointer name: " + idx->base);
-            }
+            auto it = scope.find(idx->base);
+            if (it == scope.end())
+                throw std::runtime_error("Unknown array/pointer name: " + std::string(idx->base));
+            const std::string &key = it->second;
+            CType PT = varTypes[key];
+            if (!PT.isPointer()) throw std::runtime_error("subscript of non-pointer: " + std::string(idx->base));
+            Value* basePtr = readVariable(key, B.GetInsertBlock());
 
-            Value* offset = visit(idx->idx.get());
+            // index as a 64-bit offset, extended per its signedness
+            RValue off = visit(idx->idx);
+            if (!off.T.isInteger()) throw std::runtime_error("array index is not an integer");
+            Value* offset = B.CreateIntCast(off.V, valueType(CType(TypeKind::Long)), off.T.isSigned());
+
+            // 元素型別由 CType 追蹤，不依賴 pointer element type（opaque pointers）
+            CType ET = PT.pointee();
+            Type* elemType = ET.isVoid() ? B.getInt8Ty() : llvmType(ET);
+            // C only allows subscripts inside the object: inbounds
+            Value* addr = B.CreateInBoundsGEP(elemType, basePtr, offset, StringRef(idx->base) + "_idx");
+            return {addr, ET, ""};
+        }
+        throw std::runtime_error("expression is not assignable");
+    }
 
-            // 修正: 兼容不同版本 LLVM 的 PointerType 處理
-            Type* elemType = Type::getInt32Ty(M.getContext());
-            if (auto* ptrTy = dyn_cast<PointerType>(basePtr->getType())) {
-                // 新的 LLVM API 版本用法
-                elemType = ptrTy->getNonOpaquePointerElementType();
+    // --- Binary operators on already-evaluated operands ---
+    RValue emitBinOp(BinOp op, RValue L, RValue R) {
+        // pointer +/- integer, pointer - pointer
+        if (L.T.isPointer() || R.T.isPointer()) {
+            if (op == BinOp::Add || op == BinOp::Sub) {
+                if (L.T.isPointer() && R.T.isPointer() && op == BinOp::Sub) {
+                    CType Long(TypeKind::Long);
+                    Type* ET = L.T.pointee().isVoid() ? B.getInt8Ty() : llvmType(L.T.pointee());
+                    Type* I64 = valueType(Long);
+                    Value* Bytes = B.CreateSub(B.CreatePtrToInt(L.V, I64), B.CreatePtrToInt(R.V, I64));
+                    uint64_t Size = M.getDataLayout().getTypeAllocSize(ET);
+                    return {B.CreateExactSDiv(Bytes, ConstantInt::get(I64, Size), "ptrdiff"), Long};
+                }
+                if (R.T.isPointer()) std::swap(L, R);
+                if (R.T.isInteger()) {
+                    Value* off = B.CreateIntCast(R.V, valueType(CType(TypeKind::Long)), R.T.isSigned());
+                    if (op == BinOp::Sub) off = B.CreateNeg(off);
+                    Type* ET = L.T.pointee().isVoid() ? B.getInt8Ty() : llvmType(L.T.pointee());
+                    return {B.CreateInBoundsGEP(ET, L.V, off, "ptradd"), L.T};
+                }
+            }
+            if (L.T.isPointer() && R.T.isPointer()) {
+                CType Bool(TypeKind::Bool);
+                switch (op) {
+                    case BinOp::LT: return {B.CreateICmpULT(L.V, R.V, "cmptmp"), Bool};
+                    case BinOp::LE: return {B.CreateICmpULE(L.V, R.V, "cmple"), Bool};
+                    case BinOp::GT: return {B.CreateICmpUGT(L.V, R.V, "cmpgt"), Bool};
+                    case BinOp::GE: return {B.CreateICmpUGE(L.V, R.V, "cmpge"), Bool};
+                    case BinOp::EQ: return {B.CreateICmpEQ (L.V, R.V, "cmpeq"), Bool};
+                    case BinOp::NE: return {B.CreateICmpNE (L.V, R.V, "cmpne"), Bool};
+                    default: break;
+                }
             }
+            throw std::runtime_error("unsupported pointer arithmetic");
+        }
 
-            Value* addr = B.CreateGEP(elemType, basePtr, offset, idx->base + "_idx");
-            return B.CreateLoad(elemType, addr, idx->base + "_load");
+        // shifts: result has the promoted left type; the count just follows it
+        if (op == BinOp::Shl || op == BinOp::Shr) {
+            CType LT = promote(L.T);
+            if (!LT.isInteger() || !R.T.isInteger()) throw std::runtime_error("shift of non-integer");
+            Value* Lv = convert(L, LT).V;
+            Value* Rv = B.CreateIntCast(R.V, Lv->getType(), R.T.isSigned());
+            if (op == BinOp::Shl) return {B.CreateShl(Lv, Rv, "shltmp"), LT};
+            if (LT.isUnsigned) return {B.CreateLShr(Lv, Rv, "lsrtmp"), LT};
+            return {B.CreateAShr(Lv, Rv, "asrtmp"), LT};
         }
 
+        CType CT = usualArith(L.T, R.T);
+        Value* Lv = convert(L, CT).V;
+        Value* Rv = convert(R, CT).V;
+        bool fp = CT.isFloating(), uns = CT.isUnsigned;
+        // signed overflow is undefined in C: nsw lets SCEV prove i = i + 1
+        // doesn't wrap (trip counts, IV widening instead of a sext per access)
+        bool nsw = CT.isSigned();
+        CType Bool(TypeKind::Bool);
+        // inactive lanes divide by 1: their operands may be anything
+        if (lanes && !fp && (op == BinOp::Div || op == BinOp::Mod))
+            Rv = B.CreateSelect(mask(), Rv, ConstantInt::get(Rv->getType(), 1));
+        switch (op) {
+            case BinOp::Add:
+                if (fp) return {B.CreateFAdd(Lv, Rv, "addtmp"), CT};
+                return {B.CreateAdd(Lv, Rv, "addtmp", /*HasNUW=*/false, nsw), CT};
+            case BinOp::Sub:
+                if (fp) return {B.CreateFSub(Lv, Rv, "subtmp"), CT};
+                return {B.CreateSub(Lv, Rv, "subtmp", /*HasNUW=*/false, nsw), CT};
+            case BinOp::Mul:
+                if (fp) return {B.CreateFMul(Lv, Rv, "multmp"), CT};
+                return {B.CreateMul(Lv, Rv, "multmp", /*HasNUW=*/false, nsw), CT};
+            case BinOp::Div:
+                if (fp) return {B.CreateFDiv(Lv, Rv, "divtmp"), CT};
+                return {uns ? B.CreateUDiv(Lv, Rv, "divtmp") : B.CreateSDiv(Lv, Rv, "divtmp"), CT};
+            case BinOp::Mod:
+                if (fp) throw std::runtime_error("% on floating-point operands");
+                return {uns ? B.CreateURem(Lv, Rv, "remtmp") : B.CreateSRem(Lv, Rv, "remtmp"), CT};
+            case BinOp::LT:
+                if (fp) return {B.CreateFCmpOLT(Lv, Rv, "cmptmp"), Bool};
+                return {uns ? B.CreateICmpULT(Lv, Rv, "cmptmp") : B.CreateICmpSLT(Lv, Rv, "cmptmp"), Bool};
+            case BinOp::LE:
+                if (fp) return {B.CreateFCmpOLE(Lv, Rv, "cmple"), Bool};
+                return {uns ? B.CreateICmpULE(Lv, Rv, "cmple") : B.CreateICmpSLE(Lv, Rv, "cmple"), Bool};
+            case BinOp::GT:
+                if (fp) return {B.CreateFCmpOGT(Lv, Rv, "cmpgt"), Bool};
+                return {uns ? B.CreateICmpUGT(Lv, Rv, "cmpgt") : B.CreateICmpSGT(Lv, Rv, "cmpgt"), Bool};
+            case BinOp::GE:
+                if (fp) return {B.CreateFCmpOGE(Lv, Rv, "cmpge"), Bool};
+                return {uns ? B.CreateICmpUGE(Lv, Rv, "cmpge") : B.CreateICmpSGE(Lv, Rv, "cmpge"), Bool};
+            case BinOp::EQ:
+                return {fp ? B.CreateFCmpOEQ(Lv, Rv, "cmpeq") : B.CreateICmpEQ(Lv, Rv, "cmpeq"), Bool};
+            case BinOp::NE:
+                return {fp ? B.CreateFCmpUNE(Lv, Rv, "cmpne") : B.CreateICmpNE(Lv, Rv, "cmpne"), Bool};
+            default: break;
+        }
+        if (fp) throw std::runtime_error("bitwise operator on floating-point operands");
+        switch (op) {
+            case BinOp::And: return {B.CreateAnd(Lv, Rv, "andtmp"), CT};
+            case BinOp::Or:  return {B.CreateOr (Lv, Rv, "ortmp"), CT};
+            case BinOp::Xor: return {B.CreateXor(Lv, Rv, "xortmp"), CT};
+            default: throw std::runtime_error("unsupported binary operator");
+        }
+    }
+
+    // && / ||: select form when the right side is speculatable, else
+    // short-circuit branches.
+    RValue emitLogical(BinExpr* bin) {
+        bool isAnd = bin->op == BinOp::LAnd;
+        CType Bool(TypeKind::Bool);
+        Value* L = toBool(visit(bin->a));
+        if (isSpeculatable(bin->b)) {
+            Value* R = toBool(visit(bin->b));
+            return {isAnd ? B.CreateLogicalAnd(L, R, "land") : B.CreateLogicalOr(L, R, "lor"), Bool};
+        }
+        if (lanes) {
+            // the right side runs in the lanes whose result it decides
+            Value* Outer = mask();
+            setMask(B.CreateAnd(Outer, isAnd ? L : B.CreateNot(L)));
+            Value* R = toBool(visit(bin->b));
+            setMask(Outer);
+            return {isAnd ? B.CreateAnd(L, R, "land") : B.CreateOr(L, R, "lor"), Bool};
+        }
+        BasicBlock* LhsEnd = B.GetInsertBlock();
+        BasicBlock* RhsBB = BasicBlock::Create(M.getContext(), isAnd ? "land.rhs" : "lor.rhs", currentFunction);
+        BasicBlock* EndBB = BasicBlock::Create(M.getContext(), isAnd ? "land.end" : "lor.end", currentFunction);
+        if (isAnd) B.CreateCondBr(L, RhsBB, EndBB);
+        else       B.CreateCondBr(L, EndBB, RhsBB);
+        sealBlock(RhsBB);
+        B.SetInsertPoint(RhsBB);
+        Value* R = toBool(visit(bin->b));
+        BasicBlock* RhsEnd = B.GetInsertBlock();
+        B.CreateBr(EndBB);
+        sealBlock(EndBB);
+        B.SetInsertPoint(EndBB);
+        PHINode* P = B.CreatePHI(B.getInt1Ty(), 2, isAnd ? "land" : "lor");
+        P->addIncoming(isAnd ? B.getFalse() : B.getTrue(), LhsEnd);
+        P->addIncoming(R, RhsEnd);
+        return {P, Bool};
+    }
+
+    // --- Expression visitor ---
+    RValue visit(Expr* e) {
+        switch (e->kind) {
+            case ExprKind::Number: {
+                auto* n = static_cast<NumberExpr*>(e);
+                return {ConstantInt::get(valueType(n->type), n->v, n->type.isSigned()), n->type};
+            }
+            case ExprKind::Float: {
+                auto* f = static_cast<FloatExpr*>(e);
+                return {ConstantFP::get(valueType(f->type), f->v), f->type};
+            }
+            case ExprKind::Var: {
+                auto* v = static_cast<VarExpr*>(e);
+                return loadLV(emitLValue(v));
+            }
+            case ExprKind::Bin: {
+                auto* bin = static_cast<BinExpr*>(e);
+                if (bin->op == BinOp::LAnd || bin->op == BinOp::LOr) return emitLogical(bin);
+                RValue L = visit(bin->a);
+                RValue R = visit(bin->b);
+                return emitBinOp(bin->op, L, R);
+            }
+            case ExprKind::Unary: {
+                auto* un = static_cast<UnaryExpr*>(e);
+                switch (un->op) {
+                    case UnOp::Neg: {
+                        RValue V = visit(un->e);
+                        if (V.T.isFloating()) return {B.CreateFNeg(V.V, "negtmp"), V.T};
+                        V = convert(V, promote(V.T));
+                        return {B.CreateNeg(V.V, "negtmp", /*HasNUW=*/false, V.T.isSigned()), V.T};
+                    }
+                    case UnOp::Not:
+                        return {B.CreateNot(toBool(visit(un->e)), "lnot"), CType(TypeKind::Bool)};
+                    case UnOp::BitNot: {
+                        RValue V = visit(un->e);
+                        if (!V.T.isInteger()) throw std::runtime_error("~ on non-integer");
+                        V = convert(V, promote(V.T));
+                        return {B.CreateNot(V.V, "nottmp"), V.T};
+                    }
+                    default: {
+                        // ++/--: computed in the promoted type, stored back narrowed
+                        LValue LV = emitLValue(un->e);
+                        RValue Old = loadLV(LV);
+                        bool inc = un->op == UnOp::PreInc || un->op == UnOp::PostInc;
+                        RValue One{ConstantInt::get(valueType(CType(TypeKind::Int)), 1), CType(TypeKind::Int)};
+                        RValue New = convert(emitBinOp(inc ? BinOp::Add : BinOp::Sub, Old, One), LV.T);
+                        storeLV(LV, New.V);
+                        bool post = un->op == UnOp::PostInc || un->op == UnOp::PostDec;
+                        return post ? Old : New;
+                    }
+                }
+            }
+            case ExprKind::Cast: {
+                auto* cast = static_cast<CastExpr*>(e);
+                return convert(visit(cast->e), cast->to);
+            }
+            case ExprKind::Cond: {
+                auto* ce = static_cast<CondExpr*>(e);
+                Value* C = toBool(visit(ce->cond));
+                // Side-effect-free arms: straight to select, no CFG.
+                if (isSpeculatable(ce->a) && isSpeculatable(ce->b)) {
+                    RValue T = visit(ce->a);
+                    RValue F = visit(ce->b);
+                    CType RT = commonType(T.T, F.T);
+                    T = convert(T, RT);
+                    F = convert(F, RT);
+                    return {B.CreateSelect(C, T.V, F.V, "condtmp"), RT};
+                }
+                if (lanes) {
+                    // each arm in its own lanes, then a blend
+                    Value* Outer = mask();
+                    setMask(B.CreateAnd(Outer, C));
+                    RValue T = visit(ce->a);
+                    setMask(B.CreateAnd(Outer, B.CreateNot(C)));
+                    RValue F = visit(ce->b);
+                    setMask(Outer);
+                    CType RT = commonType(T.T, F.T);
+                    T = convert(T, RT);
+                    F = convert(F, RT);
+                    return {B.CreateSelect(C, T.V, F.V, "condtmp"), RT};
+                }
+                BasicBlock* TrueBB  = BasicBlock::Create(M.getContext(), "cond.true",  currentFunction);
+                BasicBlock* FalseBB = BasicBlock::Create(M.getContext(), "cond.false", currentFunction);
+                BasicBlock* EndBB   = BasicBlock::Create(M.getContext(), "cond.end",   currentFunction);
+                B.CreateCondBr(C, TrueBB, FalseBB);
+                sealBlock(TrueBB);
+                sealBlock(FalseBB);
+                B.SetInsertPoint(TrueBB);
+                RValue T = visit(ce->a);
+                BasicBlock* TrueEnd = B.GetInsertBlock();
+                B.SetInsertPoint(FalseBB);
+                RValue F = visit(ce->b);
+                BasicBlock* FalseEnd = B.GetInsertBlock();
+                // each arm converts to the common type before its branch
+                CType RT = commonType(T.T, F.T);
+                B.SetInsertPoint(TrueEnd);
+                T = convert(T, RT);
+                B.CreateBr(EndBB);
+                B.SetInsertPoint(FalseEnd);
+                F = convert(F, RT);
+                B.CreateBr(EndBB);
+                sealBlock(EndBB);
+                B.SetInsertPoint(EndBB);
+                PHINode* P = B.CreatePHI(llvmType(RT), 2, "condtmp");
+                P->addIncoming(T.V, TrueEnd);
+                P->addIncoming(F.V, FalseEnd);
+                return {P, RT};
+            }
+            case ExprKind::Assign: {
+                auto* assign = static_cast<AssignExpr*>(e);
+                LValue LV = emitLValue(assign->lhs);
+                RValue val;
+                if (assign->compound) {
+                    RValue Old = loadLV(LV);
+                    val = emitBinOp(assign->op, Old, visit(assign->rhs));
+                } else {
+                    val = visit(assign->rhs);
+                }
+                val = convert(val, LV.T);
+                storeLV(LV, val.V);
+                return val;
+            }
+            case ExprKind::Index: {
+                auto* idx = static_cast<IndexExpr*>(e);
+                return loadLV(emitLValue(idx), StringRef(idx->base) + "_load");
+            }
+            case ExprKind::Call: {
+                auto* call = static_cast<CallExpr*>(e);
+                auto it = functions.find(call->callee);
+                if (it == functions.end())
+                    throw std::runtime_error("call to undeclared function: " + std::string(call->callee));
+                const FuncSig &Sig = it->second;
+                if (call->args.size() != Sig.params.size())
+                    throw std::runtime_error("wrong number of arguments to " + std::string(call->callee));
+                std::vector<Value*> Args;
+                for (size_t i = 0; i < call->args.size(); ++i)
+                    Args.push_back(convert(visit(call->args[i]), Sig.params[i]).V);
+                if (lanes) return emitLaneCalls(Sig, Args);
+                CallInst* CI = B.CreateCall(Sig.F, Args, Sig.ret.isVoid() ? "" : "calltmp");
+                return {CI, Sig.ret};
+            }
+        }
         throw std::runtime_error("unknown expression type in codegen");
     }
 
+    // A call in a SIMD variant: the scalar function once per active lane.
+    RValue emitLaneCalls(const FuncSig &Sig, const std::vector<Value*> &Args) {
+        Value* Mk = mask();
+        Value* Res = Sig.ret.isVoid() ? nullptr : UndefValue::get(valueType(Sig.ret));
+        for (unsigned l = 0; l < lanes; ++l) {
+            BasicBlock* From = B.GetInsertBlock();
+            BasicBlock* CallBB = BasicBlock::Create(M.getContext(), "lane.call", currentFunction);
+            BasicBlock* Next = BasicBlock::Create(M.getContext(), "lane.next", currentFunction);
+            B.CreateCondBr(B.CreateExtractElement(Mk, l), CallBB, Next);
+            sealBlock(CallBB);
+            B.SetInsertPoint(CallBB);
+            std::vector<Value*> S;
+            for (Value* A : Args) S.push_back(B.CreateExtractElement(A, l));
+            CallInst* CI = B.CreateCall(Sig.F, S);
+            Value* With = Res ? B.CreateInsertElement(Res, CI, l) : nullptr;
+            B.CreateBr(Next);
+            sealBlock(Next);
+            B.SetInsertPoint(Next);
+            if (Res) {
+                PHINode* P = B.CreatePHI(Res->getType(), 2, "lanes");
+                P->addIncoming(With, CallBB);
+                P->addIncoming(Res, From);
+                Res = P;
+            }
+        }
+        return {Res, Sig.ret};
+    }
+
+    // --- Masked control flow (SIMD variants) ---
+    // One arm of an if: runs with mask Mk, skipped when no lane is in it.
+    void maskedArm(Value* Mk, StmtList stmts, const char* name) {
+        BasicBlock* Arm = BasicBlock::Create(M.getContext(), name, currentFunction);
+        BasicBlock* End = BasicBlock::Create(M.getContext(), Twine(name) + ".end", currentFunction);
+        B.CreateCondBr(anyLane(Mk), Arm, End);
+        sealBlock(Arm);
+        B.SetInsertPoint(Arm);
+        setMask(Mk);
+        visitScope(stmts);
+        B.CreateBr(End);
+        sealBlock(End);
+        B.SetInsertPoint(End);
+    }
+
+    void maskedIf(IfStmt* ifs) {
+        Value* Outer = mask();
+        Value* C = toBool(visit(ifs->cond));
+        Value* ElseM = B.CreateAnd(Outer, B.CreateNot(C), "else.mask");
+        maskedArm(B.CreateAnd(Outer, C, "then.mask"), ifs->thenStmts, "simd.then");
+        if (!ifs->elseStmts.empty()) maskedArm(ElseM, ifs->elseStmts, "simd.else");
+        dropReturned(Outer);
+    }
+
+    // for / while: iterates while any lane is still in the loop. A lane
+    // leaves when its condition fails or it returns.
+    void maskedLoop(Stmt* init, Expr* cond, Expr* inc, StmtList body, const LoopHints &H) {
+        auto saved = scope;
+        if (init) visit(init);
+        Value* Outer = mask();
+        BasicBlock* CondBB  = BasicBlock::Create(M.getContext(), "simd.cond", currentFunction);
+        BasicBlock* BodyBB  = BasicBlock::Create(M.getContext(), "simd.body", currentFunction);
+        BasicBlock* AfterBB = BasicBlock::Create(M.getContext(), "simd.end", currentFunction);
+        B.CreateBr(CondBB);
+
+        B.SetInsertPoint(CondBB);
+        if (cond) setMask(B.CreateAnd(mask(), toBool(visit(cond)), "loop.mask"));
+        B.CreateCondBr(anyLane(mask()), BodyBB, AfterBB);
+        sealBlock(BodyBB);
+        sealBlock(AfterBB);
+
+        B.SetInsertPoint(BodyBB);
+        visitScope(body);
+        if (inc) visit(inc);
+        dropReturned(mask());
+        setLoopHints(B.CreateBr(CondBB), H);
+        sealBlock(CondBB);
+        scope = std::move(saved);
+
+        B.SetInsertPoint(AfterBB);
+        dropReturned(Outer);
+    }
+
+    // return: the active lanes record their value and stop.
+    void maskedReturn(ReturnStmt* ret) {
+        Value* Mk = mask();
+        if (ret->val) {
+            RValue V = visit(ret->val);
+            if (!retType.isVoid()) storeLV({nullptr, retType, retKey}, convert(V, retType).V);
+        }
+        BasicBlock* BB = B.GetInsertBlock();
+        writeVariable(doneKey, BB, B.CreateOr(readVariable(doneKey, BB), Mk, "done"));
+        setMask(Constant::getNullValue(Mk->getType()));
+    }
+
+    // Code after return/… in the same C block lands in a fresh block with
+    // no predecessors.
+    void startDeadBlock() {
+        BasicBlock* Dead = BasicBlock::Create(M.getContext(), "dead", currentFunction);
+        sealBlock(Dead);
+        B.SetInsertPoint(Dead);
+    }
+
+    // Statements of a nested C scope; declarations end with it.
+    void visitScope(StmtList stmts) {
+        auto saved = scope;
+        for (Stmt* st : stmts) visit(st);
+        scope = std::move(saved);
+    }
+
     // --- Statement visitor ---
     void visit(Stmt* s) {
-        if (auto* decl = dynamic_cast<DeclStmt*>(s)) {
-            AllocaInst* slot =
-                B.CreateAlloca(Type::getInt32Ty(M.getContext()), nullptr, decl->name);
-            namedValues[decl->name] = slot;
-            if (decl->init) {
-                Value* initVal = visit(decl->init.get());
-                B.CreateStore(initVal, slot);
+        switch (s->kind) {
+            case StmtKind::Decl: {
+                auto* decl = static_cast<DeclStmt*>(s);
+                // the initializer still sees an outer variable of the same name
+                Value* initVal = nullptr;
+                if (decl->init) initVal = convert(visit(decl->init), decl->type).V;
+                std::string key = declareVar(decl->name, decl->type);
+                if (initVal) writeVariable(key, B.GetInsertBlock(), initVal);
+                return;
             }
+            case StmtKind::Expr: {
+                auto* exprStmt = static_cast<ExprStmt*>(s);
+                visit(exprStmt->expr);
+                return;
+            }
+            case StmtKind::Return: {
+                auto* ret = static_cast<ReturnStmt*>(s);
+                if (parallelBody) throw std::runtime_error("return inside a #pragma parallel loop");
+                if (lanes) return maskedReturn(ret);
+                if (ret->val) {
+                    RValue V = visit(ret->val);
+                    if (retType.isVoid()) B.CreateRetVoid();
+                    else B.CreateRet(convert(V, retType).V);
+                } else if (retType.isVoid()) {
+                    B.CreateRetVoid();
+                } else {
+                    B.CreateRet(Constant::getNullValue(llvmType(retType)));
+                }
+                startDeadBlock();
+                return;
+            }
+            case StmtKind::For: {
+                auto* forStmt = static_cast<ForStmt*>(s);
+                // in a SIMD variant the loop just runs serially
+                if (forStmt->parallel && !lanes) return emitParallelFor(forStmt);
+                if (lanes) return maskedLoop(forStmt->init, forStmt->cond, forStmt->inc, forStmt->body, forStmt->hints);
+                BasicBlock *CondBB  = BasicBlock::Create(M.getContext(), "cond", currentFunction);
+                BasicBlock *LoopBB  = BasicBlock::Create(M.getContext(), "loop", currentFunction);
+                BasicBlock *AfterBB = BasicBlock::Create(M.getContext(), "afterloop", currentFunction);
 
-        } else if (auto* exprStmt = dynamic_cast<ExprStmt*>(s)) {
-            visit(exprStmt->expr.get());
+                // init (its declaration is scoped to the loop)
+                auto saved = scope;
+                if (forStmt->init) visit(forStmt->init);
+                B.CreateBr(CondBB);
 
-        } else if (auto* ret = dynamic_cast<ReturnStmt*>(s)) {
-            B.CreateRet(visit(ret->val.get()));
+                // cond (for(;;) has none); the header stays unsealed until the back edge
+                B.SetInsertPoint(CondBB);
+                if (forStmt->cond) {
+                    Value* CondV = toBool(visit(forStmt->cond));
+                    B.CreateCondBr(CondV, LoopBB, AfterBB);
+                } else {
+                    B.CreateBr(LoopBB);
+                }
+                sealBlock(LoopBB);
+                sealBlock(AfterBB);
 
-        } else if (auto* forStmt = dynamic_cast<ForStmt*>(s)) {
-            BasicBlock *CondBB  = BasicBlock::Create(M.getContext(), "cond", currentFunction);
-            BasicBlock *LoopBB  = BasicBlock::Create(M.getContext(), "loop", currentFunction);
-            BasicBlock *AfterBB = BasicBlock::Create(M.getContext(), "afterloop", currentFunction);
+                // body
+                B.SetInsertPoint(LoopBB);
+                visitScope(forStmt->body);
+                if (forStmt->inc) visit(forStmt->inc);
+                setLoopHints(B.CreateBr(CondBB), forStmt->hints);
+                sealBlock(CondBB);
+                scope = std::move(saved);
 
-            // init
-            if (forStmt->init) visit(forStmt->init.get());
-            B.CreateBr(CondBB);
+                // after loop
+                B.SetInsertPoint(AfterBB);
+                return;
+            }
+            case StmtKind::While: {
+                auto* ws = static_cast<WhileStmt*>(s);
+                if (lanes) return maskedLoop(nullptr, ws->cond, nullptr, ws->body, ws->hints);
+                BasicBlock *CondBB  = BasicBlock::Create(M.getContext(), "while.cond", currentFunction);
+                BasicBlock *LoopBB  = BasicBlock::Create(M.getContext(), "while.body", currentFunction);
+                BasicBlock *AfterBB = BasicBlock::Create(M.getContext(), "while.end", currentFunction);
 
-            // cond
-            B.SetInsertPoint(CondBB);
-            Value* CondV = visit(forStmt->cond.get());
-            B.CreateCondBr(CondV, LoopBB, AfterBB);
+                B.CreateBr(CondBB);
 
-            // body
-            B.SetInsertPoint(LoopBB);
-            for (auto &stmt : forStmt->body) {
-                visit(stmt.get());
+                B.SetInsertPoint(CondBB);
+                Value* CondV = toBool(visit(ws->cond));
+                B.CreateCondBr(CondV, LoopBB, AfterBB);
+                sealBlock(LoopBB);
+                sealBlock(AfterBB);
+
+                B.SetInsertPoint(LoopBB);
+                visitScope(ws->body);
+                setLoopHints(B.CreateBr(CondBB), ws->hints);
+                sealBlock(CondBB);
+
+                B.SetInsertPoint(AfterBB);
+                return;
             }
-            if (forStmt->inc) visit(forStmt->inc.get());
-            B.CreateBr(CondBB);
+            case StmtKind::Block: {
+                auto* block = static_cast<BlockStmt*>(s);
+                visitScope(block->stmts);
+                return;
+            }
+            case StmtKind::If: {
+                auto* ifs = static_cast<IfStmt*>(s);
+                if (lanes) return maskedIf(ifs);
+                // 生成條件值（非 i1 時轉成 v != 0）
+                Value* CondV = toBool(visit(ifs->cond));
 
-            // after loop
-            B.SetInsertPoint(AfterBB);
+                // 建基本區塊：then、else（若有）與 end
+                BasicBlock* ThenBB = BasicBlock::Create(M.getContext(), "if.then", currentFunction);
+                BasicBlock* ElseBB = nullptr;
+                if (!ifs->elseStmts.empty())
+                    ElseBB = BasicBlock::Create(M.getContext(), "if.else", currentFunction);
+                BasicBlock* EndBB  = BasicBlock::Create(M.getContext(), "if.end",  currentFunction);
 
-        } else if (auto* ws = dynamic_cast<WhileStmt*>(s)) {
-            BasicBlock *CondBB  = BasicBlock::Create(M.getContext(), "while.cond", currentFunction);
-            BasicBlock *LoopBB  = BasicBlock::Create(M.getContext(), "while.body", currentFunction);
-            BasicBlock *AfterBB = BasicBlock::Create(M.getContext(), "while.end", currentFunction);
+                // 沒有 else 時，false 直接跳到 EndBB
+                B.CreateCondBr(CondV, ThenBB, ElseBB ? ElseBB : EndBB);
+                sealBlock(ThenBB);
+                if (ElseBB) sealBlock(ElseBB);
 
-            B.CreateBr(CondBB);
+                // 生成 then 區塊
+                B.SetInsertPoint(ThenBB);
+                visitScope(ifs->thenStmts);
+                // 如果 then 區塊沒有終結（例如沒有 return/branch），補一個跳到 EndBB
+                if (!B.GetInsertBlock()->getTerminator()) {
+                    B.CreateBr(EndBB);
+                }
+
+                // 生成 else 區塊（else if 即為巢狀 IfStmt）
+                if (ElseBB) {
+                    B.SetInsertPoint(ElseBB);
+                    visitScope(ifs->elseStmts);
+                    if (!B.GetInsertBlock()->getTerminator()) {
+                        B.CreateBr(EndBB);
+                    }
+                }
+
+                // 繼續在 end 區塊插入（兩邊都已跳入，可封閉）
+                sealBlock(EndBB);
+                B.SetInsertPoint(EndBB);
+                return;
+            }
+        }
+        throw std::runtime_error("unknown statement type in codegen");
+    }
+
+    // --- Parallel loops ---
+    // A #pragma parallel loop is outlined into
+    //     internal void <fn>.par(ptr env, i64 lo, i64 hi, ptr red)
+    // running iterations [lo, hi), and the loop itself becomes a call to
+    // __vlc_parallel_for in runtime/veclangc_par_rt.c. env holds the value of
+    // every variable in scope plus the first IV value; red the reduction
+    // variables, which the body computes from their identity and merges into
+    // *red at the end. Outer variables are read-only in the body.
+    struct CanonicalLoop {
+        std::string_view iv;
+        const DeclStmt* decl = nullptr; // IV declared by the init, else an outer variable
+        Expr* start = nullptr;
+        BinOp cmp = BinOp::LT;
+        Expr* bound = nullptr;
+        int64_t step = 0;
+    };
+    bool parallelBody = false; // generating an outlined loop body
+
+    static bool isVar(Expr* e, std::string_view name) {
+        auto* v = nodeAs<VarExpr>(e);
+        return v && v->name == name;
+    }
 
+    // for (i = start; i <cmp> bound; i += step) with a constant step.
+    static CanonicalLoop canonicalLoop(const ForStmt* fs) {
+        auto fail = [](const char* why) { return std::runtime_error(std::string("#pragma parallel: ") + why); };
+        CanonicalLoop L;
+        if (auto* d = nodeAs<DeclStmt>(fs->init)) {
+            if (!d->init) throw fail("loop variable needs an initial value");
+            L.iv = d->name; L.decl = d; L.start = d->init;
+        } else if (auto* es = nodeAs<ExprStmt>(fs->init)) {
+            auto* a = nodeAs<AssignExpr>(es->expr);
+            auto* v = a && !a->compound ? nodeAs<VarExpr>(a->lhs) : nullptr;
+            if (!v) throw fail("loop init must assign the loop variable");
+            L.iv = v->name; L.start = a->rhs;
+        } else {
+            throw fail("loop has no init");
+        }
+
+        auto* c = nodeAs<BinExpr>(fs->cond);
+        if (!c) throw fail("loop condition must compare the loop variable");
+        static const std::map<BinOp, BinOp> swapped = {
+            {BinOp::LT, BinOp::GT}, {BinOp::LE, BinOp::GE}, {BinOp::GT, BinOp::LT},
+            {BinOp::GE, BinOp::LE}, {BinOp::NE, BinOp::NE}};
+        if (!swapped.count(c->op)) throw fail("loop condition must be <, <=, >, >= or !=");
+        if (isVar(c->a, L.iv)) { L.cmp = c->op; L.bound = c->b; }
+        else if (isVar(c->b, L.iv)) { L.cmp = swapped.at(c->op); L.bound = c->a; }
+        else throw fail("loop condition must compare the loop variable");
+
+        auto constant = [](Expr* e) -> std::optional<int64_t> {
+            if (auto* n = nodeAs<NumberExpr>(e)) return n->v;
+            return std::nullopt;
+        };
+        if (auto* u = nodeAs<UnaryExpr>(fs->inc); u && isVar(u->e, L.iv)) {
+            if (u->op == UnOp::PreInc || u->op == UnOp::PostInc) L.step = 1;
+            if (u->op == UnOp::PreDec || u->op == UnOp::PostDec) L.step = -1;
+        } else if (auto* a = nodeAs<AssignExpr>(fs->inc); a && isVar(a->lhs, L.iv)) {
+            if (a->compound && (a->op == BinOp::Add || a->op == BinOp::Sub)) {
+                if (auto k = constant(a->rhs)) L.step = a->op == BinOp::Add ? *k : -*k;
+            } else if (auto* b = nodeAs<BinExpr>(a->rhs); !a->compound && b) {
+                if (b->op == BinOp::Add && isVar(b->a, L.iv)) { if (auto k = constant(b->b)) L.step = *k; }
+                else if (b->op == BinOp::Add && isVar(b->b, L.iv)) { if (auto k = constant(b->a)) L.step = *k; }
+                else if (b->op == BinOp::Sub && isVar(b->a, L.iv)) { if (auto k = constant(b->b)) L.step = -*k; }
+            }
+        }
+        if (!L.step) throw fail("loop increment must add a nonzero constant to the loop variable");
+        bool up = L.cmp == BinOp::LT || L.cmp == BinOp::LE;
+        bool down = L.cmp == BinOp::GT || L.cmp == BinOp::GE;
+        if ((up && L.step < 0) || (down && L.step > 0) || (L.cmp == BinOp::NE && L.step != 1 && L.step != -1))
+            throw fail("loop condition and increment don't bound the iteration count");
+        return L;
+    }
+
+    // Trip count of the canonical loop as i64 (0 if it doesn't run), from
+    // start and bound already converted to the comparison type CT.
+    Value* tripCount(const CanonicalLoop &L, Value* S, Value* E, const CType &CT) {
+        bool sgn = CT.isSigned();
+        Type* I64 = B.getInt64Ty();
+        S = B.CreateIntCast(S, I64, sgn);
+        E = B.CreateIntCast(E, I64, sgn);
+        bool up = L.step > 0;
+        uint64_t step = up ? L.step : -L.step;
+        Value* Lo = up ? S : E;
+        Value* Hi = up ? E : S;
+        bool incl = L.cmp == BinOp::LE || L.cmp == BinOp::GE;
+        Value* Runs = incl ? (sgn ? B.CreateICmpSLE(Lo, Hi) : B.CreateICmpULE(Lo, Hi))
+                           : (sgn ? B.CreateICmpSLT(Lo, Hi) : B.CreateICmpULT(Lo, Hi));
+        Value* Dist = B.CreateSub(Hi, Lo);
+        Value* N = incl ? B.CreateAdd(B.CreateUDiv(Dist, B.getInt64(step)), B.getInt64(1))
+                        : B.CreateUDiv(B.CreateAdd(Dist, B.getInt64(step - 1)), B.getInt64(step));
+        return B.CreateSelect(Runs, N, B.getInt64(0), "par.trips");
+    }
+
+    // Identity of a reduction operator in type T.
+    Constant* reductionIdentity(Reduction::Op op, const CType &T) {
+        Type* Ty = llvmType(T);
+        if (T.isFloating()) {
+            const fltSemantics &Sem = Ty->getFltSemantics();
+            switch (op) {
+                case Reduction::Op::Add: return ConstantFP::get(Ty, -0.0);
+                case Reduction::Op::Mul: return ConstantFP::get(Ty, 1.0);
+                case Reduction::Op::Min: return ConstantFP::get(Ty->getContext(), APFloat::getInf(Sem));
+                case Reduction::Op::Max: return ConstantFP::get(Ty->getContext(), APFloat::getInf(Sem, /*Negative=*/true));
+                default: throw std::runtime_error("#pragma parallel: bitwise reduction of a floating-point variable");
+            }
+        }
+        unsigned bits = Ty->getIntegerBitWidth();
+        switch (op) {
+            case Reduction::Op::Add: case Reduction::Op::Or: case Reduction::Op::Xor:
+                return ConstantInt::get(Ty, 0);
+            case Reduction::Op::Mul: return ConstantInt::get(Ty, 1);
+            case Reduction::Op::And: return Constant::getAllOnesValue(Ty);
+            case Reduction::Op::Min:
+                return ConstantInt::get(Ty->getContext(), T.isSigned() ? APInt::getSignedMaxValue(bits) : APInt::getMaxValue(bits));
+            case Reduction::Op::Max:
+                return ConstantInt::get(Ty->getContext(), T.isSigned() ? APInt::getSignedMinValue(bits) : APInt::getMinValue(bits));
+        }
+        llvm_unreachable("bad reduction operator");
+    }
+
+    // a <op> b for two values of reduction type T.
+    Value* combineValues(Reduction::Op op, const CType &T, Value* A, Value* Bv) {
+        bool fp = T.isFloating();
+        switch (op) {
+            case Reduction::Op::Add: return fp ? B.CreateFAdd(A, Bv) : B.CreateAdd(A, Bv);
+            case Reduction::Op::Mul: return fp ? B.CreateFMul(A, Bv) : B.CreateMul(A, Bv);
+            case Reduction::Op::And: return B.CreateAnd(A, Bv);
+            case Reduction::Op::Or:  return B.CreateOr(A, Bv);
+            case Reduction::Op::Xor: return B.CreateXor(A, Bv);
+            case Reduction::Op::Min: case Reduction::Op::Max: {
+                bool mn = op == Reduction::Op::Min;
+                Value* Lt = fp ? B.CreateFCmpOLT(Bv, A)
+                               : T.isSigned() ? B.CreateICmpSLT(Bv, A) : B.CreateICmpULT(Bv, A);
+                Value* Gt = fp ? B.CreateFCmpOGT(Bv, A)
+                               : T.isSigned() ? B.CreateICmpSGT(Bv, A) : B.CreateICmpUGT(Bv, A);
+                return B.CreateSelect(mn ? Lt : Gt, Bv, A);
+            }
+        }
+        llvm_unreachable("bad reduction operator");
+    }
+
+    // internal void combine(ptr into, ptr from): *into = *into <op> *from
+    // field by field.
+    Function* emitCombine(const Twine &Name, StructType* RedTy, const std::vector<std::pair<Reduction::Op, CType>> &Reds) {
+        PointerType* Ptr = PointerType::getUnqual(RedTy);
+        Function* Fn = Function::Create(FunctionType::get(B.getVoidTy(), {Ptr, Ptr}, false),
+                                        Function::InternalLinkage, Name, &M);
+        Fn->addFnAttr(Attribute::NoUnwind);
+        IRBuilderBase::InsertPointGuard Guard(B);
+        B.SetInsertPoint(BasicBlock::Create(M.getContext(), "entry", Fn));
+        Value* Into = Fn->getArg(0);
+        Value* From = Fn->getArg(1);
+        for (unsigned f = 0; f < Reds.size(); ++f) {
+            Type* Ty = RedTy->getElementType(f);
+            Value* PI = B.CreateStructGEP(RedTy, Into, f);
+            Value* A = B.CreateLoad(Ty, PI);
+            Value* Bv = B.CreateLoad(Ty, B.CreateStructGEP(RedTy, From, f));
+            B.CreateStore(combineValues(Reds[f].first, Reds[f].second, A, Bv), PI);
+        }
+        B.CreateRetVoid();
+        return Fn;
+    }
+
+    void emitParallelFor(const ForStmt* fs) {
+        const ParallelLoop &P = *fs->parallel;
+        CanonicalLoop L = canonicalLoop(fs);
+        LLVMContext &C = M.getContext();
+        Type* I64 = B.getInt64Ty();
+
+        // start, then the bound (evaluated once), in the comparison type
+        CType IVT = L.decl ? L.decl->type : varTypes[lookupVar(L.iv)];
+        if (!IVT.isInteger()) throw std::runtime_error("#pragma parallel: loop variable must be an integer");
+        RValue S = convert(visit(L.start), IVT);
+        RValue E = visit(L.bound);
+        CType CT = usualArith(IVT, E.T);
+        if (!CT.isInteger()) throw std::runtime_error("#pragma parallel: loop bound must be an integer");
+        Value* N = tripCount(L, convert(S, CT).V, convert(E, CT).V, CT);
+        Value* Start = B.CreateIntCast(S.V, I64, IVT.isSigned());
+
+        // captures: every variable in scope (the IV's own value is not needed)
+        std::string ivKey = L.decl ? "" : lookupVar(L.iv);
+        std::vector<std::pair<std::string, std::string>> captures; // C name, key
+        std::vector<Type*> envFields;
+        for (auto &NK : scope) {
+            if (NK.second == ivKey) continue;
+            captures.push_back(NK);
+            envFields.push_back(llvmType(varTypes[NK.second]));
+        }
+        envFields.push_back(I64);
+        StructType* EnvTy = StructType::create(C, envFields, "par.env");
+
+        std::vector<std::string> redKeys;
+        std::vector<std::pair<Reduction::Op, CType>> reds;
+        std::vector<Type*> redFields;
+        std::vector<Constant*> identities;
+        for (const Reduction* R : P.reductions) {
+            const std::string &key = lookupVar(R->var);
+            if (key == ivKey) throw std::runtime_error("#pragma parallel: the loop variable can't be reduced");
+            CType T = varTypes[key];
+            if (T.isPointer()) throw std::runtime_error("#pragma parallel: reduction of pointer " + std::string(R->var));
+            redKeys.push_back(key);
+            reds.push_back({R->op, T});
+            redFields.push_back(llvmType(T));
+            identities.push_back(reductionIdentity(R->op, T));
+        }
+
+        // env and red live in the caller's frame for the duration of the call
+        AllocaInst *Env, *Red = nullptr;
+        StructType* RedTy = nullptr;
+        {
+            IRBuilderBase::InsertPointGuard Guard(B);
+            BasicBlock &Entry = currentFunction->getEntryBlock();
+            B.SetInsertPoint(&Entry, Entry.getFirstInsertionPt());
+            Env = B.CreateAlloca(EnvTy, nullptr, "par.env");
+            if (!reds.empty()) {
+                RedTy = StructType::create(C, redFields, "par.red");
+                Red = B.CreateAlloca(RedTy, nullptr, "par.red");
+            }
+        }
+        BasicBlock* BB = B.GetInsertBlock();
+        for (unsigned f = 0; f < captures.size(); ++f)
+            B.CreateStore(readVariable(captures[f].second, BB), B.CreateStructGEP(EnvTy, Env, f));
+        B.CreateStore(Start, B.CreateStructGEP(EnvTy, Env, captures.size()));
+        for (unsigned f = 0; f < reds.size(); ++f)
+            B.CreateStore(readVariable(redKeys[f], BB), B.CreateStructGEP(RedTy, Red, f));
+
+        Function* Parent = currentFunction;
+        PointerType* EnvPtr = PointerType::getUnqual(EnvTy);
+        Type* RedPtr = RedTy ? PointerType::getUnqual(RedTy) : (Type*)PointerType::getUnqual(B.getInt8Ty());
+        FunctionType* BodyTy = FunctionType::get(B.getVoidTy(), {EnvPtr, I64, I64, RedPtr}, false);
+        Function* Body = Function::Create(BodyTy, Function::InternalLinkage, Parent->getName() + ".par", &M);
+        Body->addFnAttr(Attribute::NoUnwind);
+
+        // --- the outlined body, with the parent's SSA state set aside ---
+        {
+            IRBuilderBase::InsertPointGuard Guard(B);
+            CType savedRet = retType;
+            auto savedScope = scope;
+            auto savedTypes = varTypes;
+            auto savedDefs = std::move(currentDef);
+            auto savedSealed = std::move(sealedBlocks);
+            auto savedIncomplete = std::move(incompletePhis);
+            bool savedBody = parallelBody;
+            currentFunction = Body;
+            BasicBlock* Entry = beginFunction(CType(TypeKind::Void));
+            scope = savedScope;
+            varTypes = savedTypes;
+            parallelBody = true;
+
+            Value* EnvArg = Body->getArg(0);
+            Value* Lo = Body->getArg(1);
+            Value* Hi = Body->getArg(2);
+            Value* RedArg = Body->getArg(3);
+            EnvArg->setName("env"); Lo->setName("lo"); Hi->setName("hi"); RedArg->setName("red");
+            std::vector<Value*> initial;
+            for (unsigned f = 0; f < captures.size(); ++f) {
+                Value* V = B.CreateLoad(envFields[f], B.CreateStructGEP(EnvTy, EnvArg, f), captures[f].first);
+                writeVariable(captures[f].second, Entry, V);
+                initial.push_back(V);
+            }
+            Value* First = B.CreateLoad(I64, B.CreateStructGEP(EnvTy, EnvArg, captures.size()), "start");
+            for (unsigned f = 0; f < reds.size(); ++f)
+                writeVariable(redKeys[f], Entry, identities[f]);
+
+            // for (k = lo, i = start + lo*step; k < hi; ++k, i += step)
+            auto loopScope = scope;
+            std::string iv = L.decl ? declareVar(L.iv, IVT) : ivKey;
+            std::string k = declareVar(".k", CType(TypeKind::Long));
+            bool nsw = IVT.isSigned();
+            Value* IV0 = B.CreateAdd(First, B.CreateMul(Lo, B.getInt64(L.step)));
+            writeVariable(iv, Entry, B.CreateTrunc(IV0, llvmType(IVT), L.iv));
+            writeVariable(k, Entry, Lo);
+            BasicBlock* CondBB  = BasicBlock::Create(C, "cond", Body);
+            BasicBlock* LoopBB  = BasicBlock::Create(C, "loop", Body);
+            BasicBlock* AfterBB = BasicBlock::Create(C, "afterloop", Body);
+            B.CreateBr(CondBB);
             B.SetInsertPoint(CondBB);
-            Value* CondV = visit(ws->cond.get());
-            B.CreateCondBr(CondV, LoopBB, AfterBB);
+            B.CreateCondBr(B.CreateICmpSLT(readVariable(k, CondBB), Hi), LoopBB, AfterBB);
+            sealBlock(LoopBB);
+            sealBlock(AfterBB);
 
             B.SetInsertPoint(LoopBB);
-            for (auto &stmt : ws->body) visit(stmt.get());
-            B.CreateBr(CondBB);
+            Value* I = readVariable(iv, LoopBB);
+            Value* K = readVariable(k, LoopBB);
+            visitScope(fs->body);
+            BasicBlock* Latch = B.GetInsertBlock();
+            if (readVariable(iv, Latch) != I)
+                throw std::runtime_error("#pragma parallel: loop variable " + std::string(L.iv) + " is assigned in the loop");
+            writeVariable(iv, Latch, B.CreateAdd(I, ConstantInt::get(I->getType(), L.step, true), L.iv, false, nsw));
+            writeVariable(k, Latch, B.CreateAdd(K, B.getInt64(1), "k", false, true));
+            setLoopHints(B.CreateBr(CondBB), fs->hints);
+            sealBlock(CondBB);
+            scope = std::move(loopScope);
 
             B.SetInsertPoint(AfterBB);
-          } else if (auto* block = dynamic_cast<BlockStmt*>(s)) {
-          for (auto &stmt : block->stmts) {
-              visit(stmt.get());
-          }
-       } else if (auto* ifs = dynamic_cast<IfStmt*>(s)) {
-            // 生成條件值
-            Value* CondV = visit(ifs->cond.get());
-            // 若不是 i1，轉成 bool：v != 0
-            if (!CondV->getType()->isIntegerTy(1)) {
-                CondV = B.CreateICmpNE(
-                    CondV,
-                    ConstantInt::get(CondV->getType(), 0),
-                    "tobool"
-                );
-            }
-
-            // 建基本區塊：then 與 end
-            BasicBlock* ThenBB = BasicBlock::Create(M.getContext(), "if.then", currentFunction);
-            BasicBlock* EndBB  = BasicBlock::Create(M.getContext(), "if.end",  currentFunction);
-
-            // 目前沒有 else，所以 false 直接跳到 EndBB
-            B.CreateCondBr(CondV, ThenBB, EndBB);
-
-            // 生成 then 區塊
-            B.SetInsertPoint(ThenBB);
-            for (auto& st : ifs->thenStmts) {
-                visit(st.get());
-            }
-            // 如果 then 區塊沒有終結（例如沒有 return/branch），補一個跳到 EndBB
-            if (!B.GetInsertBlock()->getTerminator()) {
-                B.CreateBr(EndBB);
+            for (unsigned f = 0; f < captures.size(); ++f) {
+                const std::string &key = captures[f].second;
+                if (std::find(redKeys.begin(), redKeys.end(), key) == redKeys.end() &&
+                    readVariable(key, AfterBB) != initial[f])
+                    throw std::runtime_error("#pragma parallel: " + captures[f].first +
+                                             " is assigned in the loop; reduce() it or declare it inside");
             }
+            for (unsigned f = 0; f < reds.size(); ++f) {
+                Value* PR = B.CreateStructGEP(RedTy, RedArg, f);
+                Value* Acc = B.CreateLoad(redFields[f], PR);
+                B.CreateStore(combineValues(reds[f].first, reds[f].second, Acc, readVariable(redKeys[f], AfterBB)), PR);
+            }
+            B.CreateRetVoid();
+            verifyFunction(*Body);
+
+            currentFunction = Parent;
+            retType = savedRet;
+            scope = std::move(savedScope);
+            varTypes = std::move(savedTypes);
+            currentDef = std::move(savedDefs);
+            sealedBlocks = std::move(savedSealed);
+            incompletePhis = std::move(savedIncomplete);
+            parallelBody = savedBody;
+        }
 
-            // 繼續在 end 區塊插入
-            B.SetInsertPoint(EndBB);
+        // __vlc_parallel_for(n, dynamic, chunk, body, env, red, red_init, red_size, combine)
+        Type* VoidPtr = PointerType::getUnqual(B.getInt8Ty());
+        FunctionCallee Run = M.getOrInsertFunction(
+            "__vlc_parallel_for", B.getVoidTy(), I64, B.getInt32Ty(), I64, VoidPtr, VoidPtr, VoidPtr,
+            VoidPtr, I64, VoidPtr);
+        Value *RedV = Constant::getNullValue(VoidPtr), *Init = RedV, *Size = B.getInt64(0), *Comb = RedV;
+        if (RedTy) {
+            auto* Ident = new GlobalVariable(M, RedTy, /*isConstant=*/true, GlobalValue::PrivateLinkage,
+                                             ConstantStruct::get(RedTy, identities), Parent->getName() + ".par.identity");
+            Ident->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+            RedV = B.CreatePointerCast(Red, VoidPtr);
+            Init = B.CreatePointerCast(Ident, VoidPtr);
+            Size = B.getInt64(M.getDataLayout().getTypeAllocSize(RedTy));
+            Comb = B.CreatePointerCast(emitCombine(Body->getName() + ".combine", RedTy, reds), VoidPtr);
+        }
+        B.CreateCall(Run, {N, B.getInt32(P.dynamic), B.getInt64(P.chunk), B.CreatePointerCast(Body, VoidPtr),
+                           B.CreatePointerCast(Env, VoidPtr), RedV, Init, Size, Comb});
+
+        // reduction results, and an outer IV's value after the loop
+        BB = B.GetInsertBlock();
+        for (unsigned f = 0; f < reds.size(); ++f)
+            writeVariable(redKeys[f], BB, B.CreateLoad(redFields[f], B.CreateStructGEP(RedTy, Red, f), displayName(redKeys[f])));
+        if (!L.decl) {
+            Value* Last = B.CreateAdd(Start, B.CreateMul(N, B.getInt64(L.step)));
+            writeVariable(ivKey, BB, B.CreateTrunc(Last, llvmType(IVT), L.iv));
+        }
+    }
+
+    // --- Loop metadata ---
+    // Loop pragmas become !llvm.loop on the latch (back-edge) branch, in the
+    // form clang emits for the equivalent #pragma clang loop.
+    void setLoopHints(BranchInst *Latch, const LoopHints &H) {
+        if (H.empty()) return;
+        LLVMContext &C = M.getContext();
+        auto flag = [&](const char *name) -> Metadata* {
+            return MDNode::get(C, MDString::get(C, name));
+        };
+        auto value = [&](const char *name, Constant *V) -> Metadata* {
+            return MDNode::get(C, {MDString::get(C, name), ConstantAsMetadata::get(V)});
+        };
+        auto i32 = [&](unsigned n) { return ConstantInt::get(Type::getInt32Ty(C), n); };
+
+        SmallVector<Metadata*, 8> Ops;
+        Ops.push_back(nullptr); // self reference
+        // width(1) alone means "don't vectorize"; anything else turns it on
+        if (H.width == 1 && !H.predicate) {
+            Ops.push_back(value("llvm.loop.vectorize.width", i32(1)));
+        } else if (H.width || H.predicate) {
+            if (H.width) Ops.push_back(value("llvm.loop.vectorize.width", i32(H.width)));
+            if (H.predicate)
+                Ops.push_back(value("llvm.loop.vectorize.predicate.enable", ConstantInt::getTrue(C)));
+            Ops.push_back(value("llvm.loop.vectorize.enable", ConstantInt::getTrue(C)));
+        }
+        if (H.interleave) Ops.push_back(value("llvm.loop.interleave.count", i32(H.interleave)));
+        if (H.noUnroll) Ops.push_back(flag("llvm.loop.unroll.disable"));
+        else if (H.unroll) Ops.push_back(value("llvm.loop.unroll.count", i32(H.unroll)));
+        else if (H.fullUnroll) Ops.push_back(flag("llvm.loop.unroll.full"));
+
+        MDNode *Loop = MDNode::getDistinct(C, Ops);
+        Loop->replaceOperandWith(0, Loop);
+        Latch->setMetadata(LLVMContext::MD_loop, Loop);
+    }
+
+    // --- Function declarations ---
+    // Declare F (or check it against an earlier declaration) so calls can
+    // be lowered before the callee's body is seen.
+    Function* declare(const FuncAST &F) {
+        std::vector<CType> PT;
+        for (auto &p : F.params) PT.push_back(p.first);
+
+        auto it = functions.find(F.name);
+        if (it != functions.end()) {
+            if (it->second.ret != F.ret || it->second.params != PT)
+                throw std::runtime_error("conflicting types for " + F.name);
         } else {
-           throw std::runtime_error("unknown statement type in codegen");
-       }
-   }
+            std::vector<Type*> ParamTypes;
+            for (auto &T : PT) ParamTypes.push_back(llvmType(T));
+            FunctionType *FT = FunctionType::get(llvmType(F.ret), ParamTypes, false);
+            Function* Fn = Function::Create(FT, Function::ExternalLinkage, F.name, &M);
+            it = functions.emplace(F.name, FuncSig{F.ret, PT, Fn}).first;
+        }
+        // static on any declaration makes the function internal
+        Function* Fn = it->second.F;
+        if (F.isStatic) Fn->setLinkage(Function::InternalLinkage);
+        if (F.isInline) Fn->addFnAttr(Attribute::InlineHint);
+        // C has no exceptions
+        Fn->addFnAttr(Attribute::NoUnwind);
 
-    // --- Function visitor ---
-    void visit(const FuncAST &F) {
-        // 依 F.params 型別建立參數 LLVM 型別
-        auto *i32 = Type::getInt32Ty(M.getContext());
-        auto *pi32 = PointerType::getUnqual(i32);
-        std::vector<Type*> ParamTypes;
-        ParamTypes.reserve(F.params.size());
-        for (auto &p : F.params) {
-            // p.first 是型別字串: "int", "int*", "int**"（此處只需分辨是否含 '*'）
-            if (p.first.find('*') != std::string::npos) ParamTypes.push_back(pi32);
-            else ParamTypes.push_back(i32);
-        }
-
-        FunctionType *FT =
-            FunctionType::get(i32, ParamTypes, false);
-        currentFunction =
-            Function::Create(FT, Function::ExternalLinkage, F.name, &M);
-
-        // 設定參數名稱並加入符號表
-        unsigned i = 0;
-        for (auto &Arg : currentFunction->args()) {
-            Arg.setName(F.params[i].second);
-            namedValues[F.params[i].second] = &Arg;
-            ++i;
+        // parameter qualifiers accumulate over all declarations
+        for (unsigned i = 0; i < F.paramQuals.size(); ++i) {
+            const ParamQuals &Q = F.paramQuals[i];
+            if (Q.isRestrict) Fn->addParamAttr(i, Attribute::NoAlias);
+            if (Q.align)
+                Fn->addParamAttrs(i, AttrBuilder(M.getContext()).addAlignmentAttr(Align(Q.align)));
         }
+        return Fn;
+    }
 
+    // --- Function visitor ---
+    // Entry block of currentFunction, with fresh per-function state.
+    BasicBlock* beginFunction(CType ret) {
+        retType = ret;
         BasicBlock *entry =
             BasicBlock::Create(M.getContext(), "entry", currentFunction);
         B.SetInsertPoint(entry);
 
         // 重要：清除並重新填充符號表
-        namedValues.clear();
+        scope.clear();
+        varTypes.clear();
+        currentDef.clear();
+        sealedBlocks.clear();
+        incompletePhis.clear();
+        sealBlock(entry);
+        return entry;
+    }
+
+    void visit(const FuncAST &F) {
+        currentFunction = declare(F);
+        if (!currentFunction->empty())
+            throw std::runtime_error("redefinition of " + F.name);
+        BasicBlock *entry = beginFunction(F.ret);
 
-        // 設定參數名稱並加入符號表
-        i = 0;
+        // 參數直接作為 SSA 變數的初值（可被賦值）
+        unsigned i = 0;
         for (auto &Arg : currentFunction->args()) {
-            Arg.setName(F.params[i].second);
-            namedValues[std::string(Arg.getName())] = &Arg;
-            ++i;
+            const auto &P = F.params[i++];
+            Arg.setName(P.second);
+            writeVariable(declareVar(P.second, P.first), entry, &Arg);
         }
 
-        for (auto& stmt : F.body) {
-            visit(stmt.get());
-        }
+        for (Stmt* stmt : F.body) visit(stmt);
 
         if (!B.GetInsertBlock()->getTerminator()) {
-            B.CreateRet(ConstantInt::get(Type::getInt32Ty(M.getContext()), 0));
+            if (retType.isVoid()) B.CreateRetVoid();
+            else B.CreateRet(Constant::getNullValue(llvmType(retType)));
         }
 
         verifyFunction(*currentFunction);
     }
+
+    // --- SIMD variants (x86 vector function ABI) ---
+    // ISA letter, vector register bits for integer and floating-point
+    // characteristic types, and the target features the variant needs.
+    struct SimdISA {
+        char letter;
+        unsigned intBits, fpBits;
+        const char* features;
+    };
+
+    static const std::vector<SimdISA> &simdISAs() {
+        static const std::vector<SimdISA> ISAs = {
+            {'b', 128, 128, "+sse2"}, {'c', 128, 256, "+avx"},
+            {'d', 256, 256, "+avx2"}, {'e', 512, 512, "+avx512f"}};
+        return ISAs;
+    }
+
+    // The characteristic data type sets the lane count: the return type,
+    // else the first vector parameter's, else int.
+    static CType characteristicType(const FuncAST &F, const SimdDecl &D) {
+        if (!F.ret.isVoid()) return F.ret;
+        for (size_t i = 0; i < F.params.size(); ++i)
+            if (D.params[i] == SimdDecl::Param::Vector) return F.params[i].first;
+        return CType(TypeKind::Int);
+    }
+
+    // _ZGV <isa> <N|M> <lanes> <v|u|l[step]>... _ <name>; a linear
+    // pointer's step is in bytes.
+    std::string simdVariantName(const FuncAST &F, const SimdDecl &D, char isa, bool masked,
+                                unsigned VL) {
+        std::string N = "_ZGV";
+        N += isa;
+        N += masked ? 'M' : 'N';
+        N += std::to_string(VL);
+        for (size_t i = 0; i < F.params.size(); ++i) {
+            switch (D.params[i]) {
+                case SimdDecl::Param::Vector:  N += 'v'; break;
+                case SimdDecl::Param::Uniform: N += 'u'; break;
+                case SimdDecl::Param::Linear: {
+                    int64_t step = D.linearStep[i];
+                    const CType &T = F.params[i].first;
+                    if (T.isPointer())
+                        step *= T.pointee().isVoid() ? 1 : (int64_t)M.getDataLayout().getTypeAllocSize(llvmType(T.pointee()));
+                    N += 'l';
+                    if (step < 0) N += "n" + std::to_string(-step);
+                    else if (step != 1) N += std::to_string(step);
+                    break;
+                }
+            }
+        }
+        return N + "_" + F.name;
+    }
+
+    // One vector variant of F: vector parameters and result have VL lanes,
+    // uniform and linear ones are scalars. A masked variant takes the
+    // mask last: a vector of the characteristic type (nonzero = active),
+    // or for AVX-512 an integer with one bit per lane. For a prototype
+    // only the declaration is emitted; the definition is elsewhere.
+    Function* emitSimdVariant(const FuncAST &F, const SimdDecl &D, const SimdISA &I, bool masked) {
+        CType CDT = characteristicType(F, D);
+        unsigned cdtBits = CDT.bits();
+        unsigned VL = D.simdlen ? D.simdlen : (CDT.isFloating() ? I.fpBits : I.intBits) / cdtBits;
+        std::string Name = simdVariantName(F, D, I.letter, masked, VL);
+        if (Function* Old = M.getFunction(Name))
+            if (!Old->isDeclaration()) return Old; // same pragma on a prototype and the definition
+
+        auto vec = [&](Type* T) -> Type* { return FixedVectorType::get(T, VL); };
+        std::vector<Type*> PT;
+        for (size_t i = 0; i < F.params.size(); ++i) {
+            Type* T = llvmType(F.params[i].first);
+            PT.push_back(D.params[i] == SimdDecl::Param::Vector ? vec(T) : T);
+        }
+        Type* MaskTy = nullptr;
+        if (masked) {
+            if (I.letter == 'e') {
+                if (VL > (cdtBits == 8 ? 64u : 32u))
+                    throw std::runtime_error("declare simd: simdlen too large for a masked AVX-512 variant of " + F.name);
+                MaskTy = cdtBits == 8 ? B.getInt64Ty() : B.getInt32Ty();
+            } else {
+                MaskTy = vec(CDT.isPointer() ? (Type*)B.getInt64Ty() : llvmType(CDT));
+            }
+            PT.push_back(MaskTy);
+        }
+        Type* RetTy = F.ret.isVoid() ? B.getVoidTy() : vec(llvmType(F.ret));
+        Function* Fn = Function::Create(FunctionType::get(RetTy, PT, false),
+                                        F.isStatic ? Function::InternalLinkage : Function::ExternalLinkage,
+                                        Name, &M);
+        Fn->addFnAttr(Attribute::NoUnwind);
+        // merged with the TargetMachine's features by setTargetAttributes
+        Fn->addFnAttr("target-features", I.features);
+        unsigned widest = 0;
+        for (Type* T : PT) if (T->isVectorTy()) widest = std::max<unsigned>(widest, M.getDataLayout().getTypeSizeInBits(T));
+        if (RetTy->isVectorTy()) widest = std::max<unsigned>(widest, M.getDataLayout().getTypeSizeInBits(RetTy));
+        Fn->addFnAttr("min-legal-vector-width", std::to_string(widest));
+        if (!F.isDefinition) return Fn;
+
+        currentFunction = Fn;
+        BasicBlock* entry = beginFunction(F.ret);
+        lanes = VL;
+        CType Bool(TypeKind::Bool);
+        maskKey = declareVar(".mask", Bool);
+        doneKey = declareVar(".done", Bool);
+        retKey = F.ret.isVoid() ? "" : declareVar(".ret", F.ret);
+        writeVariable(doneKey, entry, Constant::getNullValue(valueType(Bool)));
+
+        auto AI = Fn->arg_begin();
+        for (size_t i = 0; i < F.params.size(); ++i, ++AI) {
+            const CType &T = F.params[i].first;
+            AI->setName(F.params[i].second);
+            Value* V = AI;
+            if (D.params[i] == SimdDecl::Param::Uniform) {
+                V = B.CreateVectorSplat(VL, AI);
+            } else if (D.params[i] == SimdDecl::Param::Linear) {
+                // lane l gets arg + l * step (in elements for a pointer)
+                SmallVector<Constant*, 16> Offs;
+                Type* OffTy = T.isPointer() ? B.getInt64Ty() : llvmType(T);
+                for (unsigned l = 0; l < VL; ++l)
+                    Offs.push_back(ConstantInt::get(OffTy, l * D.linearStep[i], /*isSigned=*/true));
+                Value* Steps = ConstantVector::get(Offs);
+                if (T.isPointer()) {
+                    Type* ET = T.pointee().isVoid() ? B.getInt8Ty() : llvmType(T.pointee());
+                    V = B.CreateInBoundsGEP(ET, AI, Steps, F.params[i].second);
+                } else {
+                    V = B.CreateAdd(B.CreateVectorSplat(VL, AI), Steps, F.params[i].second);
+                }
+            }
+            writeVariable(declareVar(F.params[i].second, T), entry, V);
+        }
+        Value* Active = Constant::getAllOnesValue(valueType(Bool));
+        if (masked) {
+            Value* MA = AI;
+            MA->setName("mask");
+            if (I.letter == 'e')
+                Active = B.CreateBitCast(B.CreateTrunc(MA, B.getIntNTy(VL)), valueType(Bool));
+            else if (CDT.isFloating())
+                Active = B.CreateFCmpUNE(MA, Constant::getNullValue(MaskTy));
+            else
+                Active = B.CreateICmpNE(MA, Constant::getNullValue(MaskTy));
+        }
+        writeVariable(maskKey, entry, Active);
+
+        for (Stmt* stmt : F.body) visit(stmt);
+
+        if (F.ret.isVoid()) B.CreateRetVoid();
+        else B.CreateRet(readVariable(retKey, B.GetInsertBlock()));
+        lanes = 0;
+        verifyFunction(*Fn);
+        return Fn;
+    }
+
+    // Every variant the declare simd pragmas of F (on any of its
+    // declarations) ask for. The unmasked ones are also listed in the
+    // vector-function-abi-variant attribute of F and of the calls to it,
+    // for LLVM's loop vectorizer.
+    void emitSimdVariants(const FuncAST &F, const std::vector<const SimdDecl*> &Decls) {
+        Function* Scalar = functions.at(F.name).F;
+        std::string Mappings;
+        for (const SimdDecl* D : Decls)
+            for (const SimdISA &I : simdISAs())
+                for (bool masked : {false, true}) {
+                    if (!(masked ? D->masked : D->unmasked)) continue;
+                    Function* V = emitSimdVariant(F, *D, I, masked);
+                    if (F.isStatic || !F.isDefinition) appendToCompilerUsed(M, {V}); // kept for the vectorizer
+                    if (!masked && Mappings.find(V->getName().str() + "(") == std::string::npos)
+                        Mappings += (Mappings.empty() ? "" : ",") + V->getName().str() + "(" + V->getName().str() + ")";
+                }
+        if (Mappings.empty()) return;
+        Scalar->addFnAttr("vector-function-abi-variant", Mappings);
+        for (User* U : Scalar->users())
+            if (auto* CI = dyn_cast<CallInst>(U))
+                if (CI->getCalledFunction() == Scalar)
+                    CI->addFnAttr(Attribute::get(CI->getContext(), "vector-function-abi-variant", Mappings));
+    }
+
+    // --- Specialization ---
+    // The body of F moves to F.generic, each combination of specialized
+    // values gets a clone with those parameters folded to constants
+    // (F.n16, F.n16.m8, ...), and F itself becomes the dispatcher: compare,
+    // call the matching clone, else the generic body. Clones and generic
+    // are always inlined into F, so every --multiversion clone of F carries
+    // all of them.
+    void emitSpecializations(const FuncAST &F, const std::map<size_t, std::vector<int64_t>> &Specs) {
+        std::vector<std::vector<std::pair<size_t, int64_t>>> combos{{}};
+        for (auto &PV : Specs) {
+            std::vector<std::vector<std::pair<size_t, int64_t>>> next;
+            for (auto &c : combos)
+                for (int64_t v : PV.second) {
+                    next.push_back(c);
+                    next.back().push_back({PV.first, v});
+                }
+            combos = std::move(next);
+        }
+        if (combos.size() > 64)
+            throw std::runtime_error("specialize: " + std::to_string(combos.size()) + " clones of " + F.name + " (at most 64)");
+
+        Function* Fn = functions.at(F.name).F;
+        GlobalValue::LinkageTypes Linkage = Fn->getLinkage();
+        Function* G = Function::Create(Fn->getFunctionType(), Function::InternalLinkage, F.name + ".generic", &M);
+        ValueToValueMapTy VMap;
+        auto GA = G->arg_begin();
+        for (Argument &A : Fn->args()) {
+            GA->setName(A.getName());
+            VMap[&A] = &*GA++;
+        }
+        SmallVector<ReturnInst*, 4> Returns;
+        CloneFunctionInto(G, Fn, VMap, CloneFunctionChangeType::LocalChangesOnly, Returns);
+        G->setLinkage(Function::InternalLinkage);
+        G->removeFnAttr("vector-function-abi-variant"); // the name's, not the body's
+        G->removeFnAttr(Attribute::InlineHint);
+        G->addFnAttr(Attribute::AlwaysInline);
+
+        std::vector<Function*> Clones;
+        for (auto &c : combos) {
+            ValueToValueMapTy CMap;
+            std::string Suffix;
+            for (auto &PV : c) {
+                Argument* A = G->getArg(PV.first);
+                CMap[A] = ConstantInt::get(A->getType(), PV.second, F.params[PV.first].first.isSigned());
+                Suffix += "." + F.params[PV.first].second + std::to_string(PV.second);
+            }
+            Function* C = CloneFunction(G, CMap); // the fixed parameters are dropped
+            C->setName(F.name + Suffix);
+            Clones.push_back(C);
+        }
+
+        Fn->deleteBody();
+        Fn->setLinkage(Linkage);
+        IRBuilderBase::InsertPointGuard Guard(B);
+        B.SetInsertPoint(BasicBlock::Create(M.getContext(), "entry", Fn));
+        auto tailCall = [&](Function* Callee, ArrayRef<Value*> Args) {
+            CallInst* CI = B.CreateCall(Callee, Args);
+            CI->setTailCall();
+            if (CI->getType()->isVoidTy()) B.CreateRetVoid();
+            else B.CreateRet(CI);
+        };
+        for (size_t k = 0; k < combos.size(); ++k) {
+            Value* Match = nullptr;
+            std::vector<Value*> Args;
+            for (Argument &A : Fn->args()) {
+                auto fixed = std::find_if(combos[k].begin(), combos[k].end(),
+                                          [&](auto &PV) { return PV.first == A.getArgNo(); });
+                if (fixed == combos[k].end()) { Args.push_back(&A); continue; }
+                Value* Eq = B.CreateICmpEQ(&A, ConstantInt::get(A.getType(), fixed->second,
+                                                                   F.params[A.getArgNo()].first.isSigned()));
+                Match = Match ? B.CreateAnd(Match, Eq) : Eq;
+            }
+            BasicBlock* Call = BasicBlock::Create(M.getContext(), Clones[k]->getName(), Fn);
+            BasicBlock* Next = BasicBlock::Create(M.getContext(), "spec.next", Fn);
+            B.CreateCondBr(Match, Call, Next);
+            B.SetInsertPoint(Call);
+            tailCall(Clones[k], Args);
+            B.SetInsertPoint(Next);
+        }
+        std::vector<Value*> All;
+        for (Argument &A : Fn->args()) All.push_back(&A);
+        tailCall(G, All);
+        verifyFunction(*Fn);
+    }
+
+    // --- Function attributes ---
+    // Memory effects of Fn's body if every access goes through a pointer
+    // argument: 0 = none, 1 = reads, 2 = reads and writes; -1 otherwise.
+    static int argMemEffects(Function &Fn) {
+        auto fromArgs = [](const Value *Ptr) {
+            SmallVector<const Value*, 4> Objs;
+            getUnderlyingObjects(Ptr, Objs, nullptr, /*MaxLookup=*/0);
+            for (const Value *O : Objs)
+                if (!isa<Argument>(O)) return false;
+            return true;
+        };
+        int effects = 0;
+        for (Instruction &I : instructions(Fn)) {
+            if (auto *LI = dyn_cast<LoadInst>(&I)) {
+                if (!fromArgs(LI->getPointerOperand())) return -1;
+                effects = std::max(effects, 1);
+            } else if (auto *SI = dyn_cast<StoreInst>(&I)) {
+                if (!fromArgs(SI->getPointerOperand())) return -1;
+                effects = 2;
+            } else if (auto *CI = dyn_cast<CallInst>(&I)) {
+                Function *G = CI->getCalledFunction();
+                if (!G) return -1;
+                if (G->doesNotAccessMemory()) continue;
+                if (!G->onlyAccessesArgMemory()) return -1;
+                for (Value *A : CI->args())
+                    if (A->getType()->isPointerTy() && !fromArgs(A)) return -1;
+                effects = std::max(effects, G->onlyReadsMemory() ? 1 : 2);
+            }
+        }
+        return effects;
+    }
+
+    // Nothing is stored through pointer argument A (or anything derived
+    // from it), and callees it is passed to only read through it. const in
+    // the signature proves neither: C lets the body cast it away.
+    static bool onlyReadThrough(Argument &A) {
+        SmallVector<Value*, 8> Work{&A};
+        SmallPtrSet<Value*, 8> Seen{&A};
+        while (!Work.empty()) {
+            Value *V = Work.pop_back_val();
+            for (Use &U : V->uses()) {
+                auto *I = dyn_cast<Instruction>(U.getUser());
+                if (!I) return false;
+                if (isa<LoadInst>(I) || isa<ICmpInst>(I)) continue;
+                if (auto *CI = dyn_cast<CallInst>(I)) {
+                    if (!CI->isArgOperand(&U) || !CI->onlyReadsMemory(CI->getArgOperandNo(&U)))
+                        return false;
+                    continue;
+                }
+                if (isa<GetElementPtrInst>(I) || isa<BitCastInst>(I) ||
+                    isa<PHINode>(I) || isa<SelectInst>(I)) {
+                    if (Seen.insert(I).second) Work.push_back(I);
+                    continue;
+                }
+                return false; // stores, ptrtoint, ...
+            }
+        }
+        return true;
+    }
+
+    // Every loop in Fn has a finite constant trip-count bound (nsw makes
+    // the usual counted loops qualify) and every callee returns.
+    static bool alwaysReturns(Function &Fn) {
+        for (Instruction &I : instructions(Fn))
+            if (auto *CI = dyn_cast<CallInst>(&I)) {
+                Function *G = CI->getCalledFunction();
+                if (!G || !G->willReturn()) return false;
+            }
+        DominatorTree DT(Fn);
+        LoopInfo LI(DT);
+        if (LI.empty()) return true; // structured control flow only: no other cycles
+        TargetLibraryInfoImpl TLII(Triple(Fn.getParent()->getTargetTriple()));
+        TargetLibraryInfo TLI(TLII, &Fn);
+        AssumptionCache AC(Fn);
+        ScalarEvolution SE(Fn, TLI, AC, DT, LI);
+        for (Loop *L : LI.getLoopsInPreorder())
+            if (isa<SCEVCouldNotCompute>(SE.getConstantMaxBackedgeTakenCount(L)))
+                return false;
+        return true;
+    }
+
+    // Infer memory(argmem: ...) / willreturn for the definitions and
+    // readonly nocapture for their pointer arguments, callees first: a
+    // function only qualifies once everything it calls does, so recursion
+    // never does.
+    void inferFunctionAttrs() {
+        std::set<Function*> memDone, retDone;
+        std::set<Argument*> argDone;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto &KV : functions) {
+                Function *Fn = KV.second.F;
+                if (Fn->empty()) continue;
+                if (!memDone.count(Fn)) {
+                    int effects = argMemEffects(*Fn);
+                    if (effects >= 0) {
+#if LLVM_VERSION_MAJOR >= 16
+                        Fn->setMemoryEffects(
+                            effects == 0 ? MemoryEffects::none()
+                            : MemoryEffects::argMemOnly(effects == 1 ? ModRefInfo::Ref
+                                                                     : ModRefInfo::ModRef));
+#else
+                        if (effects == 0) Fn->setDoesNotAccessMemory();
+                        else {
+                            Fn->setOnlyAccessesArgMemory();
+                            if (effects == 1) Fn->setOnlyReadsMemory();
+                        }
+#endif
+                        memDone.insert(Fn);
+                        changed = true;
+                    }
+                }
+                for (Argument &A : Fn->args()) {
+                    if (!A.getType()->isPointerTy() || argDone.count(&A)) continue;
+                    if (onlyReadThrough(A) &&
+                        !PointerMayBeCaptured(&A, /*ReturnCaptures=*/true, /*StoreCaptures=*/true)) {
+                        A.addAttr(Attribute::ReadOnly);
+                        A.addAttr(Attribute::NoCapture);
+                        argDone.insert(&A);
+                        changed = true;
+                    }
+                }
+                if (!retDone.count(Fn) && alwaysReturns(*Fn)) {
+                    Fn->addFnAttr(Attribute::WillReturn);
+                    retDone.insert(Fn);
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // --- Translation unit ---
+    void visit(const TranslationUnit &TU) {
+        // all signatures first, so definitions may call functions defined later
+        for (auto &F : TU.funcs) declare(F);
+        for (auto &F : TU.funcs)
+            if (F.isDefinition) visit(F);
+        // declare simd: variants of the definition, or else declarations
+        // after the last prototype
+        std::map<std::string, std::vector<const SimdDecl*>> simd;
+        std::map<std::string, const FuncAST*> last;
+        for (auto &F : TU.funcs) {
+            for (auto &D : F.simd) simd[F.name].push_back(&D);
+            auto &L = last[F.name];
+            if (!L || !L->isDefinition) L = &F;
+        }
+        for (auto &KV : simd) emitSimdVariants(*last.at(KV.first), KV.second);
+        inferFunctionAttrs();
+        // specialize: clones behind the definition (prototypes only carry
+        // the pragma to it)
+        std::map<std::string, std::map<size_t, std::vector<int64_t>>> spec;
+        for (auto &F : TU.funcs)
+            for (auto &S : F.specialize) {
+                auto &V = spec[F.name][S.param];
+                for (int64_t v : S.values)
+                    if (std::find(V.begin(), V.end(), v) == V.end()) V.push_back(v);
+            }
+        for (auto &KV : spec)
+            if (last.at(KV.first)->isDefinition) emitSpecializations(*last.at(KV.first), KV.second);
+    }
 };
 
 } // namespace
 
-void buildFromAST(llvm::Module &M, const FuncAST &F) {
+void buildFromAST(llvm::Module &M, const TranslationUnit &TU) {
     CodeGenVisitor visitor(M);
-    visitor.visit(F);
+    visitor.visit(TU);
+}
+
+void addSpecializations(TranslationUnit &TU, const std::vector<std::string> &Specs) {
+    for (const std::string &Spec : Specs) {
+        size_t eq = Spec.find('=');
+        if (eq == std::string::npos) throw std::runtime_error("--specialize: expected [function.]param=value, got " + Spec);
+        std::string name = Spec.substr(0, eq), func;
+        if (size_t dot = name.find('.'); dot != std::string::npos) {
+            func = name.substr(0, dot);
+            name = name.substr(dot + 1);
+        }
+        char* end = nullptr;
+        errno = 0;
+        int64_t v = std::strtoll(Spec.c_str() + eq + 1, &end, 0);
+        if (eq + 1 == Spec.size() || *end || errno == ERANGE)
+            throw std::runtime_error("--specialize: bad value in " + Spec);
+        bool found = false;
+        for (auto &F : TU.funcs) {
+            if (!F.isDefinition || (!func.empty() && F.name != func)) continue;
+            for (size_t i = 0; i < F.params.size(); ++i) {
+                if (F.params[i].second != name) continue;
+                if (!F.params[i].first.isInteger())
+                    throw std::runtime_error("--specialize: " + name + " of " + F.name + " is not an integer");
+                if (!F.params[i].first.holds(v))
+                    throw std::runtime_error("--specialize: " + Spec + " is out of range for " + name + " of " + F.name);
+                auto S = std::find_if(F.specialize.begin(), F.specialize.end(),
+                                      [&](const Specialization &S) { return S.param == i; });
+                if (S == F.specialize.end()) F.specialize.push_back({i, {v}});
+                else S->values.push_back(v);
+                found = true;
+            }
+        }
+        if (!found) throw std::runtime_error("--specialize: no function definition has a parameter " + Spec.substr(0, eq));
+    }
+}
+
+static std::string cTypeName(const CType &T, bool constPointee = false) {
+    static const char* names[] = {"void", "_Bool", "char", "short", "int", "long", "float", "double"};
+    std::string s = constPointee ? "const " : "";
+    if (T.isUnsigned) s += "unsigned ";
+    s += names[(int)T.kind];
+    if (T.ptr) s += " " + std::string(T.ptr, '*');
+    return s;
+}
+
+std::string declareSimdHeader(const TranslationUnit &TU, const std::string &source) {
+    std::string H = "/* Generated by veclangc from " + source + ". Vector variants follow the x86\n"
+                    "   vector function ABI; compile callers with -fopenmp-simd. */\n#pragma once\n";
+    std::set<std::string> done;
+    for (auto &F : TU.funcs) {
+        if (F.simd.empty() || F.isStatic || !done.insert(F.name).second) continue;
+        H += "\n";
+        for (auto &D : F.simd) H += "#pragma omp declare simd " + D.clauses + "\n";
+        H += cTypeName(F.ret) + " " + F.name + "(";
+        for (size_t i = 0; i < F.params.size(); ++i) {
+            const CType &T = F.params[i].first;
+            bool c = i < F.paramQuals.size() && F.paramQuals[i].constPointee;
+            H += (i ? ", " : "") + cTypeName(T, c);
+            if (i < F.paramQuals.size() && F.paramQuals[i].isRestrict) H += " restrict";
+            if (!F.params[i].second.empty()) H += (T.ptr && !F.paramQuals[i].isRestrict ? "" : " ") + F.params[i].second;
+        }
+        H += F.params.empty() ? "void);\n" : ");\n";
+    }
+    return H;
 }
@@ -0,0 +1,104 @@
+#include "frontend_bench.h"
+#include "ast.h"
+#include "codegen.h"
+#include "parser.h"
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+struct Stats { double mean, min, sd; };
+
+// ms per call of `run` over the timed repetitions; `untimed` runs after
+// each call, outside the clock.
+Stats timeStage(const std::function<void()> &run, unsigned warmup, unsigned reps,
+                const std::function<void()> &untimed = [] {}) {
+    for (unsigned i = 0; i < warmup; ++i) { run(); untimed(); }
+    std::vector<double> ms;
+    for (unsigned i = 0; i < reps; ++i) {
+        auto t0 = std::chrono::steady_clock::now();
+        run();
+        auto t1 = std::chrono::steady_clock::now();
+        untimed();
+        ms.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+    }
+    Stats S{0, ms[0], 0};
+    for (double x : ms) { S.mean += x; S.min = std::min(S.min, x); }
+    S.mean /= ms.size();
+    for (double x : ms) S.sd += (x - S.mean) * (x - S.mean);
+    S.sd = ms.size() > 1 ? std::sqrt(S.sd / (ms.size() - 1)) : 0;
+    return S;
+}
+
+void report(const char *stage, const Stats &S, size_t bytes) {
+    outs() << "  " << left_justify(stage, 6) << ": "
+           << format("%9.3f ms (min %.3f, sd %.3f)  %7.1f MB/s", S.mean, S.min, S.sd,
+                     S.mean > 0 ? bytes / S.mean / 1e3 : 0.0);
+}
+
+} // namespace
+
+int runFrontendBench(std::string_view source, const TargetMachine &TM, unsigned warmup,
+                     unsigned reps) {
+    if (!reps) { errs() << "--bench-reps must be positive\n"; return 1; }
+
+    size_t tokens = 0;
+    Stats Lex = timeStage([&] {
+        Lexer L(source);
+        size_t n = 0;
+        while (L.next().kind != Tok::Eof) ++n;
+        tokens = n;
+    }, warmup, reps);
+
+    // building and freeing the AST
+    Stats Parse = timeStage([&] {
+        Parser P(source);
+        TranslationUnit TU = P.parseTranslationUnit();
+    }, warmup, reps);
+    Parser P(source);
+    TranslationUnit TU = P.parseTranslationUnit();
+
+    // AST -> IR; tearing the module down is not part of it
+    std::unique_ptr<LLVMContext> Ctx;
+    std::unique_ptr<Module> M;
+    size_t insts = 0;
+    Stats IRGen = timeStage([&] {
+        Ctx = std::make_unique<LLVMContext>();
+        M = std::make_unique<Module>("veclangc", *Ctx);
+        M->setTargetTriple(TM.getTargetTriple().str());
+        M->setDataLayout(TM.createDataLayout());
+        buildFromAST(*M, TU);
+    }, warmup, reps, [&] {
+        insts = 0;
+        for (auto &F : *M) insts += F.getInstructionCount();
+        M.reset();
+        Ctx.reset();
+    });
+
+    size_t lines = std::count(source.begin(), source.end(), '\n');
+    outs() << "frontend: " << lines << " lines, " << format("%.2f", source.size() / 1e6) << " MB, "
+           << tokens << " tokens, " << TU.funcs.size() << " functions; reps=" << reps << " (+"
+           << warmup << " warmup)\n";
+    report("lex", Lex, source.size());
+    outs() << format("  %.1f ns/token\n", Lex.mean * 1e6 / std::max<size_t>(tokens, 1));
+    report("parse", Parse, source.size());
+    outs() << "  " << TU.arena.nodes() << " nodes, "
+           << format("%.1f KiB", TU.arena.bytesUsed() / 1024.0) << " in " << TU.arena.slabs()
+           << " slabs\n";
+    report("irgen", IRGen, source.size());
+    outs() << "  " << insts << " instructions\n";
+    return 0;
+}
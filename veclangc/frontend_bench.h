@@ -0,0 +1,12 @@
+#pragma once
+#include <string_view>
+
+namespace llvm { class TargetMachine; }
+
+// --bench-frontend: time the lexer alone, lexing + parsing into the AST, and
+// IR generation from the AST (no optimization) on one preprocessed input.
+// Each stage is run `warmup` times untimed, then `reps` times timed. Prints
+// the mean, min and sd per stage and the AST arena footprint. Returns a
+// process exit code.
+int runFrontendBench(std::string_view source, const llvm::TargetMachine &TM,
+                     unsigned warmup, unsigned reps);
@@ -0,0 +1,287 @@
+#include "jit.h"
+#include "ast.h"
+#include "codegen.h"
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace llvm;
+using namespace llvm::orc;
+
+// runtime/veclangc_par_rt.c, linked into veclangc for #pragma parallel loops
+extern "C" void __vlc_parallel_for(int64_t, int32_t, int64_t, void (*)(void *, int64_t, int64_t, void *),
+                                   void *, void *, const void *, int64_t, void (*)(void *, const void *));
+
+namespace {
+
+const char *BenchEntry = "__veclangc_bench_entry";
+
+// void __veclangc_bench_entry(i8 **argv): argv[i] points at the value of
+// the kernel's i-th argument, argv[nargs] receives the result. Added after
+// O3 so the kernel is called, not inlined into the harness.
+void addBenchEntry(Module &M, Function *K) {
+    LLVMContext &C = M.getContext();
+    Type *I8P = PointerType::getUnqual(Type::getInt8Ty(C));
+    FunctionType *FT = FunctionType::get(Type::getVoidTy(C), {PointerType::getUnqual(I8P)}, false);
+    Function *W = Function::Create(FT, Function::ExternalLinkage, BenchEntry, M);
+    IRBuilder<> B(BasicBlock::Create(C, "entry", W));
+    Value *Argv = W->getArg(0);
+    auto slot = [&](unsigned i, Type *T) {
+        Value *P = B.CreateLoad(I8P, B.CreateConstGEP1_64(I8P, Argv, i));
+        return B.CreatePointerCast(P, PointerType::getUnqual(T));
+    };
+    std::vector<Value*> Args;
+    FunctionType *KT = K->getFunctionType();
+    for (unsigned i = 0; i < KT->getNumParams(); ++i)
+        Args.push_back(B.CreateLoad(KT->getParamType(i), slot(i, KT->getParamType(i))));
+    Value *R = B.CreateCall(K, Args);
+    if (!R->getType()->isVoidTy()) B.CreateStore(R, slot(KT->getNumParams(), R->getType()));
+    B.CreateRetVoid();
+}
+
+// Build, optimize and JIT one variant of the TU. `entry` stays externally
+// visible through O3; with `bench` set it also gets the argv harness.
+Expected<std::unique_ptr<LLJIT>> buildJit(const TranslationUnit &TU, TargetMachine &TM,
+                                          const JitOptions &JO, const std::string &entry,
+                                          bool bench) {
+    auto Ctx = std::make_unique<LLVMContext>();
+    auto M = std::make_unique<Module>("veclangc.jit", *Ctx);
+    M->setTargetTriple(TM.getTargetTriple().str());
+    M->setDataLayout(TM.createDataLayout());
+    buildFromAST(*M, TU);
+    Function *K = M->getFunction(entry);
+    if (!K || K->isDeclaration())
+        return createStringError(inconvertibleErrorCode(), "no definition of '%s' to run", entry.c_str());
+    K->setLinkage(Function::ExternalLinkage); // a static kernel must survive GlobalDCE
+    setTargetAttributes(*M, TM);
+    if (JO.optimize) runO3Pipeline(*M, &TM, JO.withVecOpt);
+    if (bench) addBenchEntry(*M, K);
+
+    // same CPU and features the IR was optimized for
+    JITTargetMachineBuilder JTMB(TM.getTargetTriple());
+    JTMB.setCPU(TM.getTargetCPU().str());
+    std::vector<std::string> Features;
+    for (StringRef F : split(TM.getTargetFeatureString(), ','))
+        if (!F.empty()) Features.push_back(F.str());
+    JTMB.addFeatures(Features);
+
+    auto J = LLJITBuilder().setJITTargetMachineBuilder(std::move(JTMB)).create();
+    if (!J) return J.takeError();
+    // calls to functions the TU only declares resolve against the process
+    auto Gen = DynamicLibrarySearchGenerator::GetForCurrentProcess((*J)->getDataLayout().getGlobalPrefix());
+    if (!Gen) return Gen.takeError();
+    (*J)->getMainJITDylib().addGenerator(std::move(*Gen));
+    // the parallel-loop runtime is in veclangc itself, not a shared library
+    SymbolMap Runtime;
+#if LLVM_VERSION_MAJOR >= 17
+    Runtime[(*J)->mangleAndIntern("__vlc_parallel_for")] = {ExecutorAddr::fromPtr(&__vlc_parallel_for),
+                                                            JITSymbolFlags::Exported};
+#else
+    Runtime[(*J)->mangleAndIntern("__vlc_parallel_for")] = JITEvaluatedSymbol(
+        pointerToJITTargetAddress(&__vlc_parallel_for), JITSymbolFlags::Exported);
+#endif
+    if (Error E = (*J)->getMainJITDylib().define(absoluteSymbols(std::move(Runtime))))
+        return E;
+    if (Error E = (*J)->addIRModule(ThreadSafeModule(std::move(M), std::move(Ctx))))
+        return E;
+    return J;
+}
+
+template <typename Fn>
+Expected<Fn*> lookupFn(LLJIT &J, StringRef Name) {
+    auto Sym = J.lookup(Name);
+    if (!Sym) return Sym.takeError();
+#if LLVM_VERSION_MAJOR >= 15
+    return Sym->toPtr<Fn*>();
+#else
+    return reinterpret_cast<Fn*>(static_cast<uintptr_t>(Sym->getAddress()));
+#endif
+}
+
+// --- Synthetic inputs ---
+struct Arg {
+    CType type;
+    std::vector<uint64_t> slot = std::vector<uint64_t>(1); // the argument's value
+    void *buf = nullptr;                                    // pointee array (pointers only)
+    size_t elemBytes = 0;
+    std::vector<char> init;                                 // buf's generated contents
+};
+
+size_t bytesOf(CType T) {
+    unsigned b = T.bits();
+    return b <= 8 ? 1 : b / 8; // void / bool arrays are byte arrays
+}
+
+// Fill n elements of type T at buf with values from [0, range) laid out per
+// dist; random vs sorted keeps the values but changes branch predictability.
+void fill(void *buf, CType T, uint64_t n, const BenchOptions &BO, std::mt19937_64 &rng) {
+    std::vector<double> v(n);
+    std::uniform_real_distribution<double> U(0.0, BO.range);
+    for (uint64_t i = 0; i < n; ++i) {
+        if (BO.dist == "const") v[i] = BO.range / 2;
+        else if (BO.dist == "alternating") v[i] = (i & 1) ? BO.range - 1 : 0;
+        else v[i] = U(rng);
+    }
+    if (BO.dist == "sorted") std::sort(v.begin(), v.end());
+
+    size_t eb = bytesOf(T);
+    char *p = static_cast<char*>(buf);
+    for (uint64_t i = 0; i < n; ++i, p += eb) {
+        if (T.kind == TypeKind::Float) { float f = (float)v[i]; std::memcpy(p, &f, 4); }
+        else if (T.kind == TypeKind::Double) std::memcpy(p, &v[i], 8);
+        else { int64_t x = (int64_t)v[i]; std::memcpy(p, &x, eb); } // little-endian low bytes
+    }
+}
+
+struct Stats { double mean, min, sd; };
+
+// Every call, warmup or timed, starts from the same inputs: kernels that
+// write their arrays in place (a[i] += ..., sorts, prefix sums) would
+// otherwise run on their own output. reset() runs outside the timer.
+Stats timeKernel(void (*Entry)(void**), void **argv, const BenchOptions &BO,
+                 const std::function<void()> &reset) {
+    for (unsigned i = 0; i < BO.warmup; ++i) { reset(); Entry(argv); }
+    std::vector<double> ns;
+    for (unsigned i = 0; i < BO.reps; ++i) {
+        reset();
+        auto t0 = std::chrono::steady_clock::now();
+        Entry(argv);
+        auto t1 = std::chrono::steady_clock::now();
+        ns.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count() / (double)BO.n);
+    }
+    Stats S{0, ns[0], 0};
+    for (double x : ns) { S.mean += x; S.min = std::min(S.min, x); }
+    S.mean /= ns.size();
+    for (double x : ns) S.sd += (x - S.mean) * (x - S.mean);
+    S.sd = ns.size() > 1 ? std::sqrt(S.sd / (ns.size() - 1)) : 0;
+    return S;
+}
+
+} // namespace
+
+int runJitMain(const TranslationUnit &TU, TargetMachine &TM, const JitOptions &JO) {
+    for (auto &F : TU.funcs)
+        if (F.name == "main" && !F.params.empty()) {
+            errs() << "--jit: main must take no parameters\n";
+            return 1;
+        }
+    auto J = buildJit(TU, TM, JO, "main", /*bench=*/false);
+    if (!J) { errs() << "jit: " << toString(J.takeError()) << "\n"; return 1; }
+    auto Main = lookupFn<int()>(**J, "main");
+    if (!Main) { errs() << "jit: " << toString(Main.takeError()) << "\n"; return 1; }
+    return (*Main)();
+}
+
+int runJitBench(const TranslationUnit &TU, TargetMachine &TM, const JitOptions &JO,
+                const BenchOptions &BO) {
+    const FuncAST *K = nullptr;
+    for (auto &F : TU.funcs)
+        if (F.isDefinition && (BO.kernel.empty() || F.name == BO.kernel)) K = &F;
+    if (!K) {
+        errs() << "--bench: no kernel " << (BO.kernel.empty() ? "defined" : "'" + BO.kernel + "'") << "\n";
+        return 1;
+    }
+    if (BO.dist != "random" && BO.dist != "sorted" && BO.dist != "const" && BO.dist != "alternating") {
+        errs() << "--bench-dist must be random, sorted, const or alternating\n";
+        return 1;
+    }
+    if (!BO.n || !BO.reps) { errs() << "--bench-n and --bench-reps must be positive\n"; return 1; }
+
+    // Pointer parameters get n-element arrays, integer parameters get n,
+    // floating-point parameters get 1.0.
+    std::vector<Arg> args(K->params.size());
+    size_t bytesPerElem = 0;
+    for (size_t i = 0; i < args.size(); ++i) {
+        Arg &A = args[i];
+        A.type = K->params[i].first;
+        if (A.type.ptr > 1) {
+            errs() << "--bench: parameter '" << K->params[i].second << "' of " << K->name
+                   << " is a pointer to pointer\n";
+            return 1;
+        }
+        if (A.type.isPointer()) {
+            A.elemBytes = bytesOf(A.type.pointee());
+            size_t bytes = (BO.n * A.elemBytes + 63) / 64 * 64;
+            A.buf = std::aligned_alloc(64, bytes);
+            if (!A.buf) { errs() << "--bench: out of memory\n"; return 1; }
+            std::memcpy(A.slot.data(), &A.buf, sizeof(void*));
+            bytesPerElem += A.elemBytes;
+        } else if (A.type.kind == TypeKind::Float) {
+            float f = 1.0f; std::memcpy(A.slot.data(), &f, 4);
+        } else if (A.type.kind == TypeKind::Double) {
+            double d = 1.0; std::memcpy(A.slot.data(), &d, 8);
+        } else {
+            A.slot[0] = BO.n;
+        }
+    }
+    uint64_t result[2] = {0, 0};
+    std::vector<void*> argv;
+    for (auto &A : args) argv.push_back(A.slot.data());
+    argv.push_back(result);
+
+    std::vector<std::pair<std::string, JitOptions>> variants;
+    if (BO.compareNoVecOpt) {
+        JitOptions On = JO, Off = JO;
+        On.withVecOpt = true;
+        Off.withVecOpt = false;
+        variants = {{"vecopt", On}, {"no-vecopt", Off}};
+    } else {
+        variants = {{JO.withVecOpt ? "vecopt" : (JO.optimize ? "O3" : "O0"), JO}};
+    }
+
+    outs() << "bench " << K->name << ": n=" << BO.n << " dist=" << BO.dist
+           << " range=" << format("%g", BO.range) << " reps=" << BO.reps << " (+" << BO.warmup
+           << " warmup), " << bytesPerElem << " bytes/element\n";
+    // generated once; every call of every variant starts from these
+    std::mt19937_64 rng(BO.seed);
+    for (auto &A : args)
+        if (A.buf) {
+            fill(A.buf, A.type.pointee(), BO.n, BO, rng);
+            A.init.assign((char*)A.buf, (char*)A.buf + BO.n * A.elemBytes);
+        }
+    auto reset = [&] {
+        for (auto &A : args)
+            if (A.buf) std::memcpy(A.buf, A.init.data(), A.init.size());
+    };
+
+    std::vector<Stats> results;
+    int rc = 0;
+    for (auto &V : variants) {
+
+        auto J = buildJit(TU, TM, V.second, K->name, /*bench=*/true);
+        if (!J) { errs() << "jit: " << toString(J.takeError()) << "\n"; rc = 1; break; }
+        auto Entry = lookupFn<void(void**)>(**J, BenchEntry);
+        if (!Entry) { errs() << "jit: " << toString(Entry.takeError()) << "\n"; rc = 1; break; }
+
+        Stats S = timeKernel(*Entry, argv.data(), BO, reset);
+        results.push_back(S);
+        outs() << "  " << left_justify(V.first, 10) << ": "
+               << format("%.3f ns/elem (min %.3f, sd %.3f, cv %.1f%%)  %.2f GB/s\n",
+                         S.mean, S.min, S.sd, S.mean > 0 ? 100 * S.sd / S.mean : 0.0,
+                         S.mean > 0 ? bytesPerElem / S.mean : 0.0);
+    }
+    if (results.size() == 2 && results[0].mean > 0)
+        outs() << "  " << left_justify("speedup", 10) << ": "
+               << format("%.2fx\n", results[1].mean / results[0].mean);
+
+    for (auto &A : args) std::free(A.buf);
+    return rc;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace llvm { class TargetMachine; }
+struct TranslationUnit;
+
+// ORC LLJIT execution of a translation unit (--jit). Every run builds its own
+// module from the AST, optimizes it for TM's CPU/features and JITs it, so
+// variants (with / without VecOpt) never share state.
+struct JitOptions {
+    bool optimize = true;    // run the O3 pipeline
+    bool withVecOpt = false; // ... with the VecOpt stages
+};
+
+// --jit: call `int main(void)` of the TU and return its result.
+int runJitMain(const TranslationUnit &TU, llvm::TargetMachine &TM, const JitOptions &JO);
+
+// --jit --bench: call one kernel repeatedly on synthetic inputs.
+struct BenchOptions {
+    std::string kernel;          // empty: the last function defined
+    uint64_t n = 1u << 20;       // elements per array argument
+    std::string dist = "random"; // random | sorted | const | alternating
+    double range = 256;          // values drawn from [0, range)
+    unsigned warmup = 3;
+    unsigned reps = 20;
+    uint64_t seed = 1;
+    bool compareNoVecOpt = false; // also time the build without VecOpt
+};
+
+// Prints ns/element, GB/s and the spread over the timed repetitions;
+// returns a process exit code.
+int runJitBench(const TranslationUnit &TU, llvm::TargetMachine &TM, const JitOptions &JO,
+                const BenchOptions &BO);
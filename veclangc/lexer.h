@@ -1,71 +1,208 @@
 #pragma once
-#include <string>
+#include <array>
 #include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_set>
 
 enum class Tok {
-  Eof, Ident, Number,
+  Eof, Ident, Number, FloatNumber,
   KwInt, KwConst, KwReturn, KwFor, KwIf, KwElse, KwWhile,
+  KwVoid, KwChar, KwShort, KwLong, KwFloat, KwDouble, KwSigned, KwUnsigned,
+  KwStatic, KwInline, KwExtern, KwRestrict, KwAttribute,
+  Pragma, // #pragma line; text = everything after 'pragma'
   Star, Amp, LParen, RParen, LBrace, RBrace, LBracket, RBracket,
   Comma, Semicolon, Assign,
   Plus, Minus, Mul, Div, Mod,
   Lt, Gt, Le, Ge, EqEq, Ne,
   Shl, Shr, Pipe, Caret,
-  PlusPlus
+  PlusPlus, Question, Colon,
+  MinusMinus, Not, Tilde, AndAnd, OrOr,
+  PlusAssign, MinusAssign, MulAssign, DivAssign, ModAssign,
+  AndAssign, OrAssign, XorAssign, ShlAssign, ShrAssign
 };
 
+// Token text points into the source buffer (identifiers: into the first
+// occurrence of that spelling), so the buffer must outlive the tokens.
 struct Token {
   Tok kind;
-  std::string text;
+  std::string_view text;
   int64_t num = 0;
+  // literal suffixes / value for Number and FloatNumber
+  double fnum = 0;
+  bool isUnsigned = false; // 'u' suffix
+  bool isLong = false;     // 'l' / 'll' suffix
+  bool isF32 = false;      // 'f' suffix
 };
 
+// Keywords by perfect hash: every spelling below lands in its own slot, so a
+// lookup is one hash and at most one compare.
+inline Tok keywordKind(std::string_view w) {
+  struct Slot { std::string_view w; Tok k = Tok::Ident; };
+  static const auto hash = [](std::string_view s) {
+    return (s.size() + (unsigned char)s[1]*6u + (unsigned char)s.back()*7u + (unsigned char)s[0]) & 63u;
+  };
+  static const std::array<Slot, 64> table = [] {
+    const std::pair<const char*, Tok> kws[] = {
+      {"int", Tok::KwInt}, {"const", Tok::KwConst}, {"return", Tok::KwReturn}, {"for", Tok::KwFor},
+      {"if", Tok::KwIf}, {"else", Tok::KwElse}, {"while", Tok::KwWhile}, {"void", Tok::KwVoid},
+      {"char", Tok::KwChar}, {"short", Tok::KwShort}, {"long", Tok::KwLong}, {"float", Tok::KwFloat},
+      {"double", Tok::KwDouble}, {"signed", Tok::KwSigned}, {"unsigned", Tok::KwUnsigned},
+      {"static", Tok::KwStatic}, {"inline", Tok::KwInline}, {"__inline", Tok::KwInline},
+      {"__inline__", Tok::KwInline}, {"extern", Tok::KwExtern}, {"restrict", Tok::KwRestrict},
+      {"__restrict", Tok::KwRestrict}, {"__restrict__", Tok::KwRestrict},
+      {"__attribute__", Tok::KwAttribute}, {"__attribute", Tok::KwAttribute},
+    };
+    std::array<Slot, 64> T{};
+    for (auto &kw : kws) {
+      Slot &S = T[hash(kw.first)];
+      if (!S.w.empty()) std::abort(); // the hash is no longer perfect
+      S = {kw.first, kw.second};
+    }
+    return T;
+  }();
+  if (w.size() < 2 || w.size() > 13) return Tok::Ident;
+  const Slot &S = table[hash(w)];
+  return S.w == w ? S.k : Tok::Ident;
+}
+
+// Lexes a caller-owned buffer (an mmap'd .i or the preprocessor output)
+// without copying it.
 class Lexer {
-  const std::string src;
+  std::string_view src;
   size_t i = 0;
+  // one spelling per distinct identifier
+  std::unordered_set<std::string_view> idents;
+
+  // \n, \t, \0, \\, \' ... inside a character literal
+  char escape(char c) {
+    switch (c) {
+      case 'n': return '\n'; case 't': return '\t'; case 'r': return '\r';
+      case '0': return '\0'; case 'a': return '\a'; case 'b': return '\b';
+      case 'f': return '\f'; case 'v': return '\v';
+      default:  return c;
+    }
+  }
+
+  Token lexNumber() {
+    size_t j = i;
+    bool isFloat = false;
+    if (src[j]=='0' && j+1<src.size() && (src[j+1]=='x' || src[j+1]=='X')) {
+      j += 2;
+      while (j<src.size() && isxdigit((unsigned char)src[j])) ++j;
+    } else {
+      while (j<src.size() && isdigit((unsigned char)src[j])) ++j;
+      if (j<src.size() && src[j]=='.') {
+        isFloat = true; ++j;
+        while (j<src.size() && isdigit((unsigned char)src[j])) ++j;
+      }
+      if (j<src.size() && (src[j]=='e' || src[j]=='E')) {
+        isFloat = true; ++j;
+        if (j<src.size() && (src[j]=='+' || src[j]=='-')) ++j;
+        while (j<src.size() && isdigit((unsigned char)src[j])) ++j;
+      }
+    }
+    std::string_view text = src.substr(i, j-i);
+    std::string digits(text); // NUL-terminated for strto*
+    Token t{isFloat ? Tok::FloatNumber : Tok::Number, text};
+    if (isFloat) t.fnum = std::strtod(digits.c_str(), nullptr);
+    else t.num = (int64_t)std::strtoull(digits.c_str(), nullptr, 0);
+    // suffixes: u, l, ll, f in any order C allows
+    while (j<src.size()) {
+      char s = (char)tolower((unsigned char)src[j]);
+      if (s=='u' && !isFloat) t.isUnsigned = true;
+      else if (s=='l') t.isLong = true;
+      else if (s=='f' && isFloat) t.isF32 = true;
+      else break;
+      ++j;
+    }
+    i = j;
+    return t;
+  }
+
 public:
-  explicit Lexer(std::string s): src(std::move(s)) {}
+  explicit Lexer(std::string_view s): src(s) {}
+  // Save / restore the read position (parser lookahead).
+  size_t pos() const { return i; }
+  void reset(size_t p) { i = p; }
   Token next() {
-    // Skip preprocessor line markers starting with '#'
-    if (i < src.size() && src[i] == '#') {
-    while (i < src.size() && src[i] != '\n') ++i; // skip until end of line
-    return next(); // restart lexing after skipping the line
-    }
-    auto skipSpace = [&]{
+    for (;;) {
       while (i < src.size()) {
         if (isspace((unsigned char)src[i])) { ++i; continue; }
         if (src[i]=='/' && i+1<src.size() && src[i+1]=='/') { while(i<src.size()&&src[i]!='\n') ++i; continue; }
         if (src[i]=='/' && i+1<src.size() && src[i+1]=='*') { i+=2; while(i+1<src.size() && !(src[i]=='*'&&src[i+1]=='/')) ++i; if(i+1<src.size()) i+=2; continue; }
         break;
       }
-    };
-    skipSpace();
+      if (i >= src.size() || src[i] != '#') break;
+      // Skip preprocessor line markers starting with '#'; #pragma lines are
+      // kept as one token for the parser
+      size_t j = i + 1;
+      while (j < src.size() && (src[j]==' ' || src[j]=='\t')) ++j;
+      bool pragma = src.compare(j, 6, "pragma") == 0;
+      size_t eol = src.find('\n', i);
+      i = eol == std::string_view::npos ? src.size() : eol;
+      if (pragma) {
+        std::string_view text = src.substr(j + 6, i - j - 6);
+        size_t b = text.find_first_not_of(" \t"), e = text.find_last_not_of(" \t\r");
+        return {Tok::Pragma, b == std::string_view::npos ? std::string_view() : text.substr(b, e - b + 1)};
+      }
+    }
     if (i >= src.size()) return {Tok::Eof,""};
     char c = src[i];
 
     if (isalpha((unsigned char)c) || c=='_') {
       size_t j=i; while(j<src.size() && (isalnum((unsigned char)src[j]) || src[j]=='_')) ++j;
-      std::string w = src.substr(i, j-i); i=j;
-      if (w=="int") return {Tok::KwInt,w};
-      if (w=="const") return {Tok::KwConst,w};
-      if (w=="return") return {Tok::KwReturn,w};
-      if (w=="for") return {Tok::KwFor,w};
-      if (w=="if") return {Tok::KwIf,w};
-      if (w=="else") return {Tok::KwElse,w};
-      if (w=="while")   return {Tok::KwWhile, w};
-      return {Tok::Ident,w};
+      std::string_view w = src.substr(i, j-i); i=j;
+      Tok k = keywordKind(w);
+      if (k != Tok::Ident) return {k, w};
+      return {Tok::Ident, *idents.insert(w).first};
     }
-    if (isdigit((unsigned char)c)) {
-      int64_t v=0; size_t j=i;
-      while(j<src.size() && isdigit((unsigned char)src[j])) { v = v*10 + (src[j]-'0'); ++j; }
-      i=j; return {Tok::Number,"",v};
+    if (isdigit((unsigned char)c) ||
+        (c=='.' && i+1<src.size() && isdigit((unsigned char)src[i+1]))) {
+      return lexNumber();
+    }
+    if (c=='\'') { // character literal -> int constant
+      ++i;
+      if (i<src.size() && src[i]=='\'') throw std::runtime_error("empty character literal");
+      if (i>=src.size() || src[i]=='\n') throw std::runtime_error("unterminated character literal");
+      char v = src[i++];
+      if (v=='\\') {
+        if (i>=src.size()) throw std::runtime_error("unterminated character literal");
+        v = escape(src[i++]);
+      }
+      if (i>=src.size() || src[i]!='\'') throw std::runtime_error("unterminated character literal");
+      ++i;
+      Token t{Tok::Number, ""};
+      t.num = v;
+      return t;
     }
+    auto three = [&](const char *s)->int{
+      if (src.compare(i, 3, s) == 0){ i+=3; return 1; } return 0; };
+    if (three("<<=")) return {Tok::ShlAssign,"<<="};
+    if (three(">>=")) return {Tok::ShrAssign,">>="};
     auto two = [&](char a,char b)->int{
       if (i+1<src.size() && src[i]==a && src[i+1]==b){ i+=2; return 1; } return 0; };
     if (two('=','=')) return {Tok::EqEq,"=="};
     if (two('!','=')) return {Tok::Ne,"!="};
+    if (two('<','<')) return {Tok::Shl,"<<"};
+    if (two('>','>')) return {Tok::Shr,">>"};
     if (two('<','=')) return {Tok::Le,"<="};
     if (two('>','=')) return {Tok::Ge,">="};
     if (two('+','+')) return {Tok::PlusPlus,"++"};
+    if (two('-','-')) return {Tok::MinusMinus,"--"};
+    if (two('&','&')) return {Tok::AndAnd,"&&"};
+    if (two('|','|')) return {Tok::OrOr,"||"};
+    if (two('+','=')) return {Tok::PlusAssign,"+="};
+    if (two('-','=')) return {Tok::MinusAssign,"-="};
+    if (two('*','=')) return {Tok::MulAssign,"*="};
+    if (two('/','=')) return {Tok::DivAssign,"/="};
+    if (two('%','=')) return {Tok::ModAssign,"%="};
+    if (two('&','=')) return {Tok::AndAssign,"&="};
+    if (two('|','=')) return {Tok::OrAssign,"|="};
+    if (two('^','=')) return {Tok::XorAssign,"^="};
 
     ++i;
     switch(c){
@@ -83,10 +220,16 @@ public:
       case '+': return {Tok::Plus,"+"};
       case '-': return {Tok::Minus,"-"};
       case '/': return {Tok::Div,"/"};
-      case '%': return {Tok::Mod,"%"}; 
+      case '%': return {Tok::Mod,"%"};
       case '<': return {Tok::Lt,"<"};
       case '>': return {Tok::Gt,">"};
       case '*': return {Tok::Mul, "*"};
+      case '?': return {Tok::Question,"?"};
+      case ':': return {Tok::Colon,":"};
+      case '|': return {Tok::Pipe,"|"};
+      case '^': return {Tok::Caret,"^"};
+      case '!': return {Tok::Not,"!"};
+      case '~': return {Tok::Tilde,"~"};
       default:  return {Tok::Eof,""};
     }
   }
@@ -1,16 +1,26 @@
+#include "archive.h"
 #include "codegen.h"
+#include "frontend_bench.h"
+#include "jit.h"
+#include "server.h"
 #include "parser.h"
 #include "ast.h"
 #include "preprocessor.h"
+#include "VecOpt/VecOpt.h"
 
+#include <llvm/Config/llvm-config.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
 #include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/TargetParser/Host.h>
 
-#include <fstream>
-#include <sstream>
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
 
 using namespace llvm;
 
@@ -18,7 +28,55 @@ static cl::opt<std::string> InPath("input", cl::desc("C or preprocessed C (.c/.i
 static cl::opt<std::string> IncludeDir("I", cl::desc("Add include search dir"), cl::value_desc("dir"));
 static cl::opt<std::string> OutObj("o", cl::desc("Output object file"), cl::init("a.o"));
 static cl::opt<bool> EmitObj("c", cl::desc("Emit object file (.o)"));
+static cl::opt<bool> EmitLLVM("emit-llvm", cl::desc("With -c: write LLVM bitcode instead of an object"));
+static cl::opt<LTOKind> LTO("flto", cl::desc("With -c: write bitcode for link-time optimization with clang -flto"),
+                            cl::ValueOptional, cl::init(LTOKind::None),
+                            cl::values(clEnumValN(LTOKind::Full, "full", "Full LTO (the default for bare -flto)"),
+                                       clEnumValN(LTOKind::Full, "", ""),
+                                       clEnumValN(LTOKind::Thin, "thin", "ThinLTO: bitcode with a module summary")));
 static cl::opt<bool> OptO3("O3", cl::desc("Enable O3 pipeline (default on)"), cl::init(true));
+static cl::opt<std::string> MArch("march", cl::desc("Target CPU: 'native' (host CPU and features) or a CPU name"),
+                                  cl::value_desc("cpu"), cl::init("native"));
+static cl::opt<std::string> MCPU("mcpu", cl::desc("Target CPU; overrides -march"), cl::value_desc("cpu"));
+static cl::opt<std::string> MAttr("mattr", cl::desc("Target features on top of the CPU's, e.g. +avx2,-avx512f"),
+                                  cl::value_desc("a1,+a2,-a3"));
+static cl::opt<bool> PIC("fPIC", cl::desc("Position-independent code (PIE links of code with #pragma parallel loops)"));
+static cl::opt<bool> UseVecOpt("vecopt", cl::desc("Run the VecOpt stages in the O3 pipeline (tune with -vecopt-*)"));
+static cl::opt<bool> Jit("jit", cl::desc("JIT the input with ORC and run int main(void) (or the kernel with --bench)"));
+static cl::opt<bool> Bench("bench", cl::desc("With --jit: time a kernel on synthetic inputs"));
+static cl::opt<std::string> BenchKernel("bench-kernel", cl::desc("Kernel to time (default: last function defined)"),
+                                        cl::value_desc("name"));
+static cl::opt<unsigned long long> BenchN("bench-n", cl::desc("Elements per array argument; integer arguments get this value too"),
+                                          cl::init(1u << 20));
+static cl::opt<std::string> BenchDist("bench-dist", cl::desc("Input values: random | sorted | const | alternating"),
+                                      cl::init("random"));
+static cl::opt<double> BenchRange("bench-range", cl::desc("Input values are drawn from [0, range)"), cl::init(256));
+static cl::opt<unsigned> BenchWarmup("bench-warmup", cl::desc("Untimed warmup calls"), cl::init(3));
+static cl::opt<unsigned> BenchReps("bench-reps", cl::desc("Timed calls"), cl::init(20));
+static cl::opt<unsigned long long> BenchSeed("bench-seed", cl::desc("Input RNG seed"), cl::init(1));
+static cl::opt<bool> BenchCompare("bench-compare", cl::desc("Time the kernel both with and without VecOpt"));
+static cl::opt<bool> BenchFrontend("bench-frontend",
+                                   cl::desc("Time lexing, parsing and IR generation of --input (uses --bench-warmup/--bench-reps)"));
+static cl::opt<bool> Serve("serve", cl::desc("Run as a compile server on --socket: targets stay warm, objects are cached"));
+static cl::opt<bool> UseServer("server", cl::desc("Send -c compiles to the compile server on --socket; compile locally if none answers. "
+                                                   "The server compiles one request at a time: not for make -j"));
+static cl::opt<std::string> SocketPath("socket", cl::desc("Compile server socket"), cl::value_desc("path"),
+                                       cl::init(defaultSocketPath()));
+static cl::opt<std::string> CacheDir("cache-dir", cl::desc("Compile server object cache (default ~/.cache/veclangc)"),
+                                     cl::value_desc("dir"));
+static cl::list<std::string> InputFiles(cl::Positional, cl::desc("<a.c b.c ...> (multi-file driver: -o lib.a)"));
+static cl::opt<unsigned> Jobs("j", cl::desc("Multi-file driver threads (default: all hardware threads)"), cl::init(0));
+static cl::opt<std::string> SimdHeader("simd-header",
+                                       cl::desc("Write the input's #pragma declare simd functions as a C header for callers"),
+                                       cl::value_desc("file.h"));
+static cl::list<std::string> MultiVersion("multiversion", cl::CommaSeparated,
+                                          cl::desc("Clone exported functions for these ISAs (sse4.2,avx2,avx512) "
+                                                   "behind an ifunc that picks one at load time"),
+                                          cl::value_desc("isa,..."));
+static cl::list<std::string> Specialize("specialize", cl::CommaSeparated,
+                                        cl::desc("Clone functions with an integer parameter fixed to a value, "
+                                                 "like #pragma specialize: [function.]param=value,..."),
+                                        cl::value_desc("param=value,..."));
 static cl::opt<bool> EmitSAD("emit-sad", cl::desc("Emit built-in sad() kernel (for debug)"));
 
 static bool endsWith(const std::string& s, const char* suf){
@@ -26,55 +84,282 @@ static bool endsWith(const std::string& s, const char* suf){
   return s.size() >= n && s.compare(s.size()-n, n, suf) == 0;
 }
 
+static bool startsWith(StringRef s, StringRef pfx) { return s.substr(0, pfx.size()) == pfx; }
+
+// Preprocessed text of an input (.c through the tiny preprocessor, .i as is).
+// The lexer works on this buffer in place.
+static std::unique_ptr<MemoryBuffer> readInput(const std::string &path) {
+  if (path.empty()) throw std::runtime_error("need --input <file.c|file.i>");
+  if (endsWith(path, ".c")) {
+    // Run tiny preprocessor
+    Preprocessor PP;
+    if (!IncludeDir.empty()) PP.addIncludeDir(IncludeDir);
+    // Also add the input file's directory as first search path for "..."
+    // (PP handles that internally when resolving includes)
+    try {
+      return MemoryBuffer::getMemBufferCopy(PP.run(path), path);
+    } catch (const std::exception& ex) {
+      throw std::runtime_error(std::string("preprocess failed: ") + ex.what());
+    }
+  }
+  // Treat as already-preprocessed .i; large files are mmap'd
+  auto Buf = MemoryBuffer::getFile(path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+  if (!Buf) throw std::runtime_error("cannot open " + path + ": " + Buf.getError().message());
+  return std::move(*Buf);
+}
+
+static std::unique_ptr<TargetMachine> makeTargetMachine() {
+  // the ifunc resolvers of --multiversion take the clones' addresses
+  return createTargetMachineFromTriple(sys::getDefaultTargetTriple(), MCPU.empty() ? MArch : MCPU, MAttr,
+                                       /*PIC=*/PIC || !MultiVersion.empty());
+}
+
+// Multiversioning, target attributes and the O3 pipeline, per the current
+// options.
+static void optimize(Module &M, TargetMachine &TM) {
+  if (!MultiVersion.empty()) multiversionFunctions(M, {MultiVersion.begin(), MultiVersion.end()});
+  setTargetAttributes(M, TM);
+  if (OptO3) runO3Pipeline(M, &TM, UseVecOpt, LTO);
+}
+
+// The -c output: an object, or bitcode with -emit-llvm / -flto.
+static bool emitOutput(Module &M, TargetMachine &TM, SmallVectorImpl<char> &Out) {
+  if (!EmitLLVM && LTO == LTOKind::None) return emitObjectToBuffer(M, TM, Out);
+  M.setDataLayout(TM.createDataLayout());
+  emitBitcodeToBuffer(M, LTO, Out);
+  return true;
+}
+
+// --simd-header: the declare-simd prototypes of TU.
+static bool writeSimdHeader(const TranslationUnit &TU, std::string &err) {
+  std::error_code EC;
+  raw_fd_ostream OS(SimdHeader, EC, sys::fs::OF_Text);
+  if (EC) { err = "open " + SimdHeader + " failed: " + EC.message(); return false; }
+  OS << declareSimdHeader(TU, InPath);
+  return true;
+}
+
+// --- Compile server ---
+// One -c request. TargetMachines are kept per CPU/feature selection; the
+// object is looked up by a hash of everything that determines its bytes.
+static int serveCompile(const std::vector<std::string> &args, std::string &msg,
+                        std::map<std::string, std::unique_ptr<TargetMachine>> &TMs,
+                        const ObjectCache &Cache, const std::string &compilerId) {
+  if (!EmitObj || Jit || Serve || EmitSAD || BenchFrontend) {
+    msg = "veclangc server: only -c compiles are served\n";
+    return 1;
+  }
+  auto source = readInput(InPath);
+
+  std::string tmKey = (MCPU.empty() ? MArch : MCPU) + "|" + MAttr + (PIC || !MultiVersion.empty() ? "|pic" : "");
+  auto &TM = TMs[tmKey];
+  if (!TM) TM = makeTargetMachine();
+  if (!TM) { msg = "cannot create a target machine for " + tmKey + "\n"; return 1; }
+
+  // everything but the input/output names, plus the resolved target
+  std::vector<std::string> parts{compilerId, LLVM_VERSION_STRING, vecopt::VersionString,
+                                 TM->getTargetTriple().str(), TM->getTargetCPU().str(),
+                                 TM->getTargetFeatureString().str(), source->getBuffer().str()};
+  for (size_t i = 0; i < args.size(); ++i) {
+    StringRef a = args[i];
+    if (a == "--input" || a == "-input" || a == "-o" || a == "--o") { ++i; continue; }
+    if (a.contains("input=") || startsWith(a, "-o=") || startsWith(a, "--o=")) continue;
+    parts.push_back(a.str());
+  }
+  // a branch profile changes the output without changing the flags; the
+  // pass reloads it when the file changes, so key on what is there now
+  auto &Opts = cl::getRegisteredOptions();
+  auto *BPProfile = static_cast<cl::opt<std::string>*>(Opts.lookup("vecopt-bp-profile"));
+  if (BPProfile && !BPProfile->empty()) {
+    auto Buf = MemoryBuffer::getFile(*BPProfile);
+    parts.push_back(Buf ? (*Buf)->getBuffer().str() : std::string());
+  }
+  std::string key = ObjectCache::key(parts);
+  bool cached = !compilerId.empty(); // no identity, no cache
+  bool hit = cached && Cache.fetch(key, OutObj);
+  if (hit && SimdHeader.empty()) return 0;
+
+  // the header is a second output: written on cache hits too
+  Parser P(source->getBuffer());
+  TranslationUnit TU = P.parseTranslationUnit();
+  addSpecializations(TU, {Specialize.begin(), Specialize.end()});
+  if (!SimdHeader.empty()) {
+    std::string err;
+    if (!writeSimdHeader(TU, err)) { msg = err + "\n"; return 1; }
+  }
+  if (hit) return 0;
+
+  LLVMContext Ctx;
+  auto Mod = std::make_unique<Module>("veclangc", Ctx);
+  Mod->setTargetTriple(TM->getTargetTriple().str());
+  Mod->setDataLayout(TM->createDataLayout());
+  buildFromAST(*Mod, TU);
+  optimize(*Mod, *TM);
+  SmallVector<char, 0> Obj;
+  if (!emitOutput(*Mod, *TM, Obj)) { msg = "object emission failed\n"; return 1; }
+  StringRef Bytes(Obj.data(), Obj.size());
+  if (cached) Cache.store(key, Bytes);
+
+  std::error_code EC;
+  raw_fd_ostream OS(OutObj, EC, sys::fs::OF_None);
+  if (EC) { msg = "open output failed: " + EC.message() + "\n"; return 1; }
+  OS << Bytes;
+  return 0;
+}
+
+// The compiler itself is part of every cache key: a hash of this executable,
+// taken once at startup, so a rebuilt veclangc never gets stale objects.
+// Empty if the executable cannot be read.
+static std::string compilerIdentity(const char *argv0) {
+  static int anchor;
+  std::string exe = sys::fs::getMainExecutable(argv0, &anchor);
+  auto Buf = exe.empty() ? nullptr : MemoryBuffer::getFile(exe, /*IsText=*/false,
+                                                           /*RequiresNullTerminator=*/false);
+  if (!Buf) return std::string();
+  return ObjectCache::key({(*Buf)->getBuffer().str()});
+}
+
+static int runServer(const char *argv0) {
+  std::string dir = CacheDir;
+  if (dir.empty()) {
+    SmallString<256> P;
+    if (const char *X = std::getenv("XDG_CACHE_HOME")) P = X;
+    else if (sys::path::home_directory(P)) sys::path::append(P, ".cache");
+    else P = "/tmp";
+    sys::path::append(P, "veclangc");
+    dir = P.str().str();
+  }
+  ObjectCache Cache(dir);
+  // clients send their $VECOPT_REWRITE as -vecopt-rewrite; ours must not
+  // override it
+  unsetenv("VECOPT_REWRITE");
+  std::string compilerId = compilerIdentity(argv0);
+  if (compilerId.empty()) errs() << "veclangc: cannot hash the executable; the object cache is off\n";
+  std::map<std::string, std::unique_ptr<TargetMachine>> TMs;
+  std::string socket = SocketPath; // the options are re-parsed per request
+  return runCompileServer(socket, [&](const std::vector<std::string> &args, std::string &msg) {
+    return serveCompile(args, msg, TMs, Cache, compilerId);
+  });
+}
+
 int main(int argc, char** argv) {
   cl::ParseCommandLineOptions(argc, argv, "veclangc – tiny C frontend with mini-preprocessor\n");
 
+  // thin client: nothing is initialized before the server had its chance
+  if (UseServer && EmitObj && !Jit && !Serve && !EmitSAD && !BenchFrontend) {
+    // $VECOPT_REWRITE overrides -vecopt-rewrite; the server does not see
+    // our environment, so send it as that option (and thus in the cache key)
+    const char *Rewrite = std::getenv("VECOPT_REWRITE");
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) {
+      StringRef a = argv[i];
+      if (a == "--server" || a == "-server" || startsWith(a, "--server=") || startsWith(a, "-server=")) continue;
+      if (Rewrite && (startsWith(a, "-vecopt-rewrite") || startsWith(a, "--vecopt-rewrite"))) continue;
+      args.push_back(a.str());
+    }
+    if (Rewrite) args.push_back(std::string("-vecopt-rewrite=") + (StringRef(Rewrite) != "0" ? "true" : "false"));
+    int rc = compileOnServer(SocketPath, args);
+    if (rc >= 0) return rc;
+  }
+
   InitializeNativeTarget();
   InitializeNativeTargetAsmPrinter();
   InitializeNativeTargetAsmParser();
 
+  if (Serve) return runServer(argv[0]);
+
+  // multi-file driver: every input on the pool, objects into one archive
+  if (!InputFiles.empty()) {
+    if (!InPath.empty() || Jit || EmitSAD || !endsWith(OutObj, ".a")) {
+      errs() << "multiple inputs build an archive: veclangc [-j N] a.c b.c ... -o libname.a\n";
+      return 1;
+    }
+    std::vector<std::string> inputs(InputFiles.begin(), InputFiles.end());
+    return buildArchive(inputs, OutObj, Jobs,
+        [](const std::string &path, SmallVectorImpl<char> &Obj, std::string &err) {
+          // one TargetMachine per pool thread, reused across its files
+          thread_local std::unique_ptr<TargetMachine> TM;
+          try {
+            auto source = readInput(path);
+            if (!TM) TM = makeTargetMachine();
+            if (!TM) { err = "cannot create a target machine"; return false; }
+            LLVMContext Ctx;
+            auto Mod = std::make_unique<Module>("veclangc", Ctx);
+            Mod->setTargetTriple(TM->getTargetTriple().str());
+            Mod->setDataLayout(TM->createDataLayout());
+            Parser P(source->getBuffer());
+            TranslationUnit TU = P.parseTranslationUnit();
+            addSpecializations(TU, {Specialize.begin(), Specialize.end()});
+            buildFromAST(*Mod, TU);
+            optimize(*Mod, *TM);
+            if (!emitOutput(*Mod, *TM, Obj)) { err = "object emission failed"; return false; }
+            return true;
+          } catch (const std::exception &ex) {
+            err = ex.what();
+            return false;
+          }
+        });
+  }
+
   LLVMContext Ctx;
   auto Mod = std::make_unique<Module>("veclangc", Ctx);
+  TranslationUnit TU;
 
   std::string triple = sys::getDefaultTargetTriple();
   Mod->setTargetTriple(triple);
-  auto TM = createTargetMachineFromTriple(triple);
+  auto TM = makeTargetMachine();
   if (!TM) return 1;
   Mod->setDataLayout(TM->createDataLayout());
 
-  if (EmitSAD) {
-    buildSADKernelIR(*Mod);
-  } else {
-    if (InPath.empty()){ errs() << "need --input <file.c|file.i>\n"; return 1; }
-
-    std::string sourceText;
-
-    if (endsWith(InPath, ".c")) {
-      // Run tiny preprocessor
-      Preprocessor PP;
-      if (!IncludeDir.empty()) PP.addIncludeDir(IncludeDir);
-      // Also add the input file's directory as first search path for "..."
-      // (PP handles that internally when resolving includes)
-      try {
-        sourceText = PP.run(InPath);
-      } catch (const std::exception& ex) {
-        errs() << "preprocess failed: " << ex.what() << "\n";
-        return 1;
-      }
+  // parse errors and bad pragma/option values (--multiversion,
+  // --specialize, #pragma parallel) are thrown as runtime_error
+  try {
+    if (EmitSAD) {
+      buildSADKernelIR(*Mod);
     } else {
-      // Treat as already-preprocessed .i
-      std::ifstream ifs(InPath);
-      if (!ifs){ errs() << "cannot open " << InPath << "\n"; return 1; }
-      std::stringstream ss; ss << ifs.rdbuf();
-      sourceText = ss.str();
+      std::unique_ptr<MemoryBuffer> sourceText = readInput(InPath);
+
+      if (BenchFrontend) return runFrontendBench(sourceText->getBuffer(), *TM, BenchWarmup, BenchReps);
+
+      Parser P(sourceText->getBuffer());
+      TU = P.parseTranslationUnit(); // C text -> AST
+      addSpecializations(TU, {Specialize.begin(), Specialize.end()});
+      std::string err;
+      if (!SimdHeader.empty() && !writeSimdHeader(TU, err)) { errs() << err << "\n"; return 1; }
+      if (Jit) {
+        // the JIT builds its own module(s) from the AST
+        JitOptions JO;
+        JO.optimize = OptO3;
+        JO.withVecOpt = UseVecOpt;
+        if (!Bench) return runJitMain(TU, *TM, JO);
+        BenchOptions BO;
+        BO.kernel = BenchKernel;
+        BO.n = BenchN;
+        BO.dist = BenchDist;
+        BO.range = BenchRange;
+        BO.warmup = BenchWarmup;
+        BO.reps = BenchReps;
+        BO.seed = BenchSeed;
+        BO.compareNoVecOpt = BenchCompare;
+        return runJitBench(TU, *TM, JO, BO);
+      }
+      buildFromAST(*Mod, TU);        // AST -> IR
     }
 
-    Parser P(std::move(sourceText));
-    FuncAST F = P.parseFunction();    // C text -> AST
-    buildFromAST(*Mod, F);            // AST -> IR
+    optimize(*Mod, *TM);
+    if (EmitObj && (EmitLLVM || LTO != LTOKind::None)) {
+      SmallVector<char, 0> BC;
+      emitOutput(*Mod, *TM, BC);
+      std::error_code EC;
+      raw_fd_ostream OS(OutObj, EC, sys::fs::OF_None);
+      if (EC) { errs() << "open output failed: " << EC.message() << "\n"; return 1; }
+      OS << StringRef(BC.data(), BC.size());
+    } else if (EmitObj) {
+      emitObjectFile(*Mod, *TM, OutObj);
+    }
+  } catch (const std::exception &ex) {
+    errs() << "error: " << ex.what() << "\n";
+    return 1;
   }
-
-  if (OptO3) runO3Pipeline(*Mod);
-  if (EmitObj) emitObjectFile(*Mod, *TM, OutObj);
   return 0;
 }
@@ -1,4 +1,5 @@
-int compute_sqdist(int *xs, int *ys, int *zs, int *dists, int count) {
+int compute_sqdist(const int *restrict xs, const int *restrict ys, const int *restrict zs,
+                   int *restrict dists, int count) {
   int i;
   i = 0;
   while (i < count) {
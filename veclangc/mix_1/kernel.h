@@ -1,6 +1,7 @@
 #ifndef QSORT_KERNEL_H
 #define QSORT_KERNEL_H
 
-void compute_sqdist(int *xs, int *ys, int *zs, int *dists, int count);
+void compute_sqdist(const int *restrict xs, const int *restrict ys,
+                    const int *restrict zs, int *restrict dists, int count);
 
 #endif
\ No newline at end of file
@@ -1,48 +1,228 @@
 #pragma once
 #include "lexer.h"
 #include "ast.h"
-#include <memory>
+#include <map>
 #include <stdexcept>
 
 class Parser {
     Lexer L;
     Token tok;
+    ASTArena A; // handed to the TranslationUnit at the end
 
-    void bump() { tok = L.next(); }
+    void bump() {
+        tok = L.next();
+        // #pragma once, GCC ..., other OpenMP pragmas
+        while (is(Tok::Pragma) && !isLoopPragma(tok.text) && !isFunctionPragma(tok.text)) tok = L.next();
+    }
+    static bool isLoopPragma(std::string_view text) {
+        std::string_view w = text.substr(0, text.find_first_of(" \t("));
+        return w == "vectorize" || w == "unroll" || w == "nounroll" || isParallel(text);
+    }
+    // #pragma [omp] parallel [for] <clauses>; *clauses gets the text after them.
+    static bool isParallel(std::string_view text, std::string_view *clauses = nullptr) {
+        Lexer PL(text);
+        Token t = PL.next();
+        if (t.text == "omp") t = PL.next();
+        if (t.text != "parallel") return false;
+        size_t p = PL.pos();
+        if (PL.next().kind != Tok::KwFor) PL.reset(p);
+        if (clauses) *clauses = text.substr(PL.pos());
+        return true;
+    }
+    // #pragma [omp] declare simd <clauses>; *clauses gets the text after "simd".
+    static bool isDeclareSimd(std::string_view text, std::string_view *clauses = nullptr) {
+        Lexer PL(text);
+        Token t = PL.next();
+        if (t.text == "omp") t = PL.next();
+        if (t.text != "declare" || PL.next().text != "simd") return false;
+        if (clauses) *clauses = text.substr(PL.pos());
+        return true;
+    }
+    // #pragma specialize(<param>: <values>); *clauses gets the text after "specialize".
+    static bool isSpecialize(std::string_view text, std::string_view *clauses = nullptr) {
+        Lexer PL(text);
+        if (PL.next().text != "specialize") return false;
+        if (clauses) *clauses = text.substr(PL.pos());
+        return true;
+    }
+    static bool isFunctionPragma(std::string_view text) {
+        return isDeclareSimd(text) || isSpecialize(text);
+    }
+    // The token after the current one, without consuming anything.
+    Token peek() {
+        size_t p = L.pos();
+        Token t = L.next();
+        L.reset(p);
+        return t;
+    }
     bool is(Tok k) const { return tok.kind == k; }
     void expect(Tok k, const char *msg) {
         if (!is(k)) throw std::runtime_error(msg);
         bump();
     }
 
+    // --- Types ---
+    // <stdint.h>/<stddef.h> are not read by the preprocessor, so their
+    // typedefs are builtin (LP64).
+    static const std::map<std::string, CType, std::less<>> &builtinTypedefs() {
+        static const std::map<std::string, CType, std::less<>> T = {
+            {"int8_t",   CType(TypeKind::Char)},  {"uint8_t",   CType(TypeKind::Char, true)},
+            {"int16_t",  CType(TypeKind::Short)}, {"uint16_t",  CType(TypeKind::Short, true)},
+            {"int32_t",  CType(TypeKind::Int)},   {"uint32_t",  CType(TypeKind::Int, true)},
+            {"int64_t",  CType(TypeKind::Long)},  {"uint64_t",  CType(TypeKind::Long, true)},
+            {"size_t",   CType(TypeKind::Long, true)}, {"ssize_t", CType(TypeKind::Long)},
+            {"ptrdiff_t", CType(TypeKind::Long)}, {"intptr_t",  CType(TypeKind::Long)},
+            {"uintptr_t", CType(TypeKind::Long, true)},
+        };
+        return T;
+    }
+
+    static bool isTypeStart(const Token &t) {
+        switch (t.kind) {
+            case Tok::KwInt: case Tok::KwConst: case Tok::KwVoid: case Tok::KwChar:
+            case Tok::KwShort: case Tok::KwLong: case Tok::KwFloat: case Tok::KwDouble:
+            case Tok::KwSigned: case Tok::KwUnsigned:
+                return true;
+            case Tok::Ident:
+                return builtinTypedefs().count(t.text) != 0;
+            default:
+                return false;
+        }
+    }
+    bool isTypeStart() const { return isTypeStart(tok); }
+
+    // __attribute__((a, b(args), ...)) lists; only aligned(N) is kept, the
+    // rest are skipped.
+    void parseAttributes(ParamQuals *Q = nullptr) {
+        while (is(Tok::KwAttribute)) {
+            bump();
+            expect(Tok::LParen, "( expected after __attribute__");
+            expect(Tok::LParen, "(( expected after __attribute__");
+            while (!is(Tok::RParen)) {
+                if (!is(Tok::Ident)) throw std::runtime_error("attribute name expected");
+                std::string name(tok.text);
+                bump();
+                if (is(Tok::LParen)) {
+                    bump();
+                    if ((name == "aligned" || name == "__aligned__") && is(Tok::Number)) {
+                        uint64_t n = (uint64_t)tok.num;
+                        if (!n || (n & (n - 1)))
+                            throw std::runtime_error("aligned(N) requires a power of two");
+                        if (Q) Q->align = (unsigned)n;
+                        bump();
+                    }
+                    for (int depth = 1; depth; bump()) { // skip the rest of the args
+                        if (is(Tok::Eof)) throw std::runtime_error("unterminated __attribute__");
+                        if (is(Tok::LParen)) ++depth;
+                        if (is(Tok::RParen) && !--depth) break;
+                    }
+                    bump();
+                }
+                if (!is(Tok::Comma)) break;
+                bump();
+            }
+            expect(Tok::RParen, ")");
+            expect(Tok::RParen, "))");
+        }
+    }
+
+    // specifier-qualifier list followed by any number of '*'; Q (if given)
+    // receives the const / restrict qualifiers of the outermost pointer
+    CType parseType(ParamQuals *Q = nullptr) {
+        if (!isTypeStart()) throw std::runtime_error("type expected");
+        CType T;
+        bool sawBase = false, sawUnsigned = false;
+        bool isConst = false, isRestrict = false, pointeeConst = false;
+        int longs = 0;
+        while (true) {
+            switch (tok.kind) {
+                case Tok::KwConst: isConst = true; bump(); continue;
+                case Tok::KwSigned: bump(); continue;
+                case Tok::KwUnsigned: sawUnsigned = true; bump(); continue;
+                case Tok::KwVoid:   T.kind = TypeKind::Void;   sawBase = true; bump(); continue;
+                case Tok::KwChar:   T.kind = TypeKind::Char;   sawBase = true; bump(); continue;
+                case Tok::KwShort:  T.kind = TypeKind::Short;  sawBase = true; bump(); continue;
+                case Tok::KwInt:    if (!longs && T.kind != TypeKind::Short) T.kind = TypeKind::Int;
+                                    sawBase = true; bump(); continue;
+                case Tok::KwLong:   ++longs; T.kind = TypeKind::Long; sawBase = true; bump(); continue;
+                case Tok::KwFloat:  T.kind = TypeKind::Float;  sawBase = true; bump(); continue;
+                case Tok::KwDouble: T.kind = TypeKind::Double; sawBase = true; bump(); continue;
+                case Tok::Ident: {
+                    auto it = builtinTypedefs().find(tok.text);
+                    if (sawBase || sawUnsigned || it == builtinTypedefs().end()) break;
+                    T = it->second; sawBase = true; bump(); continue;
+                }
+                default: break;
+            }
+            break;
+        }
+        if (sawUnsigned) T.isUnsigned = true;
+        // while (is(Tok::Star)) { bump(); ++T.ptr; }
+        // a qualifier applies to the pointer level left of it
+        while (is(Tok::Star) || is(Tok::Mul) || is(Tok::KwConst) || is(Tok::KwRestrict)) {
+            if (is(Tok::KwConst)) isConst = true;
+            else if (is(Tok::KwRestrict)) isRestrict = true;
+            else { ++T.ptr; pointeeConst = isConst; isConst = isRestrict = false; }
+            bump();
+        }
+        if (isRestrict && !T.isPointer())
+            throw std::runtime_error("restrict requires a pointer type");
+        if (Q) {
+            Q->isRestrict = isRestrict;
+            Q->constPointee = T.isPointer() && pointeeConst;
+        }
+        return T;
+    }
+
+    // int / unsigned / long / unsigned long per C rules for the literal's
+    // value and suffix.
+    static CType literalType(const Token &t) {
+        uint64_t v = (uint64_t)t.num;
+        bool hex = t.text.size() > 1 && t.text[0] == '0' &&
+                   (t.text[1] == 'x' || t.text[1] == 'X');
+        if (!t.isLong) {
+            if (!t.isUnsigned && v <= 0x7fffffffull) return CType(TypeKind::Int);
+            if ((t.isUnsigned || hex) && v <= 0xffffffffull) return CType(TypeKind::Int, true);
+        }
+        if (!t.isUnsigned && v <= 0x7fffffffffffffffull) return CType(TypeKind::Long);
+        return CType(TypeKind::Long, true);
+    }
+
     // --- Expression Parsing ---
-    std::unique_ptr<Expr> parsePrimary() {
+    Expr* parsePrimary() {
         if (is(Tok::Number)) {
             auto v = tok.num;
+            CType T = literalType(tok);
             bump();
-            return std::make_unique<NumberExpr>(v);
+            return A.make<NumberExpr>(v, T);
+        }
+        if (is(Tok::FloatNumber)) {
+            double v = tok.fnum;
+            CType T(tok.isF32 ? TypeKind::Float : TypeKind::Double);
+            bump();
+            return A.make<FloatExpr>(v, T);
         }
         if (is(Tok::Ident)) {
-            std::string name = tok.text;
+            std::string_view name = A.intern(tok.text);
             bump();
             if (is(Tok::LParen)) { // function call
                 bump();
-                std::vector<std::unique_ptr<Expr>> args;
+                std::vector<Expr*> args;
                 if (!is(Tok::RParen)) {
                     do {
                         args.push_back(parseExpr());
                     } while (is(Tok::Comma) && (bump(), true));
                 }
                 expect(Tok::RParen, ") expected after function arguments");
-                return std::make_unique<CallExpr>(name, std::move(args));
+                return A.make<CallExpr>(name, A.list(args));
             }
             if (is(Tok::LBracket)) { // array indexing
                 bump();
                 auto e = parseExpr();
                 expect(Tok::RBracket, "] expected");
-                return std::make_unique<IndexExpr>(name, std::move(e));
+                return A.make<IndexExpr>(name, e);
             }
-            return std::make_unique<VarExpr>(name);
+            return A.make<VarExpr>(name);
         }
         if (is(Tok::LParen)) {
             bump();
@@ -53,9 +233,39 @@ class Parser {
         throw std::runtime_error("unexpected token in expression");
     }
 
+    // unary-expression: prefix operators and casts, then postfix ++/--
+    Expr* parseUnary() {
+        auto prefix = [&](UnOp op) {
+            bump();
+            return A.make<UnaryExpr>(op, parseUnary());
+        };
+        switch (tok.kind) {
+            case Tok::Minus:      return prefix(UnOp::Neg);
+            case Tok::Not:        return prefix(UnOp::Not);
+            case Tok::Tilde:      return prefix(UnOp::BitNot);
+            case Tok::PlusPlus:   return prefix(UnOp::PreInc);
+            case Tok::MinusMinus: return prefix(UnOp::PreDec);
+            case Tok::Plus:       bump(); return parseUnary();
+            default: break;
+        }
+        if (is(Tok::LParen) && isTypeStart(peek())) { // '(' type ')' is a cast
+            bump();
+            CType T = parseType();
+            expect(Tok::RParen, ") expected after cast type");
+            return A.make<CastExpr>(T, parseUnary());
+        }
+        auto e = parsePrimary();
+        while (is(Tok::PlusPlus) || is(Tok::MinusMinus)) {
+            UnOp op = is(Tok::PlusPlus) ? UnOp::PostInc : UnOp::PostDec;
+            bump();
+            e = A.make<UnaryExpr>(op, e);
+        }
+        return e;
+    }
+
     int prec(Tok k) {
         switch (k) {
-            case Tok::Mul: case Tok::Div:                return 70;
+            case Tok::Mul: case Tok::Div: case Tok::Mod: return 70;
             case Tok::Plus: case Tok::Minus:             return 60;
             case Tok::Shl:  case Tok::Shr:               return 50;
             case Tok::Lt: case Tok::Gt: case Tok::Le: case Tok::Ge: return 40;
@@ -63,6 +273,8 @@ class Parser {
             case Tok::Amp:                               return 20; // &
             case Tok::Caret:                             return 15; // ^
             case Tok::Pipe:                              return 10; // |
+            case Tok::AndAnd:                            return 5;  // &&
+            case Tok::OrOr:                              return 4;  // ||
         default: return -1;
         }
     }
@@ -71,6 +283,8 @@ class Parser {
         switch (k) {
         case Tok::Plus: return BinOp::Add; case Tok::Minus: return BinOp::Sub;
         case Tok::Mul: return BinOp::Mul; case Tok::Div: return BinOp::Div;
+        case Tok::Mod: return BinOp::Mod;
+        case Tok::AndAnd: return BinOp::LAnd; case Tok::OrOr: return BinOp::LOr;
         case Tok::Lt: return BinOp::LT;   case Tok::Le: return BinOp::LE;
         case Tok::Gt: return BinOp::GT;   case Tok::Ge: return BinOp::GE;
         case Tok::EqEq: return BinOp::EQ; case Tok::Ne: return BinOp::NE;
@@ -83,83 +297,342 @@ class Parser {
         }
     }
 
-    std::unique_ptr<Expr> parseBinRHS(int minPrec, std::unique_ptr<Expr> lhs) {
+    Expr* parseBinRHS(int minPrec, Expr* lhs) {
         while (true) {
             int p = prec(tok.kind);
             if (p < minPrec) return lhs;
             Tok opTok = tok.kind;
             bump();
-            auto rhs = parsePrimary();
+            auto rhs = parseUnary();
             int p2 = prec(tok.kind);
-            if (p2 > p) rhs = parseBinRHS(p + 1, std::move(rhs));
-            lhs = std::make_unique<BinExpr>(toOp(opTok), std::move(lhs), std::move(rhs));
+            if (p2 > p) rhs = parseBinRHS(p + 1, rhs);
+            lhs = A.make<BinExpr>(toOp(opTok), lhs, rhs);
         }
     }
 
-    std::unique_ptr<Expr> parseAssignment() {
-        auto lhs = parseBinRHS(0, parsePrimary());
-        if (is(Tok::Assign)) {
+    // conditional-expression: binary-expr [ ? expr : conditional-expression ]
+    Expr* parseConditional() {
+        auto c = parseBinRHS(0, parseUnary());
+        if (!is(Tok::Question)) return c;
+        bump();
+        auto a = parseExpr();
+        expect(Tok::Colon, ": expected in conditional expression");
+        auto b = parseConditional();
+        return A.make<CondExpr>(c, a, b);
+    }
+
+    static bool compoundOp(Tok k, BinOp &op) {
+        switch (k) {
+            case Tok::PlusAssign:  op = BinOp::Add; return true;
+            case Tok::MinusAssign: op = BinOp::Sub; return true;
+            case Tok::MulAssign:   op = BinOp::Mul; return true;
+            case Tok::DivAssign:   op = BinOp::Div; return true;
+            case Tok::ModAssign:   op = BinOp::Mod; return true;
+            case Tok::AndAssign:   op = BinOp::And; return true;
+            case Tok::OrAssign:    op = BinOp::Or;  return true;
+            case Tok::XorAssign:   op = BinOp::Xor; return true;
+            case Tok::ShlAssign:   op = BinOp::Shl; return true;
+            case Tok::ShrAssign:   op = BinOp::Shr; return true;
+            default: return false;
+        }
+    }
+
+    Expr* parseAssignment() {
+        auto lhs = parseConditional();
+        BinOp op;
+        bool compound = compoundOp(tok.kind, op);
+        if (is(Tok::Assign) || compound) {
             bump();
             auto rhs = parseAssignment();
-            if (!dynamic_cast<VarExpr*>(lhs.get()) &&
-                !dynamic_cast<IndexExpr*>(lhs.get())) {
+            if (lhs->kind != ExprKind::Var && lhs->kind != ExprKind::Index) {
                 throw std::runtime_error("invalid assignment target");
             }
-            return std::make_unique<AssignExpr>(std::move(lhs), std::move(rhs));
+            if (compound)
+                return A.make<AssignExpr>(lhs, op, rhs);
+            return A.make<AssignExpr>(lhs, rhs);
         }
         return lhs;
     }
 
     // --- Statement Parsing ---
-    std::unique_ptr<Stmt> parseDeclaration(bool expectSemi) {
-        expect(Tok::KwInt, "int");
+    Stmt* parseDeclaration(bool expectSemi) {
+        CType type = parseType();
+        if (type.isVoid()) throw std::runtime_error("variable of type void");
         if (!is(Tok::Ident)) throw std::runtime_error("variable name expected");
-        std::string name = tok.text;
+        std::string_view name = A.intern(tok.text);
         bump();
-        std::unique_ptr<Expr> init;
+        Expr* init = nullptr;
         if (is(Tok::Assign)) {
             bump();
             init = parseExpr();
         }
         if (expectSemi) expect(Tok::Semicolon, "; expected");
-        return std::make_unique<DeclStmt>(name, std::move(init));
+        return A.make<DeclStmt>(type, name, init);
     }
 
-    std::unique_ptr<Stmt> parseIf() {
+    Stmt* parseIf() {
         expect(Tok::KwIf, "if");
         expect(Tok::LParen, "(");
         auto cond = parseExpr();
         expect(Tok::RParen, ")");
-        std::vector<std::unique_ptr<Stmt>> thenStmts;
-        thenStmts.push_back(parseStmt());
+        StmtList thenStmts = A.list(std::vector<Stmt*>{parseStmt()});
 
-        // else?
+        // else / else if (the latter is just an IfStmt as the else body)
+        StmtList elseStmts;
         if (is(Tok::KwElse)) {
             bump();
-            // Simplified: else body is treated as another IfStmt with const true
-            std::vector<std::unique_ptr<Stmt>> elseStmts;
-            elseStmts.push_back(parseStmt());
-            // TODO: AST should add else branch, currently ignored here
+            elseStmts = A.list(std::vector<Stmt*>{parseStmt()});
+        }
+        return A.make<IfStmt>(cond, thenStmts, elseStmts);
+    }
+
+    // --- Loop pragmas ---
+    //   #pragma vectorize [width(N)] [interleave(M)] [predicate]
+    //   #pragma unroll[(N)]
+    //   #pragma nounroll
+    static void parseLoopPragma(std::string_view text, LoopHints &H) {
+        Lexer PL(text);
+        auto count = [&](const char *what) -> unsigned {
+            if (PL.next().kind != Tok::LParen) throw std::runtime_error(std::string("( expected after ") + what);
+            Token n = PL.next();
+            if (n.kind != Tok::Number || n.num <= 0) throw std::runtime_error(std::string(what) + " needs a positive count");
+            if (PL.next().kind != Tok::RParen) throw std::runtime_error(std::string(") expected after ") + what);
+            return (unsigned)n.num;
+        };
+        Token t = PL.next();
+        if (t.text == "nounroll") {
+            H.noUnroll = true;
+        } else if (t.text == "unroll") {
+            size_t p = PL.pos();
+            if (PL.next().kind == Tok::LParen) { PL.reset(p); H.unroll = count("unroll"); }
+            else H.fullUnroll = true;
+        } else { // vectorize
+            for (t = PL.next(); t.kind != Tok::Eof; t = PL.next()) {
+                if (t.text == "width") H.width = count("width");
+                else if (t.text == "interleave") H.interleave = count("interleave");
+                else if (t.text == "predicate") H.predicate = true;
+                else throw std::runtime_error("unknown #pragma vectorize option: " + std::string(t.text));
+            }
+        }
+        if (PL.next().kind != Tok::Eof) throw std::runtime_error("junk after #pragma " + std::string(text));
+    }
+
+    // --- parallel loops ---
+    //   #pragma parallel [schedule(static | dynamic[, N])]
+    //                    [reduce(op: var, ...)]      op: + - * & | ^ min max
+    // `omp parallel for` and `reduction` are accepted as spellings.
+    ParallelLoop* parseParallel(std::string_view clauses) {
+        auto* P = A.make<ParallelLoop>();
+        std::vector<Reduction*> reds;
+        Lexer PL(clauses);
+        auto expectTok = [&](Tok k, const char *what) {
+            if (PL.next().kind != k) throw std::runtime_error(std::string("#pragma parallel: ") + what + " expected");
+        };
+        for (Token t = PL.next(); t.kind != Tok::Eof; t = PL.next()) {
+            if (t.kind == Tok::Comma) continue;
+            if (t.text == "schedule") {
+                expectTok(Tok::LParen, "(");
+                Token k = PL.next();
+                if (k.text != "static" && k.text != "dynamic")
+                    throw std::runtime_error("#pragma parallel: schedule(static) or schedule(dynamic) expected");
+                P->dynamic = k.text == "dynamic";
+                Token n = PL.next();
+                if (n.kind == Tok::Comma) {
+                    Token c = PL.next();
+                    if (c.kind != Tok::Number || c.num <= 0)
+                        throw std::runtime_error("#pragma parallel: chunk size must be a positive constant");
+                    P->chunk = c.num;
+                    n = PL.next();
+                }
+                if (n.kind != Tok::RParen) throw std::runtime_error("#pragma parallel: ) expected");
+            } else if (t.text == "reduce" || t.text == "reduction") {
+                expectTok(Tok::LParen, "(");
+                Token o = PL.next();
+                Reduction::Op op;
+                switch (o.kind) {
+                    case Tok::Plus: case Tok::Minus: op = Reduction::Op::Add; break;
+                    case Tok::Mul: op = Reduction::Op::Mul; break;
+                    case Tok::Amp:   op = Reduction::Op::And; break;
+                    case Tok::Pipe:  op = Reduction::Op::Or; break;
+                    case Tok::Caret: op = Reduction::Op::Xor; break;
+                    default:
+                        if (o.text == "min") op = Reduction::Op::Min;
+                        else if (o.text == "max") op = Reduction::Op::Max;
+                        else throw std::runtime_error("#pragma parallel: unsupported reduction operator " + std::string(o.text));
+                }
+                expectTok(Tok::Colon, ":");
+                for (;;) {
+                    Token v = PL.next();
+                    if (v.kind != Tok::Ident) throw std::runtime_error("#pragma parallel: reduction variable expected");
+                    for (Reduction* r : reds)
+                        if (r->var == v.text) throw std::runtime_error("#pragma parallel: " + std::string(v.text) + " is reduced twice");
+                    reds.push_back(A.make<Reduction>(op, A.intern(v.text)));
+                    Token n = PL.next();
+                    if (n.kind == Tok::RParen) break;
+                    if (n.kind != Tok::Comma) throw std::runtime_error("#pragma parallel: , or ) expected");
+                }
+            } else {
+                throw std::runtime_error("#pragma parallel: unsupported clause " + std::string(t.text));
+            }
+        }
+        P->reductions = A.list(reds);
+        return P;
+    }
+
+    // --- declare simd ---
+    //   #pragma [omp] declare simd [simdlen(N)] [uniform(a, ...)]
+    //                              [linear(i[:step], ...)] [inbranch | notinbranch]
+    // Parameters not named in a clause are vectors.
+    static SimdDecl parseDeclareSimd(std::string_view clauses, const FuncAST &F) {
+        SimdDecl D;
+        size_t b = clauses.find_first_not_of(" \t");
+        D.clauses = b == std::string_view::npos ? "" : std::string(clauses.substr(b));
+        D.params.assign(F.params.size(), SimdDecl::Param::Vector);
+        D.linearStep.assign(F.params.size(), 0);
+        Lexer PL(clauses);
+        auto param = [&](const Token &t) -> size_t {
+            for (size_t i = 0; i < F.params.size(); ++i)
+                if (t.kind == Tok::Ident && F.params[i].second == t.text) {
+                    if (D.params[i] != SimdDecl::Param::Vector)
+                        throw std::runtime_error("declare simd: " + F.params[i].second + " is in two clauses");
+                    return i;
+                }
+            throw std::runtime_error("declare simd: " + std::string(t.text) + " is not a parameter of " + F.name);
+        };
+        auto expectTok = [&](Tok k, const char *what) {
+            if (PL.next().kind != k) throw std::runtime_error(std::string("declare simd: ") + what + " expected");
+        };
+        for (Token t = PL.next(); t.kind != Tok::Eof; t = PL.next()) {
+            if (t.kind == Tok::Comma) continue;
+            if (t.text == "simdlen") {
+                expectTok(Tok::LParen, "(");
+                Token n = PL.next();
+                if (n.kind != Tok::Number || n.num < 2 || (n.num & (n.num - 1)) || n.num > 64)
+                    throw std::runtime_error("declare simd: simdlen must be a power of two in 2..64");
+                D.simdlen = (unsigned)n.num;
+                expectTok(Tok::RParen, ")");
+            } else if (t.text == "inbranch" || t.text == "notinbranch") {
+                bool in = t.text == "inbranch";
+                if (!(in ? D.masked : D.unmasked)) throw std::runtime_error("declare simd: both inbranch and notinbranch");
+                (in ? D.unmasked : D.masked) = false;
+            } else if (t.text == "uniform" || t.text == "linear") {
+                bool linear = t.text == "linear";
+                expectTok(Tok::LParen, "(");
+                for (;;) {
+                    size_t i = param(PL.next());
+                    D.params[i] = linear ? SimdDecl::Param::Linear : SimdDecl::Param::Uniform;
+                    Token n = PL.next();
+                    if (linear) {
+                        const CType &T = F.params[i].first;
+                        if (!T.isPointer() && !T.isInteger())
+                            throw std::runtime_error("declare simd: linear parameter " + F.params[i].second + " is not an integer or pointer");
+                        D.linearStep[i] = 1;
+                        if (n.kind == Tok::Colon) {
+                            Token v = PL.next();
+                            bool neg = v.kind == Tok::Minus;
+                            if (neg) v = PL.next();
+                            if (v.kind != Tok::Number) throw std::runtime_error("declare simd: constant linear step expected");
+                            D.linearStep[i] = neg ? -v.num : v.num;
+                            n = PL.next();
+                        }
+                    }
+                    if (n.kind == Tok::RParen) break;
+                    if (n.kind != Tok::Comma) throw std::runtime_error("declare simd: , or ) expected");
+                }
+            } else {
+                throw std::runtime_error("declare simd: unsupported clause " + std::string(t.text));
+            }
+        }
+        return D;
+    }
+
+    // --- specialize ---
+    //   #pragma specialize(n: 16, 64, 256)
+    // One integer parameter per pragma; several pragmas multiply.
+    static void parseSpecialize(std::string_view clauses, FuncAST &F) {
+        Lexer PL(clauses);
+        auto expectTok = [&](Tok k, const char *what) {
+            if (PL.next().kind != k) throw std::runtime_error(std::string("#pragma specialize: ") + what + " expected");
+        };
+        expectTok(Tok::LParen, "(");
+        Token p = PL.next();
+        size_t i = 0;
+        while (i < F.params.size() && (p.kind != Tok::Ident || F.params[i].second != p.text)) ++i;
+        if (i == F.params.size())
+            throw std::runtime_error("#pragma specialize: " + std::string(p.text) + " is not a parameter of " + F.name);
+        if (!F.params[i].first.isInteger())
+            throw std::runtime_error("#pragma specialize: " + F.params[i].second + " is not an integer");
+        for (auto &S : F.specialize)
+            if (S.param == i) throw std::runtime_error("#pragma specialize: " + F.params[i].second + " is specialized twice");
+        expectTok(Tok::Colon, ":");
+        Specialization S{i, {}};
+        for (;;) {
+            Token v = PL.next();
+            bool neg = v.kind == Tok::Minus;
+            if (neg) v = PL.next();
+            if (v.kind != Tok::Number) throw std::runtime_error("#pragma specialize: integer constant expected");
+            // the lexer wraps literals above INT64_MAX
+            bool ok = v.num >= 0 || (neg && v.num == INT64_MIN);
+            int64_t val = neg ? (int64_t)(0 - (uint64_t)v.num) : v.num;
+            if (!ok || !F.params[i].first.holds(val))
+                throw std::runtime_error("#pragma specialize: " + std::string(neg ? "-" : "") + std::string(v.text) +
+                                         " is out of range for " + F.params[i].second);
+            S.values.push_back(val);
+            Token n = PL.next();
+            if (n.kind == Tok::RParen) break;
+            if (n.kind != Tok::Comma) throw std::runtime_error("#pragma specialize: , or ) expected");
         }
-        return std::make_unique<IfStmt>(std::move(cond), std::move(thenStmts));
+        expectTok(Tok::Eof, "end of pragma");
+        F.specialize.push_back(std::move(S));
     }
 
-    std::unique_ptr<Stmt> parseFor() {
+    // consecutive loop pragmas, then the for/while they apply to
+    Stmt* parseLoopWithPragmas() {
+        if (isDeclareSimd(tok.text)) throw std::runtime_error("#pragma declare simd must precede a function");
+        if (isSpecialize(tok.text)) throw std::runtime_error("#pragma specialize must precede a function");
+        LoopHints H;
+        const ParallelLoop* Par = nullptr;
+        while (is(Tok::Pragma)) {
+            std::string_view clauses;
+            if (isParallel(tok.text, &clauses)) {
+                if (Par) throw std::runtime_error("two #pragma parallel on one loop");
+                Par = parseParallel(clauses);
+            } else {
+                parseLoopPragma(tok.text, H);
+            }
+            bump();
+        }
+        if (is(Tok::KwFor)) {
+            auto S = static_cast<ForStmt*>(parseFor());
+            S->hints = H;
+            S->parallel = Par;
+            return S;
+        }
+        if (Par) throw std::runtime_error("#pragma parallel must be followed by a for loop");
+        if (is(Tok::KwWhile)) {
+            auto S = parseWhile();
+            static_cast<WhileStmt*>(S)->hints = H;
+            return S;
+        }
+        throw std::runtime_error("loop pragma must be followed by a for or while loop");
+    }
+
+    Stmt* parseFor() {
         expect(Tok::KwFor, "for");
         expect(Tok::LParen, "(");
-        std::unique_ptr<Stmt> init;
+        Stmt* init = nullptr;
         if (!is(Tok::Semicolon)) {
-            if (is(Tok::KwInt)) init = parseDeclaration(false);
-            else init = std::make_unique<ExprStmt>(parseExpr());
+            if (isTypeStart()) init = parseDeclaration(false);
+            else init = A.make<ExprStmt>(parseExpr());
         }
         expect(Tok::Semicolon, "; after for-init");
-        std::unique_ptr<Expr> cond;
+        Expr* cond = nullptr;
         if (!is(Tok::Semicolon)) cond = parseExpr();
         expect(Tok::Semicolon, "; after for-cond");
-        std::unique_ptr<Expr> inc;
+        Expr* inc = nullptr;
         if (!is(Tok::RParen)) inc = parseExpr();
         expect(Tok::RParen, ")");
-        std::vector<std::unique_ptr<Stmt>> body;
+        std::vector<Stmt*> body;
         if (is(Tok::LBrace)) {
             bump();
             while (!is(Tok::RBrace)) body.push_back(parseStmt());
@@ -167,27 +640,26 @@ class Parser {
         } else {
             body.push_back(parseStmt());
         }
-        return std::make_unique<ForStmt>(
-            std::move(init), std::move(cond), std::move(inc), std::move(body));
+        return A.make<ForStmt>(init, cond, inc, A.list(body));
     }
 
-std::unique_ptr<Stmt> parseBlock() {
+Stmt* parseBlock() {
     expect(Tok::LBrace, "{");
-    std::vector<std::unique_ptr<Stmt>> body;
+    std::vector<Stmt*> body;
     while (!is(Tok::RBrace)) {
         body.push_back(parseStmt());
     }
     expect(Tok::RBrace, "}");
-    return std::make_unique<BlockStmt>(std::move(body));
+    return A.make<BlockStmt>(A.list(body));
 }
 
 
-    std::unique_ptr<Stmt> parseWhile() {
+    Stmt* parseWhile() {
     expect(Tok::KwWhile, "while");
     expect(Tok::LParen, "(");
     auto cond = parseExpr();
     expect(Tok::RParen, ")");
-    std::vector<std::unique_ptr<Stmt>> body;
+    std::vector<Stmt*> body;
     if (is(Tok::LBrace)) {
         bump();
         while (!is(Tok::RBrace)) body.push_back(parseStmt());
@@ -195,26 +667,29 @@ std::unique_ptr<Stmt> parseBlock() {
     } else {
         body.push_back(parseStmt());
     }
-    return std::make_unique<WhileStmt>(std::move(cond), std::move(body));
+    return A.make<WhileStmt>(cond, A.list(body));
 }
 
 
 
 public:
-    explicit Parser(std::string s) : L(std::move(s)) { bump(); }
+    // `s` must outlive the parser and the tokens it hands out.
+    explicit Parser(std::string_view s) : L(s) { bump(); }
 
-    std::unique_ptr<Expr> parseExpr() { return parseAssignment(); }
+    Expr* parseExpr() { return parseAssignment(); }
 
-    std::unique_ptr<Stmt> parseStmt() {
-        if (is(Tok::KwInt)) return parseDeclaration(true);
+    Stmt* parseStmt() {
+        if (isTypeStart()) return parseDeclaration(true);
         if (is(Tok::KwFor)) return parseFor();
         if (is(Tok::KwIf)) return parseIf();
         if (is(Tok::KwWhile)) return parseWhile();
+        if (is(Tok::Pragma)) return parseLoopWithPragmas();
         if (is(Tok::KwReturn)) {
             bump();
-            auto val = parseExpr();
+            Expr* val = nullptr;
+            if (!is(Tok::Semicolon)) val = parseExpr();
             expect(Tok::Semicolon, "; expected after return");
-            return std::make_unique<ReturnStmt>(std::move(val));
+            return A.make<ReturnStmt>(val);
         }
         if (is(Tok::LBrace)) return parseBlock();
 
@@ -224,45 +699,103 @@ public:
             throw std::runtime_error("; expected after expression, found: " + std::to_string(static_cast<int>(tok.kind)));
         }
         bump(); // consume the semicolon
-        return std::make_unique<ExprStmt>(std::move(expr));
+        return A.make<ExprStmt>(expr);
     }
 
     FuncAST parseFunction() {
-        // return type (only 'int' supported)
-        expect(Tok::KwInt, "int");
+        // storage class / function specifiers
+        bool isStatic = false, isInline = false;
+        while (is(Tok::KwStatic) || is(Tok::KwInline) || is(Tok::KwExtern) ||
+               is(Tok::KwAttribute)) {
+            if (is(Tok::KwAttribute)) { parseAttributes(); continue; }
+            if (is(Tok::KwStatic)) isStatic = true;
+            if (is(Tok::KwInline)) isInline = true;
+            bump();
+        }
+        CType ret = parseType();
         if (!is(Tok::Ident)) throw std::runtime_error("function name expected");
-        std::string fname = tok.text;
+        std::string fname(tok.text);
         bump();
         expect(Tok::LParen, "(");
 
-        // parse params: forms like "int x" or "int *xs"
-        std::vector<std::pair<std::string,std::string>> params;
+        // parse params: forms like "int x", "const uint8_t *xs", or "void"
+        std::vector<std::pair<CType,std::string>> params;
+        std::vector<ParamQuals> quals;
+        if (is(Tok::KwVoid) && peek().kind == Tok::RParen) bump(); // f(void)
         if (!is(Tok::RParen)) {
             while (true) {
-                // type
-                expect(Tok::KwInt, "int");
-                std::string ty = "int";
-                // while (is(Tok::Star)) { bump(); ty += "*"; }
-                while (is(Tok::Star) || is(Tok::Mul)) { bump(); ty += "*"; }
-                // name
-                if (!is(Tok::Ident)) throw std::runtime_error("param name expected");
-                std::string pname = tok.text; bump();
+                ParamQuals Q;
+                parseAttributes(&Q);
+                CType ty = parseType(&Q);
+                parseAttributes(&Q);
+                // name (optional in a prototype)
+                std::string pname;
+                if (is(Tok::Ident)) { pname = std::string(tok.text); bump(); }
+                parseAttributes(&Q);
+                if (Q.align && !ty.isPointer())
+                    throw std::runtime_error("aligned(N) on a non-pointer parameter: " + pname);
                 params.emplace_back(ty, pname);
+                quals.push_back(Q);
                 if (!is(Tok::Comma)) break;
                 bump(); // consume comma
             }
         }
         expect(Tok::RParen, ")");
+        parseAttributes();
+
+        FuncAST F;
+        F.name = fname;
+        F.ret = ret;
+        F.isStatic = isStatic;
+        F.isInline = isInline;
+
+        // prototype: int f(int);
+        if (is(Tok::Semicolon)) {
+            bump();
+            F.params = std::move(params);
+            F.paramQuals = std::move(quals);
+            return F;
+        }
+
+        for (auto &p : params)
+            if (p.second.empty()) throw std::runtime_error("param name expected in definition of " + fname);
 
         expect(Tok::LBrace, "{");
-        std::vector<std::unique_ptr<Stmt>> body;
+        std::vector<Stmt*> body;
         while (!is(Tok::RBrace)) body.push_back(parseStmt());
         expect(Tok::RBrace, "}");
 
-        FuncAST F;
-        F.name = fname;
         F.params = std::move(params);
-        F.body = std::move(body);
+        F.paramQuals = std::move(quals);
+        F.body = A.list(body);
+        F.isDefinition = true;
         return F;
     }
+
+    // Every prototype and definition up to end of input.
+    TranslationUnit parseTranslationUnit() {
+        TranslationUnit TU;
+        // declare simd / specialize pragmas for the next function
+        std::vector<std::string_view> simd, spec;
+        while (!is(Tok::Eof)) {
+            if (is(Tok::Semicolon)) { bump(); continue; } // stray ';'
+            if (is(Tok::Pragma)) {
+                std::string_view clauses;
+                if (isDeclareSimd(tok.text, &clauses)) simd.push_back(clauses);
+                else if (isSpecialize(tok.text, &clauses)) spec.push_back(clauses);
+                else throw std::runtime_error("loop pragma outside a function: #pragma " + std::string(tok.text));
+                bump();
+                continue;
+            }
+            TU.funcs.push_back(parseFunction());
+            for (std::string_view c : simd) TU.funcs.back().simd.push_back(parseDeclareSimd(c, TU.funcs.back()));
+            for (std::string_view c : spec) parseSpecialize(c, TU.funcs.back());
+            simd.clear();
+            spec.clear();
+        }
+        if (!simd.empty()) throw std::runtime_error("#pragma declare simd at end of input");
+        if (!spec.empty()) throw std::runtime_error("#pragma specialize at end of input");
+        TU.arena = std::move(A);
+        return TU;
+    }
 };
@@ -1,14 +1,288 @@
 #include "preprocessor.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
-#include <sstream>
+#include <iterator>
 #include <stdexcept>
-#include <cctype>
 #include <sys/stat.h>
 
-static bool fileExists(const std::string& p){
+using PPTok = Preprocessor::PPTok;
+
+namespace {
+
+bool fileExists(const std::string& p){
   struct stat st{}; return ::stat(p.c_str(), &st) == 0 && S_ISREG(st.st_mode);
 }
 
+// An error that already carries its file:line, passed up through includers as is.
+struct LocatedError : std::runtime_error {
+  using std::runtime_error::runtime_error;
+};
+
+bool isIdStart(char c){ return std::isalpha((unsigned char)c) || c=='_'; }
+bool isIdChar(char c){ return std::isalnum((unsigned char)c) || c=='_'; }
+
+std::string_view trimView(std::string_view s){
+  size_t i=0, j=s.size();
+  while (i<j && std::isspace((unsigned char)s[i])) ++i;
+  while (j>i && std::isspace((unsigned char)s[j-1])) --j;
+  return s.substr(i, j-i);
+}
+
+// End of the string / char literal that starts at s[i].
+size_t literalEnd(std::string_view s, size_t i){
+  char q = s[i++];
+  while (i < s.size() && s[i] != q) i += s[i]=='\\' ? 2 : 1;
+  return std::min(i + 1, s.size());
+}
+
+// Append `line` to `out` with comments replaced by a space; `inComment`
+// carries an open /* */ into the next line.
+void stripComments(std::string_view line, bool& inComment, std::string& out){
+  size_t i = 0;
+  while (i < line.size()){
+    if (inComment){
+      size_t e = line.find("*/", i);
+      if (e == std::string_view::npos) return;
+      inComment = false;
+      i = e + 2;
+      out.push_back(' ');
+      continue;
+    }
+    char c = line[i];
+    if (c=='"' || c=='\''){
+      size_t e = literalEnd(line, i);
+      out.append(line.substr(i, e-i));
+      i = e;
+    } else if (c=='/' && i+1<line.size() && line[i+1]=='/'){
+      return;
+    } else if (c=='/' && i+1<line.size() && line[i+1]=='*'){
+      inComment = true;
+      i += 2;
+    } else {
+      out.push_back(c);
+      ++i;
+    }
+  }
+}
+
+std::vector<PPTok> lexPP(std::string_view s){
+  static const char* puncts[] = {"<<=", ">>=", "...", "##", "<<", ">>", "<=", ">=", "==", "!=",
+                                 "&&", "||", "++", "--", "->", "+=", "-=", "*=", "/=", "%=",
+                                 "&=", "|=", "^="};
+  std::vector<PPTok> toks;
+  size_t i = 0;
+  while (i < s.size()){
+    char c = s[i];
+    size_t j = i + 1;
+    PPTok::Kind k = PPTok::Punct;
+    if (std::isspace((unsigned char)c)){
+      while (j < s.size() && std::isspace((unsigned char)s[j])) ++j;
+      k = PPTok::Space;
+    } else if (isIdStart(c)){
+      while (j < s.size() && isIdChar(s[j])) ++j;
+      k = PPTok::Ident;
+    } else if (std::isdigit((unsigned char)c) ||
+               (c=='.' && j<s.size() && std::isdigit((unsigned char)s[j]))){
+      // pp-number: digits, letters, '.', and a sign after an exponent
+      while (j < s.size() && (isIdChar(s[j]) || s[j]=='.' ||
+             ((s[j]=='+' || s[j]=='-') && std::strchr("eEpP", s[j-1])))) ++j;
+      k = PPTok::Number;
+    } else if (c=='"' || c=='\''){
+      j = literalEnd(s, i);
+      k = PPTok::Literal;
+    } else {
+      for (const char* p : puncts){
+        size_t n = std::char_traits<char>::length(p);
+        if (s.compare(i, n, p) == 0){ j = i + n; break; }
+      }
+    }
+    toks.push_back({k, std::string(s.substr(i, j-i))});
+    i = j;
+  }
+  return toks;
+}
+
+void trimSpace(std::vector<PPTok>& t){
+  while (!t.empty() && t.back().kind == PPTok::Space) t.pop_back();
+  size_t b = 0;
+  while (b < t.size() && t[b].kind == PPTok::Space) ++b;
+  t.erase(t.begin(), t.begin() + b);
+}
+
+// #x: the argument's spelling, inner whitespace collapsed, as a string literal
+PPTok stringize(const std::vector<PPTok>& arg){
+  std::string s = "\"";
+  for (auto& t : arg){
+    if (t.kind == PPTok::Space){ s += ' '; continue; }
+    if (t.kind == PPTok::Literal){
+      for (char c : t.text){ if (c=='"' || c=='\\') s += '\\'; s += c; }
+    } else {
+      s += t.text;
+    }
+  }
+  return {PPTok::Literal, s + "\""};
+}
+
+// Integer constant expressions of #if / #elif, on tokens that are already
+// macro-expanded with defined() resolved. Remaining identifiers are 0.
+class CondEval {
+  std::vector<PPTok> t; // no Space tokens
+  size_t i = 0;
+
+  bool is(const char* p) const { return i < t.size() && t[i].text == p; }
+  void expect(const char* p){
+    if (!is(p)) throw std::runtime_error(std::string("'") + p + "' expected in #if");
+    ++i;
+  }
+
+  // #if arithmetic is in intmax_t or uintmax_t (C11 6.10.1p4): the bits
+  // plus whether the value is unsigned
+  struct Val { uint64_t v; bool u; };
+  static Val sval(int64_t v){ return {(uint64_t)v, false}; }
+  int skip = 0; // > 0 inside an operand that && || ?: do not evaluate
+
+  static Val number(const std::string& s){
+    std::string d = s;
+    bool u = false;
+    while (!d.empty() && std::strchr("uUlL", d.back())){
+      u |= d.back() == 'u' || d.back() == 'U';
+      d.pop_back();
+    }
+    char* end = nullptr;
+    uint64_t v = std::strtoull(d.c_str(), &end, 0);
+    if (d.empty() || *end) throw std::runtime_error("invalid integer constant in #if: " + s);
+    return {v, u || v > (uint64_t)INT64_MAX}; // too big for intmax_t
+  }
+
+  static Val character(const std::string& s){
+    if (s.size() < 3 || s[0] != '\'') throw std::runtime_error("invalid token in #if: " + s);
+    if (s[1] != '\\') return sval((unsigned char)s[1]);
+    switch (s[2]){
+      case 'n': return sval('\n'); case 't': return sval('\t'); case 'r': return sval('\r');
+      case '0': return sval(0);    case '\\': return sval('\\'); case '\'': return sval('\'');
+      default:  return sval((unsigned char)s[2]);
+    }
+  }
+
+  Val unary(){
+    if (i >= t.size()) throw std::runtime_error("unexpected end of #if expression");
+    const PPTok& k = t[i++];
+    if (k.text == "(") { Val v = cond(); expect(")"); return v; }
+    if (k.text == "!") return sval(!unary().v);
+    if (k.text == "~") { Val v = unary(); return {~v.v, v.u}; }
+    if (k.text == "-") { Val v = unary(); return {0 - v.v, v.u}; }
+    if (k.text == "+") return unary();
+    if (k.kind == PPTok::Number) return number(k.text);
+    if (k.kind == PPTok::Ident) return sval(0);
+    if (k.kind == PPTok::Literal) return character(k.text);
+    throw std::runtime_error("unexpected '" + k.text + "' in #if");
+  }
+
+  static int prec(const std::string& op){
+    static const std::pair<const char*, int> P[] = {
+      {"*", 10}, {"/", 10}, {"%", 10}, {"+", 9}, {"-", 9}, {"<<", 8}, {">>", 8},
+      {"<", 7}, {">", 7}, {"<=", 7}, {">=", 7}, {"==", 6}, {"!=", 6},
+      {"&", 5}, {"^", 4}, {"|", 3}, {"&&", 2}, {"||", 1}};
+    for (auto& p : P) if (op == p.first) return p.second;
+    return -1;
+  }
+
+  // Shifts take the left operand's type. Defined for every count: a
+  // negative one shifts the other way, 64 or more shifts all bits out.
+  static Val shift(Val l, Val r, bool left){
+    bool neg = !r.u && (int64_t)r.v < 0;
+    uint64_t n = neg ? 0 - r.v : r.v;
+    if (neg) left = !left;
+    bool fill = !left && !l.u && (int64_t)l.v < 0;
+    if (n >= 64) return {fill ? ~(uint64_t)0 : 0, l.u};
+    if (left) return {l.v << n, l.u};
+    if (l.u) return {l.v >> n, true};
+    return {fill ? ~(~l.v >> n) : l.v >> n, false};
+  }
+
+  Val apply(const std::string& op, Val l, Val r){
+    if (op == "<<" || op == ">>") return shift(l, r, op == "<<");
+    bool u = l.u || r.u; // the usual arithmetic conversions
+    int64_t a = (int64_t)l.v, b = (int64_t)r.v;
+    if (op == "/" || op == "%"){
+      if (r.v == 0){
+        if (skip) return {0, u};
+        throw std::runtime_error("division by zero in #if");
+      }
+      if (u) return {op == "/" ? l.v / r.v : l.v % r.v, true};
+      if (a == INT64_MIN && b == -1) return sval(op == "/" ? INT64_MIN : 0); // wraps
+      return sval(op == "/" ? a / b : a % b);
+    }
+    if (op == "*") return {l.v * r.v, u};
+    if (op == "+") return {l.v + r.v, u};
+    if (op == "-") return {l.v - r.v, u};
+    if (op == "&") return {l.v & r.v, u};
+    if (op == "^") return {l.v ^ r.v, u};
+    if (op == "|") return {l.v | r.v, u};
+    if (op == "==") return sval(l.v == r.v);
+    if (op == "!=") return sval(l.v != r.v);
+    bool lt = u ? l.v < r.v : a < b, gt = u ? l.v > r.v : a > b;
+    if (op == "<") return sval(lt);
+    if (op == ">") return sval(gt);
+    if (op == "<=") return sval(!gt);
+    return sval(!lt); // >=
+  }
+
+  Val binary(int minPrec){
+    Val l = unary();
+    while (i < t.size()){
+      const std::string op = t[i].text;
+      int p = prec(op);
+      if (t[i].kind != PPTok::Punct || p < minPrec) break;
+      ++i;
+      if (op == "&&" || op == "||"){
+        // the right operand is parsed but not evaluated once l decides
+        bool decided = op == "&&" ? !l.v : l.v != 0;
+        skip += decided;
+        Val r = binary(p + 1);
+        skip -= decided;
+        l = sval(decided ? l.v != 0 : r.v != 0);
+        continue;
+      }
+      Val r = binary(p + 1);
+      l = apply(op, l, r);
+    }
+    return l;
+  }
+
+  Val cond(){
+    Val c = binary(1);
+    if (!is("?")) return c;
+    ++i;
+    skip += !c.v;
+    Val a = cond();
+    skip -= !c.v;
+    expect(":");
+    skip += c.v != 0;
+    Val b = cond();
+    skip -= c.v != 0;
+    Val r = c.v ? a : b;
+    return {r.v, a.u || b.u};
+  }
+
+public:
+  explicit CondEval(const std::vector<PPTok>& toks){
+    for (auto& k : toks) if (k.kind != PPTok::Space) t.push_back(k);
+  }
+  int64_t eval(){
+    if (t.empty()) throw std::runtime_error("#if with no expression");
+    Val v = cond();
+    if (i != t.size()) throw std::runtime_error("junk at end of #if expression: " + t[i].text);
+    return (int64_t)v.v;
+  }
+};
+
+} // namespace
+
 void Preprocessor::addIncludeDir(std::string dir){
   if (!dir.empty() && dir.back()=='/') dir.pop_back();
   includeDirs_.push_back(std::move(dir));
@@ -26,173 +300,338 @@ std::string Preprocessor::joinPath(const std::string& a, const std::string& b){
   return a + "/" + b;
 }
 
-bool Preprocessor::startsWith(const std::string& s, const char* pfx){
-  const size_t n = std::char_traits<char>::length(pfx);
-  return s.size() >= n && s.compare(0, n, pfx) == 0;
+const std::string& Preprocessor::contents(const std::string& path){
+  auto it = files_.find(path);
+  if (it != files_.end()) return it->second;
+  std::ifstream ifs(path, std::ios::binary);
+  if (!ifs) throw std::runtime_error("cannot open: " + path);
+  std::string s((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+  return files_.emplace(path, std::move(s)).first->second;
 }
 
-std::string Preprocessor::trim(const std::string& s){
-  size_t i=0, j=s.size();
-  while (i<j && std::isspace((unsigned char)s[i])) ++i;
-  while (j>i && std::isspace((unsigned char)s[j-1])) --j;
-  return s.substr(i, j-i);
+std::vector<PPTok> Preprocessor::substitute(const Macro& M, const std::vector<std::vector<PPTok>>& args,
+                                            std::vector<std::string>& disabled){
+  auto param = [&](const PPTok& t) -> int {
+    if (t.kind != PPTok::Ident) return -1;
+    for (size_t p = 0; p < M.params.size(); ++p)
+      if (t.text == M.params[p]) return (int)p;
+    return -1;
+  };
+  auto nextSolid = [&](size_t b){ ++b; while (b < M.body.size() && M.body[b].kind == PPTok::Space) ++b; return b; };
+  std::vector<PPTok> r;
+  for (size_t b = 0; b < M.body.size(); ++b){
+    const PPTok& t = M.body[b];
+    if (t.text == "#" && t.kind == PPTok::Punct){
+      size_t n = nextSolid(b);
+      if (n < M.body.size() && param(M.body[n]) >= 0){
+        r.push_back(stringize(args[param(M.body[n])]));
+        b = n;
+        continue;
+      }
+    }
+    int p = param(t);
+    if (p < 0){ r.push_back(t); continue; }
+    // operands of ## are pasted unexpanded
+    size_t n = nextSolid(b);
+    bool pasted = (n < M.body.size() && M.body[n].text == "##");
+    for (size_t q = r.size(); q-- > 0 && !pasted;){
+      if (r[q].kind == PPTok::Space) continue;
+      pasted = r[q].text == "##";
+      break;
+    }
+    if (pasted) r.insert(r.end(), args[p].begin(), args[p].end());
+    else expand(args[p], r, disabled);
+  }
+  // a ## b: glue the neighbouring tokens and re-lex the result
+  for (size_t k = 0; k < r.size(); ++k){
+    if (r[k].kind != PPTok::Punct || r[k].text != "##") continue;
+    size_t l = k, n = k + 1;
+    while (l > 0 && r[l-1].kind == PPTok::Space) --l;
+    while (n < r.size() && r[n].kind == PPTok::Space) ++n;
+    std::string glued = (l > 0 ? r[l-1].text : "") + (n < r.size() ? r[n].text : "");
+    size_t from = l > 0 ? l - 1 : l, to = n < r.size() ? n + 1 : n;
+    std::vector<PPTok> g = lexPP(glued);
+    r.erase(r.begin() + from, r.begin() + to);
+    r.insert(r.begin() + from, g.begin(), g.end());
+    k = from + g.size() - 1;
+  }
+  return r;
 }
 
-std::string Preprocessor::expandMacrosLine(const std::string& line){
-  // Token-wise replace macros, but do not touch inside string/char literals.
-  std::string out;
-  out.reserve(line.size());
-  bool inSQ=false, inDQ=false, escape=false;
+void Preprocessor::expand(const std::vector<PPTok>& in, std::vector<PPTok>& out,
+                          std::vector<std::string>& disabled){
+  for (size_t i = 0; i < in.size(); ++i){
+    const PPTok& t = in[i];
+    auto it = t.kind == PPTok::Ident ? macros_.find(t.text) : macros_.end();
+    if (it == macros_.end() || std::find(disabled.begin(), disabled.end(), t.text) != disabled.end()){
+      out.push_back(t);
+      continue;
+    }
+    const Macro& M = it->second;
+    if (!M.funcLike){
+      disabled.push_back(t.text);
+      expand(M.body, out, disabled);
+      disabled.pop_back();
+      continue;
+    }
+    // a function-like macro name without ( is just a name
+    size_t j = i + 1;
+    while (j < in.size() && in[j].kind == PPTok::Space) ++j;
+    if (j >= in.size() || in[j].text != "("){ out.push_back(t); continue; }
+    std::vector<std::vector<PPTok>> args(1);
+    int depth = 0;
+    size_t k = j + 1;
+    for (; k < in.size(); ++k){
+      const PPTok& a = in[k];
+      if (a.kind == PPTok::Punct){
+        if (a.text == "(") ++depth;
+        else if (a.text == ")" && depth-- == 0) break;
+        else if (a.text == "," && depth == 0 &&
+                 !(M.variadic && args.size() == M.params.size())){ args.emplace_back(); continue; }
+      }
+      args.back().push_back(a);
+    }
+    if (k >= in.size()) throw std::runtime_error("unterminated call of macro " + t.text);
+    for (auto& a : args) trimSpace(a);
+    if (M.params.empty() && args.size() == 1 && args[0].empty()) args.clear();
+    if (M.variadic && args.size() + 1 == M.params.size()) args.emplace_back();
+    if (args.size() != M.params.size())
+      throw std::runtime_error("macro " + t.text + " takes " + std::to_string(M.params.size()) +
+                               " arguments, " + std::to_string(args.size()) + " given");
+    std::vector<PPTok> s = substitute(M, args, disabled);
+    disabled.push_back(t.text);
+    expand(s, out, disabled);
+    disabled.pop_back();
+    i = k;
+  }
+}
 
-  auto flushToken = [&](const std::string& tok){
-    auto it = macros_.find(tok);
-    if (it != macros_.end()) out += it->second;
-    else out += tok;
-  };
+void Preprocessor::expandLine(std::string_view line, std::string& out){
+  // most lines name no macro: copy them as they are
+  bool any = false;
+  std::string id;
+  for (size_t i = 0; i < line.size() && !any;){
+    char c = line[i];
+    if (c=='"' || c=='\''){ i = literalEnd(line, i); continue; }
+    if (std::isdigit((unsigned char)c)){ while (i < line.size() && isIdChar(line[i])) ++i; continue; }
+    if (!isIdStart(c)){ ++i; continue; }
+    size_t j = i;
+    while (j < line.size() && isIdChar(line[j])) ++j;
+    id.assign(line.substr(i, j-i));
+    any = macros_.count(id) != 0;
+    i = j;
+  }
+  if (!any){ out.append(line); return; }
 
-  std::string tok;
+  std::vector<PPTok> res;
+  std::vector<std::string> disabled;
+  expand(lexPP(line), res, disabled);
+  for (auto& t : res) out += t.text;
+}
 
-  for (size_t i=0;i<line.size();++i){
-    char c = line[i];
-    if (inSQ || inDQ){
-      out.push_back(c);
-      if (escape){ escape=false; continue; }
-      if (c=='\\'){ escape=true; continue; }
-      if (inSQ && c=='\'') inSQ=false;
-      if (inDQ && c=='"')  inDQ=false;
-      continue;
+int64_t Preprocessor::evalCondition(std::string_view expr){
+  // defined X / defined(X) first, so the name is not expanded
+  std::vector<PPTok> in = lexPP(expr), pre;
+  for (size_t i = 0; i < in.size(); ++i){
+    if (in[i].kind != PPTok::Ident || in[i].text != "defined"){ pre.push_back(in[i]); continue; }
+    size_t j = i + 1;
+    while (j < in.size() && in[j].kind == PPTok::Space) ++j;
+    bool paren = j < in.size() && in[j].text == "(";
+    if (paren) do ++j; while (j < in.size() && in[j].kind == PPTok::Space);
+    if (j >= in.size() || in[j].kind != PPTok::Ident)
+      throw std::runtime_error("macro name expected after defined");
+    pre.push_back({PPTok::Number, macros_.count(in[j].text) ? "1" : "0"});
+    if (paren){
+      do ++j; while (j < in.size() && in[j].kind == PPTok::Space);
+      if (j >= in.size() || in[j].text != ")") throw std::runtime_error(") expected after defined(");
     }
-    if (c=='\''){ // entering char literal
-      if (!tok.empty()){ flushToken(tok); tok.clear(); }
-      inSQ = true; out.push_back(c); continue;
+    i = j;
+  }
+  std::vector<PPTok> toks;
+  std::vector<std::string> disabled;
+  expand(pre, toks, disabled);
+  return CondEval(toks).eval();
+}
+
+void Preprocessor::define(std::string_view d){
+  size_t i = 0;
+  while (i < d.size() && isIdChar(d[i])) ++i;
+  if (!i || !isIdStart(d[0])) throw std::runtime_error("macro name expected after #define");
+  std::string name(d.substr(0, i));
+  Macro M;
+  if (i < d.size() && d[i] == '('){ // no space before ( : function-like
+    M.funcLike = true;
+    size_t close = d.find(')', i);
+    if (close == std::string_view::npos) throw std::runtime_error("missing ) in parameter list of " + name);
+    for (auto& t : lexPP(d.substr(i + 1, close - i - 1))){
+      if (t.kind == PPTok::Ident) M.params.push_back(t.text);
+      else if (t.text == "..."){ M.params.push_back("__VA_ARGS__"); M.variadic = true; }
+    }
+    i = close + 1;
+  }
+  M.body = lexPP(trimView(d.substr(i)));
+  macros_[name] = std::move(M);
+}
+
+void Preprocessor::include(std::string_view arg, const std::string& file){
+  std::string spec(trimView(arg));
+  if (!spec.empty() && spec[0] != '"' && spec[0] != '<'){ // #include MACRO
+    std::string e;
+    expandLine(spec, e);
+    spec = std::string(trimView(e));
+  }
+  bool quoted = !spec.empty() && spec[0] == '"';
+  size_t close = spec.find(quoted ? '"' : '>', 1);
+  if (spec.size() < 3 || (!quoted && spec[0] != '<') || close == std::string::npos)
+    throw std::runtime_error("#include expects \"file\" or <file>");
+  std::string hdr = spec.substr(1, close - 1);
+
+  // search order: the including file's directory ("..." only), then the include dirs
+  std::string cand;
+  if (quoted && fileExists(joinPath(dirName(file), hdr))) cand = joinPath(dirName(file), hdr);
+  for (size_t d = 0; cand.empty() && d < includeDirs_.size(); ++d)
+    if (fileExists(joinPath(includeDirs_[d], hdr))) cand = joinPath(includeDirs_[d], hdr);
+  // system headers (and missing ones) are skipped: the parser has the
+  // <stdint.h>/<stddef.h> typedefs built in
+  if (!cand.empty()) processFile(cand);
+}
+
+void Preprocessor::directive(std::string_view d, const std::string& file, FileScan& S){
+  d = trimView(d);
+  if (d.empty() || std::isdigit((unsigned char)d[0])) return; // null directive, # 1 "file"
+  size_t n = 0;
+  while (n < d.size() && isIdChar(d[n])) ++n;
+  std::string_view name = d.substr(0, n), rest = trimView(d.substr(n));
+  auto macroArg = [&]{
+    size_t e = 0;
+    while (e < rest.size() && isIdChar(rest[e])) ++e;
+    if (!e) throw std::runtime_error("macro name expected after #" + std::string(name));
+    return std::string(rest.substr(0, e));
+  };
+
+  // include-guard idiom: the file starts with #ifndef G and ends with its #endif
+  if (!S.seenAny){
+    S.seenAny = true;
+    if (name == "ifndef"){ S.guard = macroArg(); S.depth = conds_.size(); }
+  } else if (S.closed){
+    S.guard.clear();
+  }
+
+  // conditionals are tracked even inside skipped groups
+  if (name == "if" || name == "ifdef" || name == "ifndef"){
+    bool parent = active();
+    bool v = false;
+    if (parent){
+      if (name == "if") v = evalCondition(rest) != 0;
+      else v = macros_.count(macroArg()) == (name == "ifdef" ? 1u : 0u);
     }
-    if (c=='"'){ // entering string literal
-      if (!tok.empty()){ flushToken(tok); tok.clear(); }
-      inDQ = true; out.push_back(c); continue;
+    conds_.push_back({parent && v, v, false, parent});
+    return;
+  }
+  if (name == "elif" || name == "else" || name == "endif"){
+    if (conds_.size() <= S.condBase) throw std::runtime_error("#" + std::string(name) + " without #if");
+    Cond& C = conds_.back();
+    if (name == "endif"){
+      if (!S.guard.empty() && conds_.size() - 1 == S.depth) S.closed = true;
+      conds_.pop_back();
+      return;
     }
-    auto isIdChar = [&](char ch)->bool{ return std::isalnum((unsigned char)ch) || ch=='_'; };
-    if (isIdChar(c)){
-      tok.push_back(c);
+    if (C.sawElse) throw std::runtime_error("#" + std::string(name) + " after #else");
+    if (name == "else"){
+      C.sawElse = true;
+      C.active = C.parentActive && !C.taken;
+      C.taken = true;
     } else {
-      if (!tok.empty()){ flushToken(tok); tok.clear(); }
-      out.push_back(c);
+      C.active = C.parentActive && !C.taken && evalCondition(rest) != 0;
+      C.taken = C.taken || C.active;
     }
+    return;
   }
-  if (!tok.empty()) flushToken(tok);
-  return out;
-}
+  if (!active()) return;
 
-std::string Preprocessor::processFile(const std::string& fullPath){
-  if (includeStack_.count(fullPath)) {
-    throw std::runtime_error("include cycle detected: " + fullPath);
+  if (name == "include") include(rest, file);
+  else if (name == "define") define(rest);
+  else if (name == "undef") macros_.erase(macroArg());
+  else if (name == "error") throw std::runtime_error("#error " + std::string(rest));
+  else if (name == "pragma"){
+    if (rest == "once") { once_.insert(file); return; }
+    // passed through (macro-expanded) for the parser's loop hints
+    out_ += '#';
+    expandLine(d, out_);
+    out_ += '\n';
   }
-  includeStack_.insert(fullPath);
-
-  std::ifstream ifs(fullPath);
-  if (!ifs) throw std::runtime_error("cannot open: " + fullPath);
+  // #line, #warning, #ident, ...: ignored
+}
 
-  const std::string selfDir = dirName(fullPath);
-  std::ostringstream out;
+void Preprocessor::processFile(const std::string& fullPath){
+  if (once_.count(fullPath)) return;
+  auto g = guards_.find(fullPath);
+  if (g != guards_.end() && macros_.count(g->second)) return; // guarded and already in
+  if (depth_ >= 200) throw std::runtime_error("#include nested too deeply: " + fullPath);
+  ++depth_;
 
-  std::string line;
-  while (std::getline(ifs, line)){
-    std::string s = trim(line);
-    if (!s.empty() && s[0] == '#'){
-      // skip line markers like: # 1 "file"
-      if (s.size()>=2 && (std::isdigit((unsigned char)s[1]) || s[1]=='l')) {
-        // '# 1 "..."' or '#line ...' -> skip
-        continue;
-      }
-      if (startsWith(s, "#ifdef")) {
-        // parse symbol after #ifdef
-        std::istringstream iss(s);
-        std::string sharp_ifdef, sym;
-        iss >> sharp_ifdef >> sym; // "#ifdef" and then symbol
-        if (sym == "__cplusplus") {
-          // We are compiling C, so __cplusplus is undefined -> skip until matching #endif.
-          int depth = 1;
-          std::string l2;
-          while (depth > 0 && std::getline(ifs, l2)) {
-            std::string t = trim(l2);
-            if (!t.empty() && t[0]=='#') {
-              if (startsWith(t, "#ifdef")) depth++;
-              else if (startsWith(t, "#endif")) depth--;
-              // We intentionally ignore #else here (skip whole block).
-            }
-          }
-          continue; // block skipped
-        }
-        // If it's some other #ifdef, ignore directive line and keep reading normally.
-        // (Basic mode: we neither include nor exclude; good enough for our current headers.)
+  const std::string& src = contents(fullPath);
+  FileScan S;
+  S.condBase = conds_.size();
+  bool inComment = false;
+  std::string logical, line;
+  size_t pos = 0, lineNo = 0;
+  while (pos < src.size()){
+    // one logical line: physical lines joined at a trailing backslash
+    size_t first = lineNo + 1;
+    logical.clear();
+    for (;;){
+      size_t eol = src.find('\n', pos);
+      if (eol == std::string::npos) eol = src.size();
+      std::string_view phys(src.data() + pos, eol - pos);
+      if (!phys.empty() && phys.back() == '\r') phys.remove_suffix(1);
+      pos = std::min(eol + 1, src.size());
+      ++lineNo;
+      if (!phys.empty() && phys.back() == '\\' && pos < src.size()){
+        logical.append(phys.substr(0, phys.size() - 1));
         continue;
       }
+      logical.append(phys);
+      break;
+    }
+    line.clear();
+    stripComments(logical, inComment, line);
+    std::string_view sv = trimView(line);
+    if (sv.empty()) continue;
 
-      // === NEW: trivial handling of '#endif' that might appear alone ===
-      if (startsWith(s, "#endif")) {
-        // In our tiny mode, we've either consumed it in the block-skip above,
-        // or we just ignore stray #endif lines.
+    try {
+      if (sv[0] == '#'){
+        directive(sv.substr(1), fullPath, S);
         continue;
       }
-      
-      // #include "file.h"
-      if (startsWith(s, "#include")){
-        // Only support quotes includes
-        auto q1 = s.find('\"');
-        auto q2 = (q1==std::string::npos) ? std::string::npos : s.find('\"', q1+1);
-        if (q1 != std::string::npos && q2 != std::string::npos && q2 > q1+1){
-          std::string hdr = s.substr(q1+1, q2-q1-1);
-
-          // search order: relative to current file dir, then user include dirs
-          std::string cand = joinPath(selfDir, hdr);
-          if (!fileExists(cand)){
-            for (auto &d : includeDirs_){
-              auto c2 = joinPath(d, hdr);
-              if (fileExists(c2)){ cand = c2; break; }
-            }
-          }
-          if (!fileExists(cand)) {
-            // Ignore system-style <...> includes or missing files silently
-            continue;
-          }
-
-          out << processFile(cand); // recursive include
-          continue;
-        }
-        // unsupported include form -> ignore
-        continue;
-      }
-      // #define NAME value   (no-parameter)
-      if (startsWith(s, "#define")){
-        // tokenize "#define NAME value..."
-        std::istringstream iss(s);
-        std::string sharp, kw, name;
-        iss >> sharp >> name; // sharp should be "#define"
-        if (name.empty()) continue;
-        std::string rest;
-        std::getline(iss, rest);
-        rest = trim(rest);
-        if (startsWith(rest.c_str(), "(")) {
-          // function-like macro: ignore in tiny mode
-          continue;
-        }
-        macros_[name] = rest;
-        continue;
-      }
-      // any other directive: ignore
-      continue;
+      S.seenAny = true;
+      if (S.closed || conds_.size() == S.condBase) S.guard.clear(); // text outside the guard
+      if (!active()) continue;
+      expandLine(line, out_);
+      out_ += '\n';
+    } catch (const LocatedError&) {
+      throw;
+    } catch (const std::exception& ex) {
+      throw LocatedError(fullPath + ":" + std::to_string(first) + ": " + ex.what());
     }
-
-    // normal line: expand macros
-    out << expandMacrosLine(line) << "\n";
   }
-
-  includeStack_.erase(fullPath);
-  return out.str();
+  if (conds_.size() != S.condBase)
+    throw LocatedError(fullPath + ": unterminated #if");
+  if (!S.guard.empty() && S.closed) guards_[fullPath] = S.guard;
+  --depth_;
 }
 
 std::string Preprocessor::run(const std::string& path){
-  // Reset per-run state except includeDirs_
+  // Reset per-run state except includeDirs_ and the file contents
   macros_.clear();
-  includeStack_.clear();
-  return processFile(path);
+  guards_.clear();
+  once_.clear();
+  conds_.clear();
+  out_.clear();
+  depth_ = 0;
+  for (const char* d : {"__STDC__ 1", "__STDC_VERSION__ 201112L", "__STDC_HOSTED__ 1",
+                        "__LP64__ 1", "__veclangc__ 1"})
+    define(d);
+  processFile(path);
+  return std::move(out_);
 }
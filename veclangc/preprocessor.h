@@ -1,15 +1,25 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
-// A tiny preprocessor supporting:
-//  - #include "file.h"  (relative and user include dirs)
-//  - #define NAME value (no-parameter macros)
-//  - skip #line markers (# 1 "file")
-//  - ignore any other #... lines
-// Limitations: no conditional compilation, no function-like macros, no system <...> includes.
+// A small C preprocessor supporting:
+//  - #include "file.h" (including file's dir, then include dirs) and
+//    #include <file.h> (include dirs only; system headers are skipped)
+//  - #define / #undef of object-like and function-like macros, with
+//    # (stringize), ## (paste) and __VA_ARGS__
+//  - #if / #ifdef / #ifndef / #elif / #else / #endif, with defined() and
+//    integer constant expressions
+//  - #pragma once and the #ifndef include-guard idiom: a header that is
+//    already in is not opened again
+//  - #error; comments and line splices are removed
+//  - skip #line markers (# 1 "file"); pass other #pragma lines through to
+//    the parser (loop hints)
+// Limitations: a function-like macro call must fit on one line; macro
+// expansion does not rescan into the tokens after the call.
 
 class Preprocessor {
 public:
@@ -17,20 +27,63 @@ public:
   void addIncludeDir(std::string dir);
 
   // Preprocess a .c file and return a flat C source string.
-  // Throws std::runtime_error on IO errors.
+  // Throws std::runtime_error on IO errors and on #error.
   std::string run(const std::string& path);
 
+  // A preprocessing token. Space is a run of whitespace (comments are
+  // already gone), Punct an operator or any other single character.
+  struct PPTok {
+    enum Kind { Ident, Number, Literal, Punct, Space } kind;
+    std::string text;
+  };
+
 private:
+  struct Macro {
+    bool funcLike = false;
+    bool variadic = false;          // last parameter is ... (__VA_ARGS__)
+    std::vector<std::string> params;
+    std::vector<PPTok> body;        // without leading / trailing space
+  };
+  // One #if ... #endif group.
+  struct Cond {
+    bool active;     // lines of the current branch are emitted
+    bool taken;      // some branch of this group was already active
+    bool sawElse;
+    bool parentActive;
+  };
+  // Per-file state while it is read. Include-guard detection: the first
+  // line of the file is #ifndef G, and nothing follows its #endif.
+  struct FileScan {
+    size_t condBase = 0;    // conds_ entries owned by the includer
+    std::string guard;      // candidate G; empty once ruled out
+    size_t depth = 0;       // conds_ size at the guard's #ifndef
+    bool seenAny = false;   // some directive or text line was seen
+    bool closed = false;    // the guard's #endif was seen
+  };
+
   std::vector<std::string> includeDirs_;
-  std::unordered_map<std::string, std::string> macros_;   // NAME -> replacement
-  std::unordered_set<std::string> includeStack_;           // to avoid recursive include loops
+  std::unordered_map<std::string, Macro> macros_;
+  std::unordered_map<std::string, std::string> files_;      // path -> contents, read once
+  std::unordered_map<std::string, std::string> guards_;     // path -> guard macro
+  std::unordered_set<std::string> once_;                    // #pragma once files
+  std::vector<Cond> conds_;
+  std::string out_;                                         // the whole output
+  unsigned depth_ = 0;                                      // include nesting
 
-  std::string processFile(const std::string& fullPath);
+  void processFile(const std::string& fullPath);
+  void directive(std::string_view d, const std::string& file, FileScan& S);
+  void include(std::string_view arg, const std::string& file);
+  void define(std::string_view d);
+  bool active() const { return conds_.empty() || conds_.back().active; }
+  const std::string& contents(const std::string& path);
   static std::string dirName(const std::string& path);
   static std::string joinPath(const std::string& a, const std::string& b);
-  static bool startsWith(const std::string& s, const char* pfx);
-  static std::string trim(const std::string& s);
 
-  // Expand simple object-like macros on a line, avoiding string literals.
-  std::string expandMacrosLine(const std::string& line);
+  // Macro expansion; `disabled` holds the macros being expanded (no recursion).
+  void expand(const std::vector<PPTok>& in, std::vector<PPTok>& out,
+              std::vector<std::string>& disabled);
+  void expandLine(std::string_view line, std::string& out);
+  std::vector<PPTok> substitute(const Macro& M, const std::vector<std::vector<PPTok>>& args,
+                                std::vector<std::string>& disabled);
+  int64_t evalCondition(std::string_view expr);
 };
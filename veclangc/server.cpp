@@ -0,0 +1,190 @@
+#include "server.h"
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SHA256.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace llvm;
+
+std::string defaultSocketPath() {
+    if (const char *Dir = std::getenv("XDG_RUNTIME_DIR"))
+        if (*Dir) return std::string(Dir) + "/veclangc.sock";
+    return "/tmp/veclangc-" + std::to_string(getuid()) + ".sock";
+}
+
+// --- Wire format: u32 length-prefixed strings ---
+namespace {
+
+bool writeAll(int fd, const void *p, size_t n) {
+    const char *c = static_cast<const char*>(p);
+    while (n) {
+        ssize_t k = ::write(fd, c, n);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) return false;
+        c += k; n -= (size_t)k;
+    }
+    return true;
+}
+
+bool readAll(int fd, void *p, size_t n) {
+    char *c = static_cast<char*>(p);
+    while (n) {
+        ssize_t k = ::read(fd, c, n);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) return false;
+        c += k; n -= (size_t)k;
+    }
+    return true;
+}
+
+bool sendU32(int fd, uint32_t v) { return writeAll(fd, &v, 4); }
+bool recvU32(int fd, uint32_t &v) { return readAll(fd, &v, 4); }
+
+bool sendStr(int fd, const std::string &s) {
+    return sendU32(fd, (uint32_t)s.size()) && writeAll(fd, s.data(), s.size());
+}
+bool recvStr(int fd, std::string &s) {
+    uint32_t n;
+    if (!recvU32(fd, n) || n > (64u << 20)) return false;
+    s.resize(n);
+    return readAll(fd, &s[0], n);
+}
+
+sockaddr_un socketAddr(const std::string &path) {
+    sockaddr_un A{};
+    A.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(A.sun_path))
+        throw std::runtime_error("socket path too long: " + path);
+    std::memcpy(A.sun_path, path.c_str(), path.size() + 1);
+    return A;
+}
+
+} // namespace
+
+int compileOnServer(const std::string &socket, const std::vector<std::string> &args) {
+    sockaddr_un A = socketAddr(socket);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&A), sizeof(A)) != 0) { ::close(fd); return -1; }
+
+    SmallString<256> cwd;
+    sys::fs::current_path(cwd);
+    // request: cwd, argc, args...   reply: exit code, message
+    bool ok = sendStr(fd, cwd.str().str()) && sendU32(fd, (uint32_t)args.size());
+    for (size_t i = 0; ok && i < args.size(); ++i) ok = sendStr(fd, args[i]);
+    uint32_t rc = 0;
+    std::string msg;
+    ok = ok && recvU32(fd, rc) && recvStr(fd, msg);
+    ::close(fd);
+    if (!ok) return -1;
+    errs() << msg;
+    return (int)rc;
+}
+
+int runCompileServer(const std::string &socket, const RequestHandler &handler) {
+    std::signal(SIGPIPE, SIG_IGN); // a client that went away must not kill us
+    sockaddr_un A = socketAddr(socket);
+    int lfd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (lfd < 0) { errs() << "socket: " << std::strerror(errno) << "\n"; return 1; }
+    ::unlink(socket.c_str()); // stale socket from an earlier server
+    if (::bind(lfd, reinterpret_cast<sockaddr*>(&A), sizeof(A)) != 0 || ::listen(lfd, 64) != 0) {
+        errs() << "cannot listen on " << socket << ": " << std::strerror(errno) << "\n";
+        ::close(lfd);
+        return 1;
+    }
+    errs() << "veclangc: serving on " << socket << "\n";
+
+    while (true) {
+        int fd = ::accept(lfd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            errs() << "accept: " << std::strerror(errno) << "\n";
+            ::close(lfd);
+            return 1;
+        }
+        std::string cwd;
+        uint32_t argc = 0;
+        bool ok = recvStr(fd, cwd) && recvU32(fd, argc) && argc < 4096;
+        std::vector<std::string> args(ok ? argc : 0);
+        for (uint32_t i = 0; ok && i < argc; ++i) ok = recvStr(fd, args[i]);
+        if (!ok) { ::close(fd); continue; }
+
+        int rc = 1;
+        std::string msg;
+        raw_string_ostream Err(msg);
+        if (sys::fs::set_current_path(cwd)) {
+            Err << "veclangc server: cannot enter " << cwd << "\n";
+        } else {
+            std::vector<const char*> argv{"veclangc"};
+            for (auto &a : args) argv.push_back(a.c_str());
+            cl::ResetAllOptionOccurrences();
+            if (cl::ParseCommandLineOptions((int)argv.size(), argv.data(), "", &Err)) {
+                try {
+                    std::string hmsg;
+                    rc = handler(args, hmsg);
+                    Err << hmsg;
+                } catch (const std::exception &ex) {
+                    Err << "error: " << ex.what() << "\n";
+                    rc = 1;
+                }
+            }
+        }
+        Err.flush();
+        sendU32(fd, (uint32_t)rc);
+        sendStr(fd, msg);
+        ::close(fd);
+    }
+}
+
+// --- Object cache ---
+ObjectCache::ObjectCache(std::string dir) : dir_(std::move(dir)) {
+    sys::fs::create_directories(dir_);
+}
+
+std::string ObjectCache::key(ArrayRef<std::string> parts) {
+    std::string buf;
+    for (auto &p : parts) { // length-prefixed, so part boundaries matter
+        buf += std::to_string(p.size());
+        buf += ':';
+        buf += p;
+    }
+    auto H = SHA256::hash(ArrayRef<uint8_t>(reinterpret_cast<const uint8_t*>(buf.data()), buf.size()));
+    return toHex(H, /*LowerCase=*/true);
+}
+
+std::string ObjectCache::pathFor(const std::string &key) const {
+    SmallString<256> P(dir_);
+    sys::path::append(P, key + ".o");
+    return P.str().str();
+}
+
+bool ObjectCache::fetch(const std::string &key, const std::string &outPath) const {
+    std::string P = pathFor(key);
+    if (!sys::fs::exists(P)) return false;
+    return !sys::fs::copy_file(P, outPath);
+}
+
+void ObjectCache::store(const std::string &key, StringRef object) const {
+    std::string P = pathFor(key);
+    std::string Tmp = P + ".tmp" + std::to_string(getpid());
+    std::error_code EC;
+    {
+        raw_fd_ostream OS(Tmp, EC, sys::fs::OF_None);
+        if (EC) return; // the cache is best effort
+        OS << object;
+    }
+    if (sys::fs::rename(Tmp, P)) sys::fs::remove(Tmp);
+}
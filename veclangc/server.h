@@ -0,0 +1,47 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringRef.h>
+
+// Compile server (--serve) and its thin client (--server). The server keeps
+// the targets initialized and the TargetMachines built between requests;
+// clients forward their command line and working directory over a local
+// Unix socket, one request at a time.
+//
+// Requests are handled serially: each one re-parses the global cl::opts and
+// chdirs the whole process to the client's directory, so two cannot run at
+// once. Concurrent clients (make -j) queue on the socket and gain nothing
+// over one; build many files in parallel with the multi-file driver
+// (veclangc -j N a.c b.c ... -o lib.a) instead.
+
+// $XDG_RUNTIME_DIR/veclangc.sock, else /tmp/veclangc-<uid>.sock
+std::string defaultSocketPath();
+
+// Client: run `args` (argv without argv[0]) on the server at `socket`.
+// Returns the remote exit code, or -1 if no server answered (the caller
+// then compiles locally).
+int compileOnServer(const std::string &socket, const std::vector<std::string> &args);
+
+// Server: for each request, chdir to the client's directory, re-parse its
+// args into the cl::opts and call `handler`; whatever it puts in `msg` is
+// printed by the client. Only returns on a socket error.
+using RequestHandler = std::function<int(const std::vector<std::string> &args, std::string &msg)>;
+int runCompileServer(const std::string &socket, const RequestHandler &handler);
+
+// Content-addressed object files: <dir>/<sha256 of the key parts>.o
+class ObjectCache {
+public:
+    explicit ObjectCache(std::string dir);
+    static std::string key(llvm::ArrayRef<std::string> parts);
+    // Copy the cached object to outPath; false on a miss.
+    bool fetch(const std::string &key, const std::string &outPath) const;
+    // Write-then-rename, so concurrent readers never see a partial file.
+    void store(const std::string &key, llvm::StringRef object) const;
+
+private:
+    std::string dir_;
+    std::string pathFor(const std::string &key) const;
+};